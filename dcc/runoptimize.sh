@@ -41,6 +41,291 @@ do
     else
         echo "FAIL: Failed to compile ${input}."
     fi
+    
+    # the same program built for size, with outlined sequences
+    ${DCC} -Os -o out/${dcfinput}_size.s $input
+    if [ -e out/${dcfinput}_size.s ]
+    then
+        gcc out/${dcfinput}_size.s -o out/${dcfinput}_size 2> out/${dcfinput}_size.log
+        if [ -e out/${dcfinput}_size ]
+        then
+            out/${dcfinput}_size > out/${dcfinput}_size.output
+            diff out/${dcfinput}_size.output testdata/optimizer/correctness/output/$dcfinput.out > /dev/null
+            if [ $? -eq "0" ]
+            then
+                echo "PASS: ${input} (-Os)."
+            else
+                echo "FAIL: ${input} (-Os) did not produce the expected output."                
+            fi
+        else
+            echo "FAIL: Failed to link ${input} (-Os)."
+        fi
+    else
+        echo "FAIL: Failed to compile ${input} (-Os)."
+    fi
+    
+    # and at each optimization level
+    for level in 0 1 2 3
+    do
+        ${DCC} -O$level -o out/${dcfinput}_O$level.s $input
+        if [ -e out/${dcfinput}_O$level.s ]
+        then
+            gcc out/${dcfinput}_O$level.s -o out/${dcfinput}_O$level 2> out/${dcfinput}_O$level.log
+            if [ -e out/${dcfinput}_O$level ]
+            then
+                out/${dcfinput}_O$level > out/${dcfinput}_O$level.output
+                diff out/${dcfinput}_O$level.output testdata/optimizer/correctness/output/$dcfinput.out > /dev/null
+                if [ $? -eq "0" ]
+                then
+                    echo "PASS: ${input} (-O$level)."
+                else
+                    echo "FAIL: ${input} (-O$level) did not produce the expected output."
+                fi
+            else
+                echo "FAIL: Failed to link ${input} (-O$level)."
+            fi
+        else
+            echo "FAIL: Failed to compile ${input} (-O$level)."
+        fi
+    done
+done
+
+# Fixture sample profiles (<test>.prof) stand in for a sampler run.
+TESTFILES=testdata/optimizer/profile/*.dcf
+
+for input in ${TESTFILES}
+do
+    dcfinput=${input##*/}
+    dcfinput=${dcfinput%%.*}
+    
+    rm -f out/$dcfinput
+    rm -f out/$dcfinput.*
+    
+    echo "---------------------------"
+    echo "Test: ${dcfinput}"
+    
+    ${DCC} --opt-all --profile-sample=testdata/optimizer/profile/$dcfinput.prof -o out/$dcfinput.s $input
+    if [ -e out/$dcfinput.s ]
+    then
+        gcc out/$dcfinput.s -o out/$dcfinput 2> out/$dcfinput.log
+        if [ -e out/$dcfinput ]
+        then
+            out/$dcfinput > out/$dcfinput.output
+            diff out/$dcfinput.output testdata/optimizer/profile/output/$dcfinput.out > /dev/null
+            if [ $? -eq "0" ]
+            then
+                echo "PASS: ${input}."
+            else
+                echo "FAIL: ${input} did not produce the expected output."                
+            fi
+        else
+            echo "FAIL: Failed to link ${input}."
+        fi
+    else
+        echo "FAIL: Failed to compile ${input}."
+    fi
+done
+
+# Counts from an instrumented run steer the next build; a profile whose
+# checksum no longer matches the code is ignored with a warning.
+for dcfinput in 16-qsort 38-ifconvert 39-layout
+do
+    input=testdata/optimizer/correctness/$dcfinput.dcf
+    
+    rm -f out/${dcfinput}_gen* out/${dcfinput}_use* out/$dcfinput.prof
+    
+    echo "---------------------------"
+    echo "Test: ${dcfinput} --profile-generate/--profile-use"
+    
+    ${DCC} --opt-all --profile-generate -o out/${dcfinput}_gen.s $input
+    gcc out/${dcfinput}_gen.s -o out/${dcfinput}_gen 2> out/${dcfinput}_gen.log
+    if [ -e out/${dcfinput}_gen ]
+    then
+        # the counts are written to <source>.prof in the working directory
+        cd out
+        ./${dcfinput}_gen > ${dcfinput}_gen.output
+        cd ..
+    fi
+    if [ -e out/$dcfinput.prof ]
+    then
+        ${DCC} --opt-all --profile-use=out/$dcfinput.prof -o out/${dcfinput}_use.s $input 2> out/${dcfinput}_use.log
+        gcc out/${dcfinput}_use.s -o out/${dcfinput}_use 2>> out/${dcfinput}_use.log
+        out/${dcfinput}_use > out/${dcfinput}_use.output
+        diff out/${dcfinput}_use.output testdata/optimizer/correctness/output/$dcfinput.out > /dev/null
+        if [ $? -eq "0" ] && ! grep -q "warning: profile" out/${dcfinput}_use.log
+        then
+            echo "PASS: ${input} (--profile-use)."
+        else
+            echo "FAIL: ${input} (--profile-use) did not produce the expected output."
+        fi
+        
+        sed 's/^main [0-9]*/main 1/' out/$dcfinput.prof > out/${dcfinput}_stale.prof
+        ${DCC} --opt-all --profile-use=out/${dcfinput}_stale.prof -o out/${dcfinput}_use.s $input 2> out/${dcfinput}_use.log
+        gcc out/${dcfinput}_use.s -o out/${dcfinput}_use 2>> out/${dcfinput}_use.log
+        out/${dcfinput}_use > out/${dcfinput}_use.output
+        diff out/${dcfinput}_use.output testdata/optimizer/correctness/output/$dcfinput.out > /dev/null
+        if [ $? -eq "0" ] && grep -q -F "warning: profile of main in 'out/${dcfinput}_stale.prof' is out of date and was ignored." out/${dcfinput}_use.log
+        then
+            echo "PASS: ${input} (stale profile)."
+        else
+            echo "FAIL: ${input} (stale profile) was not ignored with a warning."
+        fi
+    else
+        echo "FAIL: ${input} (--profile-generate) did not write ${dcfinput}.prof."
+    fi
+done
+
+# Passes run in orders that no -O level uses.
+for pipeline in "38-ifconvert:if-convert,copy-prop" "38-ifconvert:if-convert,const-prop" \
+                "44-scalarlive:unroll,scalar-repl,const-prop,bb" "45-divzero:const-prop,bb" \
+                "47-ipcpdiv:ipcp,bb" "08-array:unroll,bb" "34-loadstore:load-store,bb" "cse-08:if-convert,bb" \
+                "34-loadstore:load-store,copy-prop"
+do
+    dcfinput=${pipeline%%:*}
+    passes=${pipeline#*:}
+    input=testdata/optimizer/correctness/$dcfinput.dcf
+    
+    rm -f out/${dcfinput}_passes*
+    
+    echo "---------------------------"
+    echo "Test: ${dcfinput} --passes=${passes}"
+    
+    ${DCC} --passes=$passes -o out/${dcfinput}_passes.s $input
+    if [ -e out/${dcfinput}_passes.s ]
+    then
+        gcc out/${dcfinput}_passes.s -o out/${dcfinput}_passes 2> out/${dcfinput}_passes.log
+        if [ -e out/${dcfinput}_passes ]
+        then
+            out/${dcfinput}_passes > out/${dcfinput}_passes.output
+            diff out/${dcfinput}_passes.output testdata/optimizer/correctness/output/$dcfinput.out > /dev/null
+            if [ $? -eq "0" ]
+            then
+                echo "PASS: ${input} (--passes=${passes})."
+            else
+                echo "FAIL: ${input} (--passes=${passes}) did not produce the expected output."
+            fi
+        else
+            echo "FAIL: Failed to link ${input} (--passes=${passes})."
+        fi
+    else
+        echo "FAIL: Failed to compile ${input} (--passes=${passes})."
+    fi
+done
+
+# A malformed --passes list is reported and the pipeline of the flags runs.
+input=testdata/optimizer/correctness/02-expr.dcf
+for pipeline in "bogus|unknown pass 'bogus'" "dce)|unexpected ')'" "fixpoint()|empty fixpoint group" \
+                "fixpoint(dce|missing ')'" "fixpoint(dce,slots)|'slots' cannot repeat in a fixpoint group"
+do
+    passes=${pipeline%%|*}
+    error=${pipeline#*|}
+    
+    rm -f out/passes.*
+    
+    echo "---------------------------"
+    echo "Test: --passes=${passes}"
+    
+    ${DCC} --passes="$passes" -o out/passes.s $input 2> out/passes.log
+    grep -q -F "warning: --passes: ${error}; ignored." out/passes.log
+    if [ $? -eq "0" ] && [ -e out/passes.s ]
+    then
+        echo "PASS: --passes=${passes} is rejected."
+    else
+        echo "FAIL: --passes=${passes} did not report \"${error}\"."
+    fi
+done
+
+# --pass-stats counts the rounds a fixpoint group takes to settle; the
+# columns but the time are checked.
+echo "---------------------------"
+echo "Test: --pass-stats"
+
+rm -f out/passes.*
+${DCC} --passes="fixpoint(bb,copy-prop,dce)" --pass-stats -o out/passes.s $input 2> out/passes.log
+awk '$1 != "total" { print $1, $2, $3 }' out/passes.log > out/passes.output
+printf "pass runs changes\nbb 2 0\ncopy-prop 2 1\ndce 2 1\nslots 1 1\n" | diff out/passes.output - > /dev/null
+if [ $? -eq "0" ] && grep -q "^total " out/passes.log
+then
+    echo "PASS: --pass-stats."
+else
+    echo "FAIL: --pass-stats did not report the expected runs and changes."
+fi
+
+# --time-passes prints a row per phase and a total; --time-trace writes the
+# same phases as Chrome trace events.
+echo "---------------------------"
+echo "Test: --time-passes --time-trace"
+
+input=testdata/optimizer/correctness/16-qsort.dcf
+rm -f out/timing.*
+${DCC} -O2 --time-passes --time-trace=out/timing.json -o out/timing.s $input 2> out/timing.log
+rows=0
+for phase in phase parse propagate-types analyze allocate codegen optimize emit total "peak RSS:"
+do
+    grep -q "^${phase} " out/timing.log && rows=$((rows + 1))
+done
+if [ $rows -eq 10 ]
+then
+    echo "PASS: --time-passes."
+else
+    echo "FAIL: --time-passes did not print every phase and the total."
+fi
+python3 -c '
+import json, sys
+events = json.load(open(sys.argv[1]))["traceEvents"]
+spans = [e for e in events if e["ph"] == "X"]
+sys.exit(0 if spans and all("name" in e and e["dur"] >= 0 and e["ts"] > 0 for e in spans) else 1)
+' out/timing.json 2> /dev/null
+if [ $? -eq "0" ]
+then
+    echo "PASS: --time-trace."
+else
+    echo "FAIL: --time-trace did not write JSON with complete (\"X\") events."
+fi
+
+# 'parallel for' loops run on the runtime's thread pool.
+TESTFILES=testdata/optimizer/parallel/*.dcf
+gcc -c testdata/optimizer/tests/lib/6035.c -o out/6035.o
+
+for input in ${TESTFILES}
+do
+    dcfinput=${input##*/}
+    dcfinput=${dcfinput%%.*}
+    
+    rm -f out/$dcfinput
+    rm -f out/$dcfinput.*
+    
+    echo "---------------------------"
+    echo "Test: ${dcfinput}"
+    
+    for level in none all
+    do
+        if [ $level = "all" ]
+        then
+            ${DCC} --opt-all --opt-parallelize -o out/${dcfinput}_$level.s $input
+        else
+            ${DCC} -o out/${dcfinput}_$level.s $input
+        fi
+        if [ -e out/${dcfinput}_$level.s ]
+        then
+            gcc out/${dcfinput}_$level.s out/6035.o -o out/${dcfinput}_$level -lpthread 2> out/${dcfinput}_$level.log
+            if [ -e out/${dcfinput}_$level ]
+            then
+                DCC_NUM_THREADS=4 out/${dcfinput}_$level > out/${dcfinput}_$level.output
+                diff out/${dcfinput}_$level.output testdata/optimizer/parallel/output/$dcfinput.out > /dev/null
+                if [ $? -eq "0" ]
+                then
+                    echo "PASS: ${input} ($level)."
+                else
+                    echo "FAIL: ${input} ($level) did not produce the expected output."                
+                fi
+            else
+                echo "FAIL: Failed to link ${input} ($level)."
+            fi
+        else
+            echo "FAIL: Failed to compile ${input} ($level)."
+        fi
+    done
 done
 
 TESTFILES=testdata/optimizer/basicblocks/*.dcf
@@ -80,6 +365,82 @@ do
     fi
 done
 
+# An index out of bounds ends the program with the runtime error and exit
+# status 1, through one failure path kept in .text.unlikely.
+TESTFILES=testdata/optimizer/bounds/*.dcf
+
+for input in ${TESTFILES}
+do
+    dcfinput=${input##*/}
+    dcfinput=${dcfinput%%.*}
+    
+    rm -f out/$dcfinput
+    rm -f out/$dcfinput.*
+    
+    echo "---------------------------"
+    echo "Test: ${dcfinput}"
+    
+    for level in none all size
+    do
+        case $level in
+            none) ${DCC} -o out/${dcfinput}_$level.s $input ;;
+            all) ${DCC} --opt-all -o out/${dcfinput}_$level.s $input ;;
+            size) ${DCC} -Os -o out/${dcfinput}_$level.s $input ;;
+        esac
+        if [ -e out/${dcfinput}_$level.s ]
+        then
+            gcc out/${dcfinput}_$level.s -o out/${dcfinput}_$level 2> out/${dcfinput}_$level.log
+            if [ -e out/${dcfinput}_$level ]
+            then
+                out/${dcfinput}_$level > out/${dcfinput}_$level.output
+                echo "exit status $?" >> out/${dcfinput}_$level.output
+                diff out/${dcfinput}_$level.output testdata/optimizer/bounds/output/$dcfinput.out > /dev/null
+                if [ $? -eq "0" ] && [ `grep -c "^\.BOUNDSFAIL:" out/${dcfinput}_$level.s` -eq 1 ]
+                then
+                    echo "PASS: ${input} ($level)."
+                else
+                    echo "FAIL: ${input} ($level) did not fail the bounds check as expected."
+                fi
+            else
+                echo "FAIL: Failed to link ${input} ($level)."
+            fi
+        else
+            echo "FAIL: Failed to compile ${input} ($level)."
+        fi
+    done
+done
+
+# The --blocks dump estimates how often each block runs per call of its
+# method; the block lines are compared with those expected.
+TESTFILES=testdata/optimizer/blocks/*.dcf
+
+for input in ${TESTFILES}
+do
+    dcfinput=${input##*/}
+    dcfinput=${dcfinput%%.*}
+    
+    rm -f out/$dcfinput
+    rm -f out/$dcfinput.*
+    
+    echo "---------------------------"
+    echo "Test: ${dcfinput}"
+    
+    ${DCC} --blocks -o out/$dcfinput.s $input > out/$dcfinput.dump
+    if [ -e out/$dcfinput.s ]
+    then
+        grep "^Block\[" out/$dcfinput.dump > out/$dcfinput.output
+        diff out/$dcfinput.output testdata/optimizer/blocks/output/$dcfinput.out > /dev/null
+        if [ $? -eq "0" ]
+        then
+            echo "PASS: ${input}."
+        else
+            echo "FAIL: ${input} did not estimate the expected block frequencies."
+        fi
+    else
+        echo "FAIL: Failed to compile ${input}."
+    fi
+done
+
 
 echo "Running dcc optimization performance tests."
 
@@ -104,7 +465,7 @@ do
     ${DCC} --opt-all -o out/$dcfinput.s $input
     if [ -e out/$dcfinput.s ]
     then    
-        gcc out/$dcfinput.s out/6035.o -o out/$dcfinput 2> out/$dcfinput.log
+        gcc out/$dcfinput.s out/6035.o -o out/$dcfinput -lpthread 2> out/$dcfinput.log
         if [ -e out/$dcfinput ]
         then
             cd out
@@ -120,7 +481,34 @@ do
     ${DCC} -o out/${dcfinput}_none.s $input
     if [ -e out/${dcfinput}_none.s ]
     then    
-        gcc out/${dcfinput}_none.s out/6035.o -o out/${dcfinput}_none 2> out/$dcfinput.log
+        gcc out/${dcfinput}_none.s out/6035.o -o out/${dcfinput}_none -lpthread 2> out/$dcfinput.log
+    fi
+    
+    # Parallelized loops run on the runtime's thread pool (DCC_NUM_THREADS);
+    # the image they write must match the reference one.
+    image=`sed -n 's/.*"pgm_open_for_write", "\([^"]*\)".*/\1/p' $input`
+    ${DCC} --opt-all --opt-parallelize -o out/${dcfinput}_par.s $input
+    if [ -e out/${dcfinput}_par.s ]
+    then    
+        gcc out/${dcfinput}_par.s out/6035.o -o out/${dcfinput}_par -lpthread 2> out/$dcfinput.log
+        if [ -e out/${dcfinput}_par ]
+        then
+            rm -f out/$image
+            cd out
+            DCC_NUM_THREADS=4 ./${dcfinput}_par > ${dcfinput}_par.output
+            cd ..
+            cmp -s out/$image testdata/optimizer/tests/$image
+            if [ $? -eq "0" ]
+            then
+                echo "PASS: ${input} (parallel)."
+            else
+                echo "FAIL: ${input} (parallel) did not write the expected ${image}."
+            fi
+        else
+            echo "FAIL: Failed to link ${input} (parallel)."
+        fi
+    else
+        echo "FAIL: Failed to compile ${input} (parallel)."
     fi
         
 done
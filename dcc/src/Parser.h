@@ -23,7 +23,27 @@ enum class Optimization : int
     BASIC_BLOCKS_DEAD_CODE,
     BASIC_BLOCKS_ALL,
     GLOBAL_CSE,
-    ALL
+    LOAD_STORE_ELIM,
+    PARTIAL_REDUNDANCY,
+    COPY_PROPAGATION,
+    DEAD_CODE_ELIM,
+    SIMPLIFY_CFG,
+    INTERPROCEDURAL_CONSTANTS,
+    LOOP_FUSION,
+    PARALLELIZE,
+    LOOP_UNSWITCH,
+    LOOP_UNROLL,
+    SCALAR_REPLACEMENT,
+    CONSTANT_PROPAGATION,
+    IF_CONVERSION,
+    BLOCK_LAYOUT,
+    SCHEDULING,
+    OUTLINING,
+    DEAD_DECLARATIONS,
+    LEVEL_1,
+    LEVEL_2,
+    ALL,
+    SIZE
 };
 
 #undef Parser
@@ -48,6 +68,17 @@ class Parser: public ParserBase
     
     std::vector<Optimization> m_optimizations;
     IrBasicBlockOpts m_blockOpts;
+    int m_unrollFactor;
+    int m_cloneBudget;
+    bool m_scheduleBeforeSlots;
+    bool m_scheduleAfterSlots;
+    bool m_iterate;
+    bool m_customPipeline;
+    IrPipeline m_pipeline;
+    bool m_enablePassStats;
+    bool m_profileGenerate;
+    std::string m_profileUse;
+    std::string m_profileSample;
     bool m_enableIrOutput;
     bool m_enableBasicBlocksOutput;
         
@@ -59,6 +90,17 @@ class Parser: public ParserBase
             d_ctx(nullptr),
             d_optimizer(nullptr),
             m_blockOpts(BBOPTS_NONE),
+            m_unrollFactor(4),
+            m_cloneBudget(400),
+            m_scheduleBeforeSlots(true),
+            m_scheduleAfterSlots(false),
+            m_iterate(false),
+            m_customPipeline(false),
+            m_pipeline(),
+            m_enablePassStats(false),
+            m_profileGenerate(false),
+            m_profileUse(),
+            m_profileSample(),
             m_enableIrOutput(false),
             m_enableBasicBlocksOutput(false)
         {
@@ -73,6 +115,17 @@ class Parser: public ParserBase
             d_ctx(nullptr),
             d_optimizer(nullptr),
             m_blockOpts(BBOPTS_NONE),            
+            m_unrollFactor(4),
+            m_cloneBudget(400),
+            m_scheduleBeforeSlots(true),
+            m_scheduleAfterSlots(false),
+            m_iterate(false),
+            m_customPipeline(false),
+            m_pipeline(),
+            m_enablePassStats(false),
+            m_profileGenerate(false),
+            m_profileUse(),
+            m_profileSample(),
             m_enableIrOutput(false),
             m_enableBasicBlocksOutput(false)
        {
@@ -88,10 +141,47 @@ class Parser: public ParserBase
         }
         void enableOpt(Optimization which)
         {
-            if (which == Optimization::ALL)
+            if (which == Optimization::LEVEL_1)
+            {
+                // the local optimizations and the cheap global cleanups
+                m_blockOpts = BBOPTS_ALL;
+                m_optimizations.push_back(Optimization::CONSTANT_PROPAGATION);
+                m_optimizations.push_back(Optimization::COPY_PROPAGATION);
+                m_optimizations.push_back(Optimization::DEAD_CODE_ELIM);
+                m_optimizations.push_back(Optimization::SIMPLIFY_CFG);
+            }
+            else if (which == Optimization::LEVEL_2 || which == Optimization::ALL || which == Optimization::SIZE)
             {
                 m_blockOpts = BBOPTS_ALL;
                 m_optimizations.push_back(Optimization::GLOBAL_CSE);
+                m_optimizations.push_back(Optimization::LOAD_STORE_ELIM);
+                m_optimizations.push_back(Optimization::PARTIAL_REDUNDANCY);
+                m_optimizations.push_back(Optimization::COPY_PROPAGATION);
+                m_optimizations.push_back(Optimization::DEAD_CODE_ELIM);
+                m_optimizations.push_back(Optimization::SCALAR_REPLACEMENT);
+                m_optimizations.push_back(Optimization::CONSTANT_PROPAGATION);
+                m_optimizations.push_back(Optimization::INTERPROCEDURAL_CONSTANTS);
+                m_optimizations.push_back(Optimization::SIMPLIFY_CFG);
+                m_optimizations.push_back(Optimization::LOOP_FUSION);
+                m_optimizations.push_back(Optimization::IF_CONVERSION);
+                m_optimizations.push_back(Optimization::SCHEDULING);
+                m_optimizations.push_back(Optimization::DEAD_DECLARATIONS);
+                
+                // code size is traded for speed by copying loops and aligning
+                // their headers, and the other way around by outlining; -O3
+                // also repeats the global cleanups until they settle
+                if (which == Optimization::ALL)
+                {
+                    m_optimizations.push_back(Optimization::LOOP_UNSWITCH);
+                    m_optimizations.push_back(Optimization::LOOP_UNROLL);
+                    m_optimizations.push_back(Optimization::BLOCK_LAYOUT);
+                    m_iterate = true;
+                }
+                else if (which == Optimization::SIZE)
+                {
+                    m_optimizations.push_back(Optimization::OUTLINING);
+                    m_cloneBudget = 0;
+                }
             }
             else if (which == Optimization::BASIC_BLOCKS_CONST_FOLDING)
             {
@@ -118,6 +208,42 @@ class Parser: public ParserBase
                 m_optimizations.push_back(which);
             }
         }
+        void setUnrollFactor(int factor)
+        {
+            m_unrollFactor = factor;
+        }
+        void setCloneBudget(int budget)
+        {
+            m_cloneBudget = budget;
+        }
+        // Runs these passes, in this order, instead of those the enabled
+        // optimizations select; false with the reason in 'error'.
+        bool setPasses(const std::string& passes, std::string& error)
+        {
+            m_customPipeline = IrPassManager::parsePipeline(passes, m_pipeline, error);
+            return m_customPipeline;
+        }
+        void enablePassStats()
+        {
+            m_enablePassStats = true;
+        }
+        void setSchedulePasses(bool beforeSlots, bool afterSlots)
+        {
+            m_scheduleBeforeSlots = beforeSlots;
+            m_scheduleAfterSlots = afterSlots;
+        }
+        void enableProfileGenerate()
+        {
+            m_profileGenerate = true;
+        }
+        void setProfileUse(const std::string& filename)
+        {
+            m_profileUse = filename;
+        }
+        void setProfileSample(const std::string& filename)
+        {
+            m_profileSample = filename;
+        }
         void enableIrOutput()
         {
             m_enableIrOutput = true;
@@ -131,13 +257,23 @@ class Parser: public ParserBase
         {
             if (d_program)
             {
-                d_program->allocate(d_ctx);
-    
-                d_program->codegen(d_ctx);
+                {
+                    IrScopedTimer timer("allocate");
+                    d_program->allocate(d_ctx);
+                }
+                {
+                    IrScopedTimer timer("codegen");
+                    d_program->codegen(d_ctx);
+                }
                 
                 // convert generated TAC into basic blocks and optimize
-                std::vector<IrTacStmt> statements = optimize(d_ctx->getStatements());
+                std::vector<IrTacStmt> statements;
+                {
+                    IrScopedTimer timer("optimize");
+                    statements = optimize(d_ctx->getStatements());
+                }
                 
+                IrScopedTimer timer("emit");
                 d_ctx->setStatements(statements);
                 
                 // write string table
@@ -155,6 +291,10 @@ class Parser: public ParserBase
                 }
     
                 // convert TAC into x86_64 assembly
+                if (isEnabled(Optimization::OUTLINING))
+                {
+                    d_ctx->enableOutlining();
+                }
                 d_ctx->codegen(d_scanner.outStream());
             }
             return false;
@@ -168,7 +308,11 @@ class Parser: public ParserBase
         { 
             if (d_program) 
             {
-                d_program->propagateTypes(d_ctx);
+                {
+                    IrScopedTimer timer("propagate-types");
+                    d_program->propagateTypes(d_ctx);
+                }
+                IrScopedTimer timer("analyze");
                 return d_program->analyze(d_ctx); 
             }
             return false; 
@@ -177,19 +321,46 @@ class Parser: public ParserBase
         {
             d_optimizer->generateBasicBlocks(statements);
             
+            // 'parallel for' loops are always outlined, optimizing or not
+            {
+                IrScopedTimer timer("lower-parallel");
+                d_optimizer->lowerParallelLoops();
+            }
+            
+            // profiles are taken on, and applied to, the code as the front end
+            // produced it so both builds see the same flow graphs
+            if (m_profileGenerate)
+            {
+                IrScopedTimer timer("profile");
+                d_optimizer->instrumentProfile(getProfileFilename());
+            }
+            else if (!m_profileUse.empty())
+            {
+                IrScopedTimer timer("profile");
+                d_optimizer->applyProfile(m_profileUse);
+            }
+            else if (!m_profileSample.empty())
+            {
+                IrScopedTimer timer("profile");
+                d_optimizer->applySampleProfile(m_profileSample);
+            }
+            
             std::sort(m_optimizations.begin(), m_optimizations.end());
             m_optimizations.erase(std::unique(m_optimizations.begin(), m_optimizations.end()), m_optimizations.end());
             
-            d_optimizer->basicBlocksOptimizations(m_blockOpts);                    
+            IrPassOptions options;
+            options.m_blockOpts = m_blockOpts;
+            options.m_unrollFactor = m_unrollFactor;
+            options.m_cloneBudget = m_cloneBudget;
+            options.m_sourceName = d_ctx->sourceFilename();
+            // a 'bb' asked for by name does all the local optimizations unless
+            // some were picked
+            if (m_customPipeline && m_blockOpts == BBOPTS_NONE) options.m_blockOpts = BBOPTS_ALL;
+            
+            IrPassManager passes(*d_optimizer, options);
+            passes.run(m_customPipeline ? m_pipeline : getPipeline());
+            if (m_enablePassStats) passes.printStats(std::cerr);
             
-            // apply requested optimizations in the required order
-            for (auto it : m_optimizations)
-            {
-                if (it == Optimization::GLOBAL_CSE)
-                {
-                    d_optimizer->globalCommonSubexpressionElimination();
-                }
-            }
             d_optimizer->generateStatements();
             
             if (m_enableBasicBlocksOutput) d_optimizer->print();
@@ -198,6 +369,69 @@ class Parser: public ParserBase
         }
 
     private:
+        bool isEnabled(Optimization which) const
+        {
+            return std::binary_search(m_optimizations.begin(), m_optimizations.end(), which);
+        }
+        // The passes the enabled optimizations select, in the order they need.
+        IrPipeline getPipeline() const
+        {
+            IrPipeline pipeline;
+            auto add = [&pipeline](const std::string& pass)
+            {
+                IrPipelineStep step;
+                step.m_passes.push_back(pass);
+                pipeline.push_back(step);
+            };
+            
+            // loop restructuring and global propagation run first so the new blocks 
+            // get the local optimizations; constant arguments reach the loops of their
+            // callees first, unswitching leaves straight-line bodies to unroll, 
+            // unrolling exposes literal indices to scalar replacement, whose
+            // elements constant propagation then folds
+            if (isEnabled(Optimization::INTERPROCEDURAL_CONSTANTS)) add("ipcp");
+            if (isEnabled(Optimization::LOOP_FUSION)) add("loop-fusion");
+            if (isEnabled(Optimization::PARALLELIZE)) add("parallelize");
+            if (isEnabled(Optimization::LOOP_UNSWITCH)) add("unswitch");
+            if (isEnabled(Optimization::LOOP_UNROLL)) add("unroll");
+            if (isEnabled(Optimization::SCALAR_REPLACEMENT)) add("scalar-repl");
+            if (isEnabled(Optimization::CONSTANT_PROPAGATION)) add("const-prop");
+            
+            // CFG simplification drops the labels the loop matching relies on, so it
+            // starts after loop restructuring and reruns after each later phase
+            const bool simplifyCfg = isEnabled(Optimization::SIMPLIFY_CFG);
+            if (simplifyCfg) add("simplify-cfg");
+            if (m_blockOpts != BBOPTS_NONE) add("bb");
+            if (simplifyCfg) add("simplify-cfg");
+            
+            // the global cleanups feed each other: the copies redundancy elimination
+            // leaves are propagated, which leaves dead code, which hides loads
+            if (isEnabled(Optimization::GLOBAL_CSE)) add("gcse");
+            IrPipelineStep cleanup;
+            cleanup.m_fixpoint = m_iterate;
+            if (isEnabled(Optimization::LOAD_STORE_ELIM)) cleanup.m_passes.push_back("load-store");
+            if (isEnabled(Optimization::PARTIAL_REDUNDANCY)) cleanup.m_passes.push_back("pre");
+            if (isEnabled(Optimization::COPY_PROPAGATION)) cleanup.m_passes.push_back("copy-prop");
+            if (isEnabled(Optimization::DEAD_CODE_ELIM)) cleanup.m_passes.push_back("dce");
+            if (!cleanup.m_passes.empty()) pipeline.push_back(cleanup);
+            if (simplifyCfg) add("simplify-cfg");
+            
+            // branches become conditional moves on the final control flow, and 
+            // blocks are placed once the branches that remain are known
+            if (isEnabled(Optimization::IF_CONVERSION)) add("if-convert");
+            if (isEnabled(Optimization::BLOCK_LAYOUT)) add("layout");
+            
+            // whole program: what main no longer reaches goes before the code is final
+            if (isEnabled(Optimization::DEAD_DECLARATIONS)) add("dead-decls");
+            
+            // temporaries get their frame slots once the code is final; scheduling
+            // before has the most freedom, after it sees the slots they share
+            const bool schedule = isEnabled(Optimization::SCHEDULING);
+            if (schedule && m_scheduleBeforeSlots) add("schedule");
+            add("slots");
+            if (schedule && m_scheduleAfterSlots) add("schedule-post");
+            return pipeline;
+        }
         void error();                   // called on (syntax) errors
         int lex();                      // returns the next token from the
                                         // lexical scanner. 
@@ -205,6 +439,15 @@ class Parser: public ParserBase
         IrProgram* getProgram() { return d_program; }
         void exceptionHandler(std::exception const &exc);
         const std::string& line(size_t line_num) const;     
+        // <source>.prof in the directory the program runs in
+        std::string getProfileFilename() const
+        {
+            std::string name = d_ctx->sourceFilename();
+            name = name.substr(name.find_last_of('/') + 1);
+            name = name.substr(0, name.find_last_of('.'));
+            if (name.empty()) name = "decaf";
+            return name + ".prof";
+        }
         void preloadSource(const std::string &infile);
 
     // support functions for parse():
@@ -33,7 +33,7 @@
 
 %token RETURN CALLOUT
 %token BOOLTYPE INTTYPE DOUBLETYPE STRINGTYPE CLASS VOID
-%token IF SWITCH CASE DEFAULT FOR DO CONTINUE BREAK GOTO WHILE
+%token IF SWITCH CASE DEFAULT FOR DO CONTINUE BREAK GOTO WHILE PARALLEL
 %token INTERFACE NULLVALUE EXTENDS IMPLEMENTS THIS NEW
 
 %token IDENTIFIER INTEGER BOOLEAN CHARACTER STRING DOUBLE
@@ -563,6 +563,14 @@ statement
     { 
         $$ = new Decaf::IrForStatement(@1.first_line, @1.first_column, d_scanner.filename(), IrExpressionPtr($3), IrExpressionPtr($5), IrExpressionPtr($7), IrStatementPtr($9)); 
     }
+    | PARALLEL FOR LPAREN expr SEMI expr SEMI expr RPAREN statement 
+    { 
+        $$ = new Decaf::IrParallelForStatement(@1.first_line, @1.first_column, d_scanner.filename(), nullptr, IrExpressionPtr($4), IrExpressionPtr($6), IrExpressionPtr($8), IrStatementPtr($10)); 
+    }
+    | PARALLEL LPAREN ident RPAREN FOR LPAREN expr SEMI expr SEMI expr RPAREN statement 
+    { 
+        $$ = new Decaf::IrParallelForStatement(@1.first_line, @1.first_column, d_scanner.filename(), IrIdentifierPtr($3), IrExpressionPtr($7), IrExpressionPtr($9), IrExpressionPtr($11), IrStatementPtr($13)); 
+    }
     | WHILE LPAREN expr RPAREN statement
     {
         $$ = new Decaf::IrWhileStatement(@1.first_line, @1.first_column, d_scanner.filename(), IrExpressionPtr($3), IrStatementPtr($5)); 
@@ -27,6 +27,8 @@
 #include "IrBase.h"
 #include "IrBasicBlock.h"
 #include "IrOptimizer.h"
+#include "IrPassManager.h"
+#include "IrTimer.h"
 
 #include "IrAssignExpr.h"
 #include "IrBinaryExpr.h"
@@ -55,6 +57,7 @@
 #include "IrMethodCall.h"
 #include "IrMethodDecl.h"
 #include "IrNullLiteral.h"
+#include "IrParallelForStmt.h"
 #include "IrProgram.h"
 #include "IrReturnStmt.h"
 #include "IrStatement.h"
@@ -23,11 +23,14 @@
 //
 #include <iostream>
 #include <cassert>
+#include <sstream>
 #include "IrCommon.h"
 #include "IrAssignExpr.h"
 #include "IrTravCtx.h"
 #include "IrLocation.h"
+#include "IrIdentifier.h"
 #include "IrLiteral.h"
+#include "IrParallelForStmt.h"
 
 namespace Decaf
 {
@@ -164,6 +167,20 @@ bool IrAssignExpression::analyze(IrTraversalContext* ctx)
         }
     }
     
+    // Rule: iterations of a parallel for loop may not carry scalar values to each other.
+    const IrParallelForStatement* parallel = IrParallelForStatement::FindEnclosing(ctx);
+    IrLocation* location = dynamic_cast<IrLocation*>(m_lhs.get());
+    if (parallel && location && !location->getIndex())
+    {
+        if (!ctx->isDeclaredWithin(location, ctx->getNumSymbols() - parallel->getOuterScopes()))
+        {
+            std::stringstream msg;
+            msg << "scalar '" << location->getIdentifier()->getIdentifier() << "' declared outside a parallel for loop may not be assigned in its body.";
+            ctx->error(this, msg.str());
+            valid = false;
+        }
+    }
+    
     ctx->popParent();
     
     return valid;
@@ -209,8 +226,8 @@ bool IrAssignExpression::codegen(IrTraversalContext* ctx)
     {        
         // TAC:
         // MOV rhs lhs ||
-        // ADD rhs lhs lhs ||
-        // SUB rhs lhs lhs
+        // ADD lhs rhs lhs ||
+        // SUB lhs rhs lhs
         IrTacStmt tac(opcodeFor(m_operator), getLineNumber());
         if (m_rhs != nullptr)
         {
@@ -231,7 +248,8 @@ bool IrAssignExpression::codegen(IrTraversalContext* ctx)
             
             if (m_operator != IrAssignmentOperator::Assign)
             {
-                tac.m_src1 = tac.m_dst;
+                tac.m_src1 = tac.m_src0;
+                tac.m_src0 = tac.m_dst;
             }
         }
         ctx->append(tac);
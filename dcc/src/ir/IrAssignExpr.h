@@ -48,6 +48,10 @@ public:
     virtual bool codegen(IrTraversalContext* ctx);
     virtual const std::string& asString() const;
     
+    IrAssignmentOperator getOperator() const { return m_operator; }
+    IrExpressionPtr getLeftHandSide() const { return m_lhs; }
+    IrExpressionPtr getRightHandSide() const { return m_rhs; }
+    
 protected:    
   
     IrAssignmentOperator m_operator;
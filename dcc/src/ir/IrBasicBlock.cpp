@@ -24,6 +24,7 @@
 #include <iostream>
 #include <sstream>
 #include <list>
+#include <unordered_set>
 #include <algorithm>
 #include <cassert>
 #include "IrBasicBlock.h"
@@ -128,8 +129,11 @@ int IrBasicBlock::getValueNumber(const std::string& ident, std::unordered_map<st
     return valueNumber;
 }
 
-void IrBasicBlock::optimize(IrBasicBlockOpts which)
+bool IrBasicBlock::optimize(IrBasicBlockOpts which, const std::unordered_set<std::string>& sharedTemps)
 {
+    // the local optimizations rewrite in place and do not track what they did
+    const std::vector<IrTacStmt> before = m_statements;
+    
     if (which & BBOPTS_CONSTANT_FOLDING)
         constantFolding();  
     if (which & BBOPTS_ALGEBRAIC_SIMP)
@@ -139,7 +143,14 @@ void IrBasicBlock::optimize(IrBasicBlockOpts which)
     if (which & BBOPTS_COPY_PROP)
         copyPropagation();
     if (which & BBOPTS_DEAD_CODE_ELIM)
-        deadCodeElimination(); 
+        deadCodeElimination(sharedTemps);
+    
+    if (before.size() != m_statements.size()) return true;
+    for (size_t n = 0; n < before.size(); n++)
+    {
+        if (!isSameStatement(before[n], m_statements[n])) return true;
+    }
+    return false;
 }
 
 void IrBasicBlock::generateDefinitions()
@@ -166,6 +177,12 @@ void IrBasicBlock::constantFolding()
             continue;
         }
         
+        // a division by zero is left to fault at run time, as written
+        if ((it->m_opcode == IrOpcode::DIV || it->m_opcode == IrOpcode::MOD) && isIntegerZero(it->m_src1))
+        {
+            continue;
+        }
+        
         // check for expression with constant results
         const bool exprIsIntConstant = isIntLiteral(it->m_src0) && isIntLiteral(it->m_src1);
         const bool exprIsBoolConstant = isBoolLiteral(it->m_src0) && isBoolLiteral(it->m_src1);
@@ -326,14 +343,42 @@ void IrBasicBlock::commonSubexpressionElimination()
     // Temp var for each expression in block.
     std::unordered_map<Key, IrTacArg, KeyHasher> expression_temp_map;
     
+    // Globals numbered so far; a call may write any of them.
+    std::unordered_set<std::string> global_set;
+    
+    // A variable written gets a new value, and a temp holding an expression
+    // no longer holds it once written again.
+    auto redefine = [&](const std::string& name)
+    {
+        variable_value_map[name] = m_next_value_number++;
+        for (auto tip = expression_temp_map.begin(); tip != expression_temp_map.end();)
+        {
+            if (tip->second.m_asString == name)
+                tip = expression_temp_map.erase(tip);
+            else
+                ++tip;
+        }
+    };
+    
     // Statement of form: D = L op R
     for (auto it = m_statements.begin(); it != m_statements.end(); ++it)
     {
         if (!isBinaryOp(it->m_opcode) && !isMoveOp(it->m_opcode) && !isLogicOp(it->m_opcode))
         {
+            const IrTacArg* def = getDefinedVariable(*it);
+            if (def != nullptr) redefine(def->m_asString);
+            if (it->m_opcode == IrOpcode::CALL)
+            {
+                for (const auto& global : global_set) redefine(global);
+            }
             continue;
         }
         
+        for (auto arg : { &it->m_src0, &it->m_src1, &it->m_dst })
+        {
+            if (arg->m_usage == IrUsage::Global) global_set.insert(arg->m_asString);
+        }
+        
         // Get/create the value numbers of D, L and R    
         it->m_src0.m_valueNumber = getValueNumber(it->m_src0.m_asString, variable_value_map);
         it->m_src0.m_isConstant = (it->m_src0.m_usage == IrUsage::Literal);
@@ -348,6 +393,7 @@ void IrBasicBlock::commonSubexpressionElimination()
             it->m_src1.m_valueNumber = -1;
         }
         
+        redefine(it->m_dst.m_asString);
         it->m_dst.m_valueNumber = getValueNumber(it->m_dst.m_asString, variable_value_map);
         assert(it->m_dst.m_usage != IrUsage::Literal);
         it->m_dst.m_isConstant = false;
@@ -355,15 +401,6 @@ void IrBasicBlock::commonSubexpressionElimination()
         // Create key from opcode, L and R.
         Key keyExpr(it->m_src0.m_valueNumber, it->m_opcode, it->m_src1.m_valueNumber);
            
-        if (isTempIdentifier(it->m_dst))
-        {
-            auto tip = expression_temp_map.find(keyExpr);
-            if (tip == expression_temp_map.end())
-            {
-                expression_temp_map[keyExpr] = it->m_dst;
-            }
-        }        
-        
         auto mip = expression_value_map.find(keyExpr);
         if (mip == expression_value_map.end())
         {
@@ -387,8 +424,16 @@ void IrBasicBlock::commonSubexpressionElimination()
                 it->m_opcode = IrOpcode::MOV;
                 it->m_src0 = tip->second;
                 it->m_src1.m_usage = IrUsage::Unused;
+                continue;
             }
         }
+        
+        // The first temp holding the expression (the value may have been
+        // computed into a variable before).
+        if (isTempIdentifier(it->m_dst))
+        {
+            expression_temp_map[keyExpr] = it->m_dst;
+        }
     }
     
     if (m_verbose)
@@ -417,12 +462,25 @@ void IrBasicBlock::commonSubexpressionElimination()
 void IrBasicBlock::copyPropagation()
 {
     std::map<std::string, IrTacArg> temp_to_var_map;
-    std::map<std::string, std::string> var_to_temp_map;
     
     for (auto it = m_statements.begin(); it != m_statements.end(); ++it)
     {
+        // a copy no longer holds once either side is written, or a call may
+        // have written the global it copied
+        const IrTacArg* def = getDefinedVariable(*it);
+        const std::string defKey = (def != nullptr) ? getOperandKey(*def) : "";
+        for (auto tip = temp_to_var_map.begin(); tip != temp_to_var_map.end();)
+        {
+            const bool clobbered = (it->m_opcode == IrOpcode::CALL && tip->second.m_usage == IrUsage::Global);
+            if (clobbered || (def != nullptr && getOperandKey(tip->second) == defKey))
+                tip = temp_to_var_map.erase(tip);
+            else
+                ++tip;
+        }
+        
         if (!isBinaryOp(it->m_opcode) && !isMoveOp(it->m_opcode) && !isLogicOp(it->m_opcode))
         {
+            if (def != nullptr) temp_to_var_map.erase(def->m_asString);
             continue;
         }
 
@@ -442,59 +500,44 @@ void IrBasicBlock::copyPropagation()
                 it->m_src1 = tip->second;
             }			
 		}
-        if (isTempIdentifier(it->m_dst))
+        if (def != nullptr) temp_to_var_map.erase(def->m_asString);
+        if (isTempIdentifier(it->m_dst) && isMoveOp(it->m_opcode) && getOperandKey(it->m_src0) != defKey)
         {
-			if (isMoveOp(it->m_opcode))
-			{
-				temp_to_var_map[it->m_dst.m_asString] = it->m_src0;
-				var_to_temp_map[it->m_src0.m_asString] = it->m_dst.m_asString;
-			}
+            temp_to_var_map[it->m_dst.m_asString] = it->m_src0;
         }
-        else
-        {
-			if (isMoveOp(it->m_opcode))
-			{
-				auto vip = var_to_temp_map.find(it->m_dst.m_asString);
-				if (vip != var_to_temp_map.end())
-				{
-					auto tip = temp_to_var_map.find(vip->second);
-					if (tip != temp_to_var_map.end())
-					{
-						temp_to_var_map.erase(tip);
-					}
-					var_to_temp_map.erase(vip);
-				}
-			}
-		}
     }
 }
     
-void IrBasicBlock::deadCodeElimination()
+// A copy into a temporary is dead when nothing later in the block reads the
+// temporary and no other block uses it.
+void IrBasicBlock::deadCodeElimination(const std::unordered_set<std::string>& sharedTemps)
 {
-    std::vector<std::string> needed_var_set;
+    std::unordered_set<std::string> read_temp_set;
+    std::vector<const IrTacArg*> used;
     
     for (auto it = m_statements.rbegin(); it != m_statements.rend(); ++it)
     {
-        if (!isMoveOp(it->m_opcode))
+        if (isMoveOp(it->m_opcode) && isTempIdentifier(it->m_dst) && 
+            !read_temp_set.count(it->m_dst.m_asString) && !sharedTemps.count(it->m_dst.m_asString))
         {
+            // copy not needed
+            it->m_opcode = IrOpcode::NOOP;
+            it->m_src0.m_usage = IrUsage::Unused;
+            it->m_src1.m_usage = IrUsage::Unused;
+            it->m_dst.m_usage = IrUsage::Unused;
             continue;
         }
         
-        if (isTempIdentifier(it->m_dst))
+        const IrTacArg* def = getDefinedVariable(*it);
+        if (def != nullptr) read_temp_set.erase(def->m_asString);
+        getUsedVariables(*it, used);
+        for (auto arg : { &it->m_src0, &it->m_src1, &it->m_dst })
         {
-            auto vip = std::find(needed_var_set.begin(), needed_var_set.end(), it->m_src0.m_asString);
-            if (vip != needed_var_set.end())
-            {
-                // copy not needed
-                it->m_opcode = IrOpcode::NOOP;
-                it->m_src0.m_usage = IrUsage::Unused;
-                it->m_src1.m_usage = IrUsage::Unused;
-                it->m_dst.m_usage = IrUsage::Unused;
-            }
-         }
-        else
+            if (arg != def) used.push_back(arg);
+        }
+        for (auto arg : used)
         {
-            needed_var_set.push_back(it->m_src0.m_asString);
+            if (isTempIdentifier(*arg)) read_temp_set.insert(arg->m_asString);
         }
     }
 }
@@ -26,7 +26,9 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include "IrTAC.h"
 #include "IrCommon.h"
 
@@ -61,7 +63,9 @@ public:
     bool isLabelUsedInBlock(const std::string& label) const;
     bool isLabelDefinedInBlock(const std::string& label) const;
     
-    void optimize(IrBasicBlockOpts which);
+    // True when any of the optimizations changed a statement; 'sharedTemps'
+    // are the temporaries other blocks also use.
+    bool optimize(IrBasicBlockOpts which, const std::unordered_set<std::string>& sharedTemps);
     void generateDefinitions();  
     
     void print(std::ostream& stream);
@@ -84,7 +88,7 @@ protected:
     void algebraicSimplification();
     void commonSubexpressionElimination();
     void copyPropagation();
-    void deadCodeElimination();
+    void deadCodeElimination(const std::unordered_set<std::string>& sharedTemps);
     
 private:
     IrBasicBlock(const IrBasicBlock& rhs) = delete;
@@ -0,0 +1,357 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include "IrBlockFrequency.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Ball and Larus' measured hit rates for the heuristics.
+const double LOOP_BRANCH_PROBABILITY = 0.88;
+const double LOOP_HEADER_PROBABILITY = 0.75;
+const double RETURN_PROBABILITY = 0.28;
+// Paths ending in exit() only run on errors.
+const double COLD_PROBABILITY = 0.001;
+// Keeps a loop that cannot be left from running forever in the estimate.
+const double MAX_CYCLIC_PROBABILITY = 0.999;
+// Blocks followed past unconditional jumps to find a loop or a return.
+const int MAX_CHAIN = 8;
+
+// Dempster-Shafer combination of two independent predictions of one edge.
+double combine(double p, double q)
+{
+    return (p * q) / (p * q + (1.0 - p) * (1.0 - q));
+}
+
+size_t findSuccessor(const IrFlowBlock& block, size_t succ)
+{
+    return std::find(block.m_succs.begin(), block.m_succs.end(), succ) - block.m_succs.begin();
+}
+
+} // namespace
+
+IrBlockFrequency::IrBlockFrequency(const std::vector<IrTacStmt>& stmts, const IrFlowGraph& graph) :
+    m_stmts(stmts),
+    m_graph(graph),
+    m_order(graph.reversePostorder()),
+    m_dominator(),
+    m_headers(),
+    m_loops(),
+    m_loopDepth(graph.size(), 0),
+    m_cold(graph.size(), false),
+    m_probability(graph.size()),
+    m_backEdgeProbability(graph.size()),
+    m_frequency(graph.size(), 0.0)
+{
+    if (m_order.empty()) return;
+    
+    findLoops();
+    findColdBlocks();
+    estimateProbabilities();
+    
+    for (size_t k = 0; k < m_headers.size(); k++)
+    {
+        propagate(m_headers[k], m_loops[k]);
+    }
+    std::vector<bool> reachable(graph.size(), false);
+    for (auto b : m_order)
+    {
+        reachable[b] = true;
+    }
+    propagate(m_order.front(), reachable);
+    
+    // blocks that were counted run as often as they did in the profile; labels
+    // and jumps added by the passes have no count of their own
+    const long entries = stmts[graph[0].m_first].m_count;
+    if (entries <= 0) return;
+    for (auto b : m_order)
+    {
+        long count = -1;
+        for (size_t k = graph[b].m_first; k < graph[b].m_last; k++)
+        {
+            count = std::max(count, stmts[k].m_count);
+        }
+        if (count >= 0) m_frequency[b] = (double)count / (double)entries;
+    }
+}
+
+double IrBlockFrequency::getEdgeProbability(size_t from, size_t to) const
+{
+    const size_t i = findSuccessor(m_graph[from], to);
+    return (i < m_probability[from].size()) ? m_probability[from][i] : 0.0;
+}
+
+bool IrBlockFrequency::isLoopHeader(size_t block) const
+{
+    return std::find(m_headers.begin(), m_headers.end(), block) != m_headers.end();
+}
+
+// Natural loops of the back edges, whose targets dominate their sources.
+void IrBlockFrequency::findLoops()
+{
+    const size_t N = m_graph.size();
+    const size_t NONE = N;
+    std::vector<size_t> position(N, NONE);
+    for (size_t k = 0; k < m_order.size(); k++)
+    {
+        position[m_order[k]] = k;
+    }
+    
+    // Cooper, Harvey and Kennedy's iterative dominators
+    m_dominator.assign(N, NONE);
+    m_dominator[m_order.front()] = m_order.front();
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t k = 1; k < m_order.size(); k++)
+        {
+            const size_t b = m_order[k];
+            size_t idom = NONE;
+            for (auto p : m_graph[b].m_preds)
+            {
+                if (m_dominator[p] == NONE) continue;
+                if (idom == NONE)
+                {
+                    idom = p;
+                    continue;
+                }
+                size_t x = p, y = idom;
+                while (x != y)
+                {
+                    while (position[x] > position[y]) x = m_dominator[x];
+                    while (position[y] > position[x]) y = m_dominator[y];
+                }
+                idom = x;
+            }
+            if (idom != m_dominator[b])
+            {
+                m_dominator[b] = idom;
+                changed = true;
+            }
+        }
+    }
+    auto dominates = [&](size_t a, size_t b)
+    {
+        while (b != a && m_dominator[b] != b && m_dominator[b] != NONE) b = m_dominator[b];
+        return (a == b);
+    };
+    
+    for (auto b : m_order)
+    {
+        for (auto s : m_graph[b].m_succs)
+        {
+            if (!dominates(s, b)) continue;
+            
+            auto it = std::find(m_headers.begin(), m_headers.end(), s);
+            if (it == m_headers.end())
+            {
+                m_headers.push_back(s);
+                m_loops.push_back(std::vector<bool>(N, false));
+                it = m_headers.end() - 1;
+            }
+            std::vector<bool>& loop = m_loops[it - m_headers.begin()];
+            loop[s] = true;
+            std::vector<size_t> work(1, b);
+            while (!work.empty())
+            {
+                const size_t n = work.back();
+                work.pop_back();
+                if (loop[n] || position[n] == NONE) continue;
+                loop[n] = true;
+                work.insert(work.end(), m_graph[n].m_preds.begin(), m_graph[n].m_preds.end());
+            }
+        }
+    }
+    
+    // a loop nested in another has fewer blocks
+    std::vector<size_t> index(m_headers.size());
+    for (size_t k = 0; k < index.size(); k++)
+    {
+        index[k] = k;
+    }
+    auto size = [&](size_t k) { return std::count(m_loops[k].begin(), m_loops[k].end(), true); };
+    std::stable_sort(index.begin(), index.end(), [&](size_t a, size_t b) { return size(a) < size(b); });
+    std::vector<size_t> headers;
+    std::vector<std::vector<bool>> loops;
+    for (auto k : index)
+    {
+        headers.push_back(m_headers[k]);
+        loops.push_back(m_loops[k]);
+    }
+    m_headers.swap(headers);
+    m_loops.swap(loops);
+    
+    for (const auto& loop : m_loops)
+    {
+        for (size_t b = 0; b < N; b++)
+        {
+            if (loop[b]) m_loopDepth[b]++;
+        }
+    }
+}
+
+// Blocks that call exit, and blocks all of whose successors are cold.
+void IrBlockFrequency::findColdBlocks()
+{
+    for (size_t b = 0; b < m_graph.size(); b++)
+    {
+        for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+        {
+            const IrTacStmt& stmt = m_stmts[n];
+            if (stmt.m_opcode == IrOpcode::CALL && (stmt.m_src0.m_asString == "exit" || stmt.m_src0.m_asString == "abort"))
+                m_cold[b] = true;
+        }
+    }
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto it = m_order.rbegin(); it != m_order.rend(); ++it)
+        {
+            const IrFlowBlock& block = m_graph[*it];
+            if (m_cold[*it] || block.m_succs.empty()) continue;
+            
+            m_cold[*it] = std::all_of(block.m_succs.begin(), block.m_succs.end(), [&](size_t s) { return m_cold[s]; });
+            changed |= m_cold[*it];
+        }
+    }
+}
+
+bool IrBlockFrequency::isInLoop(size_t block, size_t header) const
+{
+    const size_t k = std::find(m_headers.begin(), m_headers.end(), header) - m_headers.begin();
+    return (k < m_loops.size()) && m_loops[k][block];
+}
+
+bool IrBlockFrequency::entersLoop(size_t from, size_t block) const
+{
+    for (int k = 0; k < MAX_CHAIN; k++)
+    {
+        if (std::find(m_headers.begin(), m_headers.end(), block) != m_headers.end() && !isInLoop(from, block)) return true;
+        if (m_graph[block].m_succs.size() != 1) return false;
+        block = m_graph[block].m_succs.front();
+    }
+    return false;
+}
+
+bool IrBlockFrequency::leadsToReturn(size_t block) const
+{
+    for (int k = 0; k < MAX_CHAIN; k++)
+    {
+        const IrFlowBlock& b = m_graph[block];
+        if (m_stmts[b.m_last - 1].m_opcode == IrOpcode::RETURN) return true;
+        if (b.m_succs.size() != 1) return false;
+        block = b.m_succs.front();
+    }
+    return false;
+}
+
+void IrBlockFrequency::estimateProbabilities()
+{
+    for (auto b : m_order)
+    {
+        const IrFlowBlock& block = m_graph[b];
+        m_backEdgeProbability[b].assign(block.m_succs.size(), 0.0);
+        if (block.m_succs.size() != 2)
+        {
+            m_probability[b].assign(block.m_succs.size(), 1.0);
+            continue;
+        }
+        
+        // measured branches need no guessing; the second successor is the target
+        const IrTacStmt& branch = m_stmts[block.m_last - 1];
+        if (branch.m_count > 0 && branch.m_taken >= 0)
+        {
+            const double taken = std::min(1.0, (double)branch.m_taken / (double)branch.m_count);
+            m_probability[b] = { 1.0 - taken, taken };
+            continue;
+        }
+        
+        // probability of the first successor, the fall-through
+        const size_t s0 = block.m_succs[0];
+        const size_t s1 = block.m_succs[1];
+        double p = 0.5;
+        
+        // the innermost loop around the branch keeps running
+        auto loop = std::find_if(m_headers.begin(), m_headers.end(), [&](size_t h) { return isInLoop(b, h); });
+        const bool isLoopBranch = (loop != m_headers.end()) && (isInLoop(s0, *loop) != isInLoop(s1, *loop));
+        if (isLoopBranch)
+            p = combine(p, isInLoop(s0, *loop) ? LOOP_BRANCH_PROBABILITY : 1.0 - LOOP_BRANCH_PROBABILITY);
+        
+        // a guard in front of a loop usually lets it run
+        const bool h0 = entersLoop(b, s0);
+        if (!isLoopBranch && h0 != entersLoop(b, s1))
+            p = combine(p, h0 ? LOOP_HEADER_PROBABILITY : 1.0 - LOOP_HEADER_PROBABILITY);
+        
+        if (m_cold[s0] != m_cold[s1])
+            p = combine(p, m_cold[s0] ? COLD_PROBABILITY : 1.0 - COLD_PROBABILITY);
+        
+        // leaving a loop for the end of the function is not an early return
+        const bool r0 = leadsToReturn(s0);
+        if (!isLoopBranch && r0 != leadsToReturn(s1))
+            p = combine(p, r0 ? RETURN_PROBABILITY : 1.0 - RETURN_PROBABILITY);
+        
+        m_probability[b] = { p, 1.0 - p };
+    }
+}
+
+// Frequencies of the blocks of 'region' relative to one entry into 'head',
+// in reverse postorder so forward predecessors are done first.  Loops met
+// on the way were propagated before and are scaled by 1 / (1 - cyclic).
+void IrBlockFrequency::propagate(size_t head, const std::vector<bool>& region)
+{
+    for (auto b : m_order)
+    {
+        if (!region[b]) continue;
+        
+        double frequency = 1.0;
+        if (b != head)
+        {
+            frequency = 0.0;
+            double cyclic = 0.0;
+            for (auto p : m_graph[b].m_preds)
+            {
+                if (!region[p]) continue;
+                const size_t i = findSuccessor(m_graph[p], b);
+                if (isInLoop(p, b))
+                    cyclic += m_backEdgeProbability[p][i];
+                else
+                    frequency += m_frequency[p] * m_probability[p][i];
+            }
+            frequency /= 1.0 - std::min(cyclic, MAX_CYCLIC_PROBABILITY);
+        }
+        m_frequency[b] = frequency;
+        
+        for (size_t i = 0; i < m_graph[b].m_succs.size(); i++)
+        {
+            if (m_graph[b].m_succs[i] == head) m_backEdgeProbability[b][i] = frequency * m_probability[b][i];
+        }
+    }
+}
+
+} // namespace Decaf
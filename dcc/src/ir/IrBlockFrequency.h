@@ -0,0 +1,82 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+#include <vector>
+#include "IrFlowGraph.h"
+#include "IrTAC.h"
+
+namespace Decaf
+{
+
+// Estimate of how often the blocks of an IrFlowGraph run, per entry to the
+// function.  Statements counted by a profile (IrTacStmt::m_count) give the
+// measured numbers.  Other branch probabilities come from the usual heuristics:
+// edges that stay in a loop or enter one are likely, paths that end in a
+// call to exit are cold and early returns are unlikely.  Block frequencies follow from
+// the probabilities with loops scaled by their cyclic probability, inner
+// loops first (Wu and Larus).
+class IrBlockFrequency
+{
+public:
+    IrBlockFrequency(const std::vector<IrTacStmt>& stmts, const IrFlowGraph& graph);
+    
+    // Probability that block 'from' continues to its successor 'to'.
+    double getEdgeProbability(size_t from, size_t to) const;
+    // Expected executions of a block per function entry; 0 if unreachable.
+    double getFrequency(size_t block) const { return m_frequency[block]; }
+    // Number of loops containing a block.
+    int getLoopDepth(size_t block) const { return m_loopDepth[block]; }
+    // True when a block is the target of a back edge.
+    bool isLoopHeader(size_t block) const;
+    // True when every path from the block ends in a call to exit.
+    bool isCold(size_t block) const { return m_cold[block]; }
+    
+private:
+    void findLoops();
+    void findColdBlocks();
+    void estimateProbabilities();
+    void propagate(size_t head, const std::vector<bool>& region);
+    
+    bool isInLoop(size_t block, size_t header) const;
+    bool entersLoop(size_t from, size_t block) const;
+    bool leadsToReturn(size_t block) const;
+    
+    const std::vector<IrTacStmt>& m_stmts;
+    const IrFlowGraph& m_graph;
+    std::vector<size_t> m_order;
+    std::vector<size_t> m_dominator;
+    // loop headers, innermost loops first, with the blocks of each loop
+    std::vector<size_t> m_headers;
+    std::vector<std::vector<bool>> m_loops;
+    std::vector<int> m_loopDepth;
+    std::vector<bool> m_cold;
+    // per block, aligned with IrFlowBlock::m_succs
+    std::vector<std::vector<double>> m_probability;
+    // per block and successor, the share of one entry into the successor's
+    // loop that comes back along the edge
+    std::vector<std::vector<double>> m_backEdgeProbability;
+    std::vector<double> m_frequency;
+};
+
+} // namespace Decaf
@@ -0,0 +1,283 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrBlockFrequency.h"
+#include "IrFlowGraph.h"
+#include "IrIdentifier.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+const size_t NO_BLOCK = (size_t)-1;
+
+struct Edge
+{
+    size_t m_from;
+    size_t m_to;
+    double m_weight;
+};
+
+bool isConditional(const IrTacStmt& stmt)
+{
+    return (stmt.m_opcode == IrOpcode::IFZ) || (stmt.m_opcode == IrOpcode::IFNZ);
+}
+
+// Blocks can move when every branch in the function has its target inside it,
+// the last block does not fall off the end and no call is split from its
+// parameters, which code generation collects in emission order.
+bool isMovable(const std::vector<IrTacStmt>& stmts, const IrFlowGraph& graph)
+{
+    std::set<std::string> labels;
+    for (size_t b = 0; b < graph.size(); b++)
+    {
+        const IrTacStmt& first = stmts[graph[b].m_first];
+        if (first.m_opcode == IrOpcode::LABEL) labels.insert(first.m_src0.m_asString);
+    }
+    for (size_t b = 0; b < graph.size(); b++)
+    {
+        const IrFlowBlock& block = graph[b];
+        const IrTacArg* target = getBranchTarget(stmts[block.m_last - 1]);
+        if (target != nullptr && labels.count(target->m_asString) == 0) return false;
+
+        bool pending = false;
+        for (size_t k = block.m_first; k < block.m_last; k++)
+        {
+            if (stmts[k].m_opcode == IrOpcode::PARAM) pending = true;
+            else if (stmts[k].m_opcode == IrOpcode::CALL) pending = false;
+        }
+        if (pending) return false;
+    }
+    const IrOpcode end = stmts[graph[graph.size() - 1].m_last - 1].m_opcode;
+    return (end == IrOpcode::JUMP) || (end == IrOpcode::RETURN);
+}
+
+// Bottom-up chaining (Pettis and Hansen): the heaviest edges join the chains
+// ending and starting at their blocks, so they become fall-throughs.  Chains
+// follow the entry's by the weight of the edges reaching them, and the cold
+// chains, which only run on errors or never ran, go last.
+std::vector<size_t> placeBlocks(const IrFlowGraph& graph, const IrBlockFrequency& frequency)
+{
+    const size_t N = graph.size();
+    std::vector<Edge> edges;
+    for (size_t b = 0; b < N; b++)
+    {
+        for (auto s : graph[b].m_succs)
+        {
+            edges.push_back(Edge{b, s, frequency.getFrequency(b) * frequency.getEdgeProbability(b, s)});
+        }
+    }
+    std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.m_weight > b.m_weight; });
+
+    std::vector<std::vector<size_t>> chains(N);
+    std::vector<size_t> chainOf(N);
+    for (size_t b = 0; b < N; b++)
+    {
+        chains[b].push_back(b);
+        chainOf[b] = b;
+    }
+    for (auto it : edges)
+    {
+        const size_t from = chainOf[it.m_from];
+        const size_t to = chainOf[it.m_to];
+        if (it.m_to == 0 || from == to || chains[from].back() != it.m_from || chains[to].front() != it.m_to) continue;
+
+        for (auto b : chains[to])
+        {
+            chains[from].push_back(b);
+            chainOf[b] = from;
+        }
+        chains[to].clear();
+    }
+
+    auto isCold = [&](size_t chain)
+    {
+        return std::all_of(chains[chain].begin(), chains[chain].end(),
+                           [&](size_t b) { return frequency.isCold(b) || frequency.getFrequency(b) == 0.0; });
+    };
+
+    std::vector<size_t> order;
+    std::vector<bool> placed(N, false);
+    size_t next = chainOf[0];
+    while (next != NO_BLOCK)
+    {
+        for (auto b : chains[next])
+        {
+            order.push_back(b);
+        }
+        placed[next] = true;
+
+        // the warm chain most strongly connected to the code placed so far,
+        // in source order when nothing connects
+        std::vector<double> weight(N, 0.0);
+        for (auto it : edges)
+        {
+            if (placed[chainOf[it.m_from]]) weight[chainOf[it.m_to]] += it.m_weight;
+        }
+        next = NO_BLOCK;
+        for (size_t c = 0; c < N; c++)
+        {
+            if (chains[c].empty() || placed[c] || isCold(c)) continue;
+            if (next == NO_BLOCK || weight[c] > weight[next]) next = c;
+        }
+    }
+    for (size_t c = 0; c < N; c++)
+    {
+        if (!chains[c].empty() && !placed[c])
+            order.insert(order.end(), chains[c].begin(), chains[c].end());
+    }
+    return order;
+}
+
+class LayoutEmitter
+{
+public:
+    LayoutEmitter(const std::vector<IrTacStmt>& stmts, const IrFlowGraph& graph) :
+        m_stmts(stmts),
+        m_graph(graph),
+        m_labels(graph.size())
+    {
+        for (size_t b = 0; b < graph.size(); b++)
+        {
+            const IrTacStmt& first = stmts[graph[b].m_first];
+            if (first.m_opcode == IrOpcode::LABEL) m_labels[b] = first.m_src0;
+        }
+    }
+
+    void emit(const std::vector<size_t>& order, const IrBlockFrequency& frequency, std::vector<IrTacStmt>& code);
+
+private:
+    const IrTacArg& getLabel(size_t block);
+
+    const std::vector<IrTacStmt>& m_stmts;
+    const IrFlowGraph& m_graph;
+    std::vector<IrTacArg> m_labels;
+};
+
+// Label of a block, made up for blocks that were only reached by falling
+// through to them.
+const IrTacArg& LayoutEmitter::getLabel(size_t block)
+{
+    if (m_labels[block].m_usage == IrUsage::Unused)
+        m_labels[block].buildLabel(IrIdentifier::CreateLabel()->getIdentifier());
+    return m_labels[block];
+}
+
+// Writes the blocks in their new order.  A branch whose target now follows it
+// is inverted, a jump to the next block goes away and a lost fall-through
+// becomes a jump.
+void LayoutEmitter::emit(const std::vector<size_t>& order, const IrBlockFrequency& frequency, std::vector<IrTacStmt>& code)
+{
+    std::vector<std::vector<IrTacStmt>> blocks(m_graph.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const size_t b = order[i];
+        const size_t next = (i + 1 < order.size()) ? order[i + 1] : NO_BLOCK;
+        const IrFlowBlock& block = m_graph[b];
+        std::vector<IrTacStmt>& stmts = blocks[b];
+        stmts.assign(m_stmts.begin() + block.m_first, m_stmts.begin() + block.m_last);
+
+        IrTacStmt& last = stmts.back();
+        const int lineNo = last.m_lineNo;
+        size_t fallThrough = NO_BLOCK;
+        if (last.m_opcode == IrOpcode::JUMP)
+        {
+            if (block.m_succs.front() == next) stmts.pop_back();
+        }
+        else if (isConditional(last) && block.m_succs.size() == 2 && block.m_succs[1] == next)
+        {
+            last.m_opcode = (last.m_opcode == IrOpcode::IFZ) ? IrOpcode::IFNZ : IrOpcode::IFZ;
+            last.m_src1 = getLabel(block.m_succs[0]);
+            if (last.m_taken >= 0) last.m_taken = last.m_count - last.m_taken;
+        }
+        else if (last.m_opcode != IrOpcode::RETURN && !block.m_succs.empty())
+        {
+            fallThrough = block.m_succs.front();
+        }
+
+        if (fallThrough != NO_BLOCK && fallThrough != next)
+        {
+            IrTacStmt jump(IrOpcode::JUMP, lineNo);
+            jump.m_src0 = getLabel(fallThrough);
+            stmts.push_back(jump);
+        }
+    }
+
+    for (auto b : order)
+    {
+        std::vector<IrTacStmt>& stmts = blocks[b];
+        if (m_labels[b].m_usage != IrUsage::Unused && m_stmts[m_graph[b].m_first].m_opcode != IrOpcode::LABEL)
+        {
+            IrTacStmt label(IrOpcode::LABEL, m_stmts[m_graph[b].m_first].m_lineNo);
+            label.m_src0 = m_labels[b];
+            stmts.insert(stmts.begin(), label);
+        }
+
+        // loop headers start on a fresh fetch block
+        if (frequency.isLoopHeader(b) && !stmts.empty() && stmts.front().m_opcode == IrOpcode::LABEL)
+            stmts.front().m_info = 1;
+
+        code.insert(code.end(), stmts.begin(), stmts.end());
+    }
+}
+
+} // namespace
+
+bool IrOptimizer::blockLayout()
+{
+    generateStatements();
+
+    const auto functions = getFunctions(m_statements);
+    if (functions.empty()) return false;
+
+    bool changed = false;
+    std::vector<IrTacStmt> result;
+    result.reserve(m_statements.size());
+    result.insert(result.end(), m_statements.begin(), m_statements.begin() + functions.front().first);
+    for (auto it : functions)
+    {
+        const IrFlowGraph graph(m_statements, it.first, it.second);
+        if (graph.size() < 2 || !isMovable(m_statements, graph))
+        {
+            result.insert(result.end(), m_statements.begin() + it.first, m_statements.begin() + it.second);
+            continue;
+        }
+
+        const IrBlockFrequency frequency(m_statements, graph);
+        LayoutEmitter emitter(m_statements, graph);
+        emitter.emit(placeBlocks(graph, frequency), frequency, result);
+        changed = true;
+    }
+
+    m_statements.swap(result);
+    generateBasicBlocks(m_statements);
+    return changed;
+}
+
+} // namespace Decaf
@@ -26,6 +26,7 @@
 #include "IrBreakStmt.h"
 #include "IrTravCtx.h"
 #include "IrForStmt.h"
+#include "IrParallelForStmt.h"
 #include "IrWhileStmt.h"
 #include "IrDoWhileStmt.h"
 #include "IrIdentifier.h"
@@ -66,6 +67,11 @@ bool IrBreakStatement::analyze(IrTraversalContext* ctx)
     {
         ctx->error(this, "break statement not found in a loop.");
     }
+    else if (dynamic_cast<const IrParallelForStatement*>(m_parentLoop) != nullptr)
+    {
+        ctx->error(this, "break statement not allowed in a parallel for loop.");
+        valid = false;
+    }
     return valid;
 }
 
@@ -0,0 +1,225 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include "IrCallSummary.h"
+#include "IrFlowGraph.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+bool isLiteralInRange(const IrTacArg& index, int limit)
+{
+    return index.isLiteral() && (index.m_value.m_int >= 0) && (index.m_value.m_int < limit);
+}
+
+// Failed bounds checks and integer division by zero end the program.
+bool mayFail(const IrTacStmt& stmt)
+{
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::LOAD:
+            return !isLiteralInRange(stmt.m_src1, stmt.m_info);
+        case IrOpcode::STORE:
+            return !isLiteralInRange(stmt.m_dst, stmt.m_info);
+        case IrOpcode::DIV:
+        case IrOpcode::MOD:
+            return !stmt.m_dst.isDouble() && !(isIntLiteral(stmt.m_src1) && stmt.m_src1.m_value.m_int != 0);
+        default:
+            break;
+    }
+    return false;
+}
+
+} // namespace
+
+IrCallSummary::IrCallSummary(const std::vector<IrTacStmt>& stmts) :
+    m_effects()
+{
+    // what each method does itself
+    const auto functions = getFunctions(stmts);
+    for (auto it : functions)
+    {
+        m_effects[stmts[it.first].m_src0.m_asString];
+    }
+    std::vector<const IrTacArg*> used;
+    for (auto it : functions)
+    {
+        Effects& effects = m_effects[stmts[it.first].m_src0.m_asString];
+        std::set<std::string> labels;
+        for (size_t n = it.first; n < it.second; n++)
+        {
+            const IrTacStmt& stmt = stmts[n];
+            getUsedVariables(stmt, used);
+            for (auto arg : used)
+            {
+                if (arg->m_usage == IrUsage::Global) effects.m_reads.insert(arg->m_asString);
+            }
+            const IrTacArg* def = getDefinedVariable(stmt);
+            if (def != nullptr && def->m_usage == IrUsage::Global) effects.m_writes.insert(def->m_asString);
+            
+            if (stmt.m_opcode == IrOpcode::LOAD) effects.m_reads.insert(stmt.m_src0.m_asString);
+            else if (stmt.m_opcode == IrOpcode::STORE) effects.m_writes.insert(stmt.m_src1.m_asString);
+            else if (stmt.m_opcode == IrOpcode::PARFOR) effects.m_unknown = true;
+            else if (stmt.m_opcode == IrOpcode::LABEL) labels.insert(stmt.m_src0.m_asString);
+            else if (stmt.m_opcode == IrOpcode::CALL)
+            {
+                if (m_effects.count(stmt.m_src0.m_asString) != 0)
+                    effects.m_callees.insert(stmt.m_src0.m_asString);
+                else
+                    effects.m_unknown = true;
+            }
+            
+            const IrTacArg* target = getBranchTarget(stmt);
+            if (target != nullptr && labels.count(target->m_asString) != 0) effects.m_mayLoop = true;
+            effects.m_mayFail |= mayFail(stmt);
+        }
+    }
+    
+    // callees first
+    std::map<std::string, int> index;
+    std::map<std::string, int> low;
+    std::vector<std::string> stack;
+    std::set<std::string> onStack;
+    int counter = 0;
+    for (auto it : functions)
+    {
+        const std::string& method = stmts[it.first].m_src0.m_asString;
+        if (index.count(method) == 0) summarize(method, index, stack, low, onStack, counter);
+    }
+}
+
+// Tarjan's strongly connected components; a component is complete, and its
+// callees summarized, when its root is left.
+void IrCallSummary::summarize(const std::string& method, std::map<std::string, int>& index, std::vector<std::string>& stack, 
+                              std::map<std::string, int>& low, std::set<std::string>& onStack, int& counter)
+{
+    index[method] = low[method] = counter++;
+    stack.push_back(method);
+    onStack.insert(method);
+    
+    for (const auto& callee : m_effects[method].m_callees)
+    {
+        if (index.count(callee) == 0)
+        {
+            summarize(callee, index, stack, low, onStack, counter);
+            low[method] = std::min(low[method], low[callee]);
+        }
+        else if (onStack.count(callee) != 0)
+        {
+            low[method] = std::min(low[method], index[callee]);
+        }
+    }
+    if (low[method] != index[method]) return;
+    
+    std::vector<std::string> component;
+    do
+    {
+        component.push_back(stack.back());
+        onStack.erase(stack.back());
+        stack.pop_back();
+    } while (component.back() != method);
+    
+    Effects merged;
+    for (const auto& member : component)
+    {
+        const Effects& effects = m_effects[member];
+        merged.m_unknown |= effects.m_unknown;
+        merged.m_mayFail |= effects.m_mayFail;
+        merged.m_mayLoop |= effects.m_mayLoop;
+        merged.m_reads.insert(effects.m_reads.begin(), effects.m_reads.end());
+        merged.m_writes.insert(effects.m_writes.begin(), effects.m_writes.end());
+        for (const auto& callee : effects.m_callees)
+        {
+            // a call back into the component is recursion
+            if (std::find(component.begin(), component.end(), callee) != component.end())
+            {
+                merged.m_mayLoop = true;
+                continue;
+            }
+            const Effects& called = m_effects[callee];
+            merged.m_unknown |= called.m_unknown;
+            merged.m_mayFail |= called.m_mayFail;
+            merged.m_mayLoop |= called.m_mayLoop;
+            merged.m_reads.insert(called.m_reads.begin(), called.m_reads.end());
+            merged.m_writes.insert(called.m_writes.begin(), called.m_writes.end());
+        }
+    }
+    for (const auto& member : component)
+    {
+        Effects& effects = m_effects[member];
+        merged.m_callees.swap(effects.m_callees);
+        effects = merged;
+        merged.m_callees.swap(effects.m_callees);
+    }
+}
+
+const IrCallSummary::Effects* IrCallSummary::getEffects(const IrTacStmt& call) const
+{
+    if (call.m_opcode != IrOpcode::CALL) return nullptr;
+    auto it = m_effects.find(call.m_src0.m_asString);
+    if (it == m_effects.end() || it->second.m_unknown) return nullptr;
+    return &it->second;
+}
+
+bool IrCallSummary::mayRead(const IrTacStmt& call, const std::string& name) const
+{
+    const Effects* effects = getEffects(call);
+    return (effects == nullptr) || (effects->m_reads.count(name) != 0);
+}
+
+bool IrCallSummary::mayWrite(const IrTacStmt& call, const std::string& name) const
+{
+    const Effects* effects = getEffects(call);
+    return (effects == nullptr) || (effects->m_writes.count(name) != 0);
+}
+
+bool IrCallSummary::mayChangeInputs(const IrTacStmt& call, const std::string& method) const
+{
+    auto it = m_effects.find(method);
+    if (it == m_effects.end() || it->second.m_unknown) return true;
+    
+    const Effects* effects = getEffects(call);
+    for (const auto& name : it->second.m_reads)
+    {
+        if (effects == nullptr || effects->m_writes.count(name) != 0) return true;
+    }
+    return false;
+}
+
+bool IrCallSummary::isPure(const std::string& method) const
+{
+    auto it = m_effects.find(method);
+    return (it != m_effects.end()) && !it->second.m_unknown && it->second.m_writes.empty();
+}
+
+bool IrCallSummary::isSpeculatable(const std::string& method) const
+{
+    auto it = m_effects.find(method);
+    return isPure(method) && !it->second.m_mayFail && !it->second.m_mayLoop;
+}
+
+} // namespace Decaf
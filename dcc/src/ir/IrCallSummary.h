@@ -0,0 +1,76 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "IrTAC.h"
+
+namespace Decaf
+{
+
+// Side effects of the methods of a module, including those of everything
+// they call: the globals and arrays read and written, and whether a callout
+// or the parallel runtime is reached.  Summaries are built bottom-up over the
+// call graph; the methods of a recursive cycle share theirs.  Callouts and
+// 'parallel for' loops may do anything.
+class IrCallSummary
+{
+public:
+    explicit IrCallSummary(const std::vector<IrTacStmt>& stmts);
+    
+    // True when a CALL or PARFOR may read, or write, the global variable or
+    // array 'name'.
+    bool mayRead(const IrTacStmt& call, const std::string& name) const;
+    bool mayWrite(const IrTacStmt& call, const std::string& name) const;
+    // True when a CALL or PARFOR may write a global that 'method' reads.
+    bool mayChangeInputs(const IrTacStmt& call, const std::string& method) const;
+    
+    // Methods of the module that write no global and reach no callout: equal
+    // arguments give equal results while the globals they read are unchanged.
+    bool isPure(const std::string& method) const;
+    // Pure methods that also always return, without loops, recursion or
+    // accesses that can fail, so calling them early is harmless.
+    bool isSpeculatable(const std::string& method) const;
+    
+private:
+    struct Effects
+    {
+        bool m_unknown = false;
+        bool m_mayFail = false;
+        bool m_mayLoop = false;
+        std::set<std::string> m_reads;
+        std::set<std::string> m_writes;
+        std::set<std::string> m_callees;
+    };
+    
+    const Effects* getEffects(const IrTacStmt& call) const;
+    void summarize(const std::string& method, std::map<std::string, int>& index, std::vector<std::string>& stack, 
+                   std::map<std::string, int>& low, std::set<std::string>& onStack, int& counter);
+    
+    std::map<std::string, Effects> m_effects;
+};
+
+} // namespace Decaf
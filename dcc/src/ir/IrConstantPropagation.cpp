@@ -0,0 +1,338 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Variables known to hold a constant on entry to/exit from a block;
+// variables not in the map are not constant.
+typedef std::map<std::string, long> ConstantMap;
+
+bool isTracked(const IrTacArg& arg)
+{
+    return (arg.m_usage == IrUsage::Identifier) && (arg.m_type == IrArgType::Integer || arg.m_type == IrArgType::Boolean);
+}
+
+bool getConstant(const IrTacArg& arg, const ConstantMap& values, long& value)
+{
+    if (isIntLiteral(arg) || isBoolLiteral(arg))
+    {
+        value = arg.m_value.m_int;
+        return true;
+    }
+    if (isTracked(arg))
+    {
+        auto it = values.find(getVariableKey(arg));
+        if (it != values.end())
+        {
+            value = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Value computed by a statement from constant operands.  Arithmetic wraps
+// like the generated code; division is only folded for operands where
+// the generated code is exact (its dividend is zero extended).
+bool evaluate(const IrTacStmt& stmt, const ConstantMap& values, long& result)
+{
+    long a = 0, b = 0;
+    if (stmt.m_opcode == IrOpcode::MOV)
+    {
+        return getConstant(stmt.m_src0, values, result);
+    }
+    else if (stmt.m_opcode == IrOpcode::NOT)
+    {
+        if (!getConstant(stmt.m_src1, values, b)) return false;
+        result = (b == 0) ? 1 : 0;
+        return true;
+    }
+    else if (stmt.m_opcode == IrOpcode::SUB && stmt.m_src0.m_usage == IrUsage::Unused)
+    {
+        if (!getConstant(stmt.m_src1, values, b)) return false;
+        result = (long)(0UL - (unsigned long)b);
+        return true;
+    }
+    
+    if (!isBinaryOp(stmt.m_opcode) && !isComparisonOp(stmt.m_opcode) && !isLogicOp(stmt.m_opcode)) return false;
+    if (!getConstant(stmt.m_src0, values, a) || !getConstant(stmt.m_src1, values, b)) return false;
+    
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::ADD: result = (long)((unsigned long)a + (unsigned long)b); break;
+        case IrOpcode::SUB: result = (long)((unsigned long)a - (unsigned long)b); break;
+        case IrOpcode::MUL: result = (long)((unsigned long)a * (unsigned long)b); break;
+        case IrOpcode::DIV: 
+            if (a < 0 || b <= 0) return false;
+            result = a / b; 
+            break;
+        case IrOpcode::MOD:
+            if (a < 0 || b <= 0) return false;
+            result = a % b; 
+            break;
+        case IrOpcode::EQUAL: result = (a == b); break;
+        case IrOpcode::NOTEQUAL: result = (a != b); break;
+        case IrOpcode::LESS: result = (a < b); break;
+        case IrOpcode::LESSEQUAL: result = (a <= b); break;
+        case IrOpcode::GREATER: result = (a > b); break;
+        case IrOpcode::GREATEREQUAL: result = (a >= b); break;
+        case IrOpcode::AND: result = (a && b); break;
+        case IrOpcode::OR: result = (a || b); break;
+        default: return false;
+    }
+    return true;
+}
+
+void transfer(const IrTacStmt& stmt, ConstantMap& values)
+{
+    const IrTacArg* def = getDefinedVariable(stmt);
+    if (def == nullptr) return;
+    
+    long value = 0;
+    if (isTracked(*def) && evaluate(stmt, values, value))
+        values[getVariableKey(*def)] = value;
+    else
+        values.erase(getVariableKey(*def));
+}
+
+void buildConstant(IrTacArg& arg, long value, IrArgType type)
+{
+    arg = IrTacArg();
+    arg.buildInteger(value);
+    arg.m_type = type;
+}
+
+// Successors of a block that can be taken given the values leaving it.
+std::vector<size_t> feasibleSuccessors(const std::vector<IrTacStmt>& stmts, const IrFlowGraph& graph, size_t b, 
+                                       const ConstantMap& values)
+{
+    const IrFlowBlock& block = graph[b];
+    const IrTacStmt& last = stmts[block.m_last - 1];
+    long cond = 0;
+    if (block.m_succs.empty()) return block.m_succs;
+    if ((last.m_opcode != IrOpcode::IFZ && last.m_opcode != IrOpcode::IFNZ) || !getConstant(last.m_src0, values, cond))
+        return block.m_succs;
+    
+    const bool taken = (last.m_opcode == IrOpcode::IFZ) ? (cond == 0) : (cond != 0);
+    
+    // the branch target follows the fall through successor (if any)
+    std::vector<size_t> succs;
+    if (taken)
+        succs.push_back(block.m_succs.back());
+    else if (b + 1 < graph.size())
+        succs.push_back(b + 1);
+    return succs;
+}
+
+class ConstantPropagation
+{
+public:
+    ConstantPropagation(const std::vector<IrTacStmt>& stmts, size_t first, size_t last) :
+        m_stmts(stmts),
+        m_graph(stmts, first, last),
+        m_executable(m_graph.size(), false),
+        m_out(m_graph.size())
+    {}
+    
+    void solve();
+    bool rewrite(std::vector<IrTacStmt>& result) const;
+    
+private:
+    ConstantMap getIn(size_t b) const;
+
+    const std::vector<IrTacStmt>& m_stmts;
+    IrFlowGraph m_graph;
+    std::vector<bool> m_executable;
+    std::set<std::pair<size_t, size_t>> m_executableEdges;
+    std::vector<ConstantMap> m_out;
+};
+
+// Meet of the values leaving the executable predecessors.
+ConstantMap ConstantPropagation::getIn(size_t b) const
+{
+    ConstantMap in;
+    if (b == 0) return in;
+    
+    bool first = true;
+    for (auto p : m_graph[b].m_preds)
+    {
+        if (m_executableEdges.count(std::make_pair(p, b)) == 0) continue;
+        if (first)
+        {
+            in = m_out[p];
+            first = false;
+            continue;
+        }
+        for (auto it = in.begin(); it != in.end();)
+        {
+            auto ip = m_out[p].find(it->first);
+            if (ip == m_out[p].end() || ip->second != it->second)
+                it = in.erase(it);
+            else
+                ++it;
+        }
+    }
+    return in;
+}
+
+void ConstantPropagation::solve()
+{
+    if (m_graph.size() == 0) return;
+    
+    std::vector<size_t> worklist;
+    worklist.push_back(0);
+    m_executable[0] = true;
+    while (!worklist.empty())
+    {
+        const size_t b = worklist.back();
+        worklist.pop_back();
+        
+        ConstantMap values = getIn(b);
+        for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+        {
+            transfer(m_stmts[n], values);
+        }
+        const bool changed = (values != m_out[b]);
+        m_out[b] = values;
+        
+        for (auto s : feasibleSuccessors(m_stmts, m_graph, b, values))
+        {
+            const bool newEdge = m_executableEdges.insert(std::make_pair(b, s)).second;
+            if (!newEdge && !changed) continue;
+            
+            m_executable[s] = true;
+            if (std::find(worklist.begin(), worklist.end(), s) == worklist.end())
+                worklist.push_back(s);
+        }
+    }
+}
+
+// Substitute constants for uses, fold constant computations and branches and 
+// drop unreachable blocks.
+bool ConstantPropagation::rewrite(std::vector<IrTacStmt>& result) const
+{
+    bool changed = false;
+    std::vector<const IrTacArg*> used;
+    for (size_t b = 0; b < m_graph.size(); b++)
+    {
+        if (!m_executable[b])
+        {
+            changed = true;
+            continue;
+        }
+        
+        ConstantMap values = getIn(b);
+        for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+        {
+            IrTacStmt stmt = m_stmts[n];
+            long value = 0;
+            
+            if (stmt.m_opcode == IrOpcode::IFZ || stmt.m_opcode == IrOpcode::IFNZ)
+            {
+                if (getConstant(stmt.m_src0, values, value))
+                {
+                    const bool taken = (stmt.m_opcode == IrOpcode::IFZ) ? (value == 0) : (value != 0);
+                    if (taken)
+                    {
+                        IrTacStmt jump(IrOpcode::JUMP, stmt.m_lineNo);
+                        jump.m_src0 = stmt.m_src1;
+                        result.push_back(jump);
+                    }
+                    changed = true;
+                    continue;
+                }
+            }
+            
+            const IrTacArg* def = getDefinedVariable(stmt);
+            if (stmt.m_opcode != IrOpcode::MOV && def != nullptr && isTracked(*def) && evaluate(stmt, values, value))
+            {
+                IrTacStmt mov(IrOpcode::MOV, stmt.m_lineNo);
+                buildConstant(mov.m_src0, value, def->m_type);
+                mov.m_dst = stmt.m_dst;
+                stmt = mov;
+                changed = true;
+            }
+            else
+            {
+                getUsedVariables(stmt, used);
+                for (IrTacArg* arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+                {
+                    if (std::find(used.begin(), used.end(), arg) == used.end() || !isReplaceableUse(stmt, arg)) continue;
+                    if (isTracked(*arg) && getConstant(*arg, values, value))
+                    {
+                        // a divisor evaluate() does not fold stays a variable, so the
+                        // basic-block folder never sees a literal zero there
+                        if (arg == &stmt.m_src1 && (stmt.m_opcode == IrOpcode::DIV || stmt.m_opcode == IrOpcode::MOD) && value <= 0) continue;
+                        buildConstant(*arg, value, arg->m_type);
+                        changed = true;
+                    }
+                }
+            }
+            
+            transfer(stmt, values);
+            result.push_back(stmt);
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
+bool IrOptimizer::constantPropagation()
+{
+    generateStatements();
+    
+    const auto functions = getFunctions(m_statements);
+    if (functions.empty()) return false;
+    
+    bool changed = false;
+    std::vector<IrTacStmt> propagated;
+    propagated.reserve(m_statements.size());
+    propagated.insert(propagated.end(), m_statements.begin(), m_statements.begin() + functions.front().first);
+    for (auto it : functions)
+    {
+        ConstantPropagation function(m_statements, it.first, it.second);
+        function.solve();
+        if (function.rewrite(propagated)) changed = true;
+    }
+    
+    if (changed)
+    {
+        m_statements.swap(propagated);
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
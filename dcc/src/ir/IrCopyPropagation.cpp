@@ -0,0 +1,288 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+bool isBlockBoundary(const IrTacStmt& stmt)
+{
+    return (stmt.m_opcode == IrOpcode::LABEL || getBranchTarget(stmt) != nullptr || stmt.m_opcode == IrOpcode::RETURN);
+}
+
+bool isCopy(const IrTacStmt& stmt)
+{
+    return (stmt.m_opcode == IrOpcode::MOV) && (stmt.m_src0.m_usage == IrUsage::Identifier) &&
+           (stmt.m_dst.m_usage == IrUsage::Identifier) && (stmt.m_src0.m_type == stmt.m_dst.m_type);
+}
+
+bool touches(const IrTacStmt& stmt, const std::string& key)
+{
+    std::vector<const IrTacArg*> used;
+    getUsedVariables(stmt, used);
+    const IrTacArg* def = getDefinedVariable(stmt);
+    if (def != nullptr) used.push_back(def);
+    for (auto it : used)
+    {
+        if (getVariableKey(*it) == key) return true;
+    }
+    return false;
+}
+
+// A temporary that is computed and then only copied into a local shares the
+// local's slot, so the copy goes away:
+//   ADD a, b, .LC1; ...; MOV .LC1, x  =>  ADD a, b, x; ...
+// The local may not be read or written in between.
+bool coalesceCopies(std::vector<IrTacStmt>& stmts, size_t first, size_t last, std::vector<bool>& removed)
+{
+    std::unordered_map<std::string, int> uses;
+    std::unordered_map<std::string, int> defs;
+    std::unordered_map<std::string, size_t> defIndex;
+    std::vector<const IrTacArg*> used;
+    for (size_t n = first; n < last; n++)
+    {
+        getUsedVariables(stmts[n], used);
+        for (auto it : used)
+        {
+            if (isCompilerTemporary(*it)) uses[it->m_asString]++;
+        }
+        const IrTacArg* def = getDefinedVariable(stmts[n]);
+        if (def != nullptr && isCompilerTemporary(*def))
+        {
+            defs[def->m_asString]++;
+            defIndex[def->m_asString] = n;
+        }
+    }
+    
+    bool changed = false;
+    for (size_t k = first; k < last; k++)
+    {
+        const IrTacStmt& copy = stmts[k];
+        if (!isCopy(copy) || !isCompilerTemporary(copy.m_src0)) continue;
+        
+        const std::string& temp = copy.m_src0.m_asString;
+        if (defs[temp] != 1 || uses[temp] != 1 || defIndex[temp] > k) continue;
+        
+        const size_t d = defIndex[temp];
+        const std::string key = getVariableKey(copy.m_dst);
+        bool clear = !isBlockBoundary(stmts[d]);
+        for (size_t n = d + 1; n < k && clear; n++)
+        {
+            if (removed[n - first]) continue;
+            clear = !isBlockBoundary(stmts[n]) && !touches(stmts[n], key);
+        }
+        if (!clear) continue;
+        
+        *getOperand(stmts[d], getDefinedVariable(stmts[d])) = copy.m_dst;
+        removed[k - first] = true;
+        changed = true;
+        
+        // a temporary copied on again is now set where the first one was
+        if (isCompilerTemporary(copy.m_dst)) defIndex[copy.m_dst.m_asString] = d;
+    }
+    return changed;
+}
+
+// Copies x := y available on entry to/exit from a block, keyed by the
+// destination.
+typedef std::map<std::string, IrTacArg> CopyMap;
+
+void kill(CopyMap& copies, const std::string& key)
+{
+    copies.erase(key);
+    for (auto it = copies.begin(); it != copies.end();)
+    {
+        if (getVariableKey(it->second) == key)
+            it = copies.erase(it);
+        else
+            ++it;
+    }
+}
+
+void transfer(const IrTacStmt& stmt, CopyMap& copies)
+{
+    const IrTacArg* def = getDefinedVariable(stmt);
+    if (def == nullptr) return;
+    
+    const std::string key = getVariableKey(*def);
+    kill(copies, key);
+    if (isCopy(stmt) && getVariableKey(stmt.m_src0) != key) copies[key] = stmt.m_src0;
+}
+
+class CopyPropagation
+{
+public:
+    CopyPropagation(std::vector<IrTacStmt>& stmts, size_t first, size_t last, const std::vector<bool>& removed) :
+        m_stmts(stmts),
+        m_first(first),
+        m_removed(removed),
+        m_graph(stmts, first, last),
+        m_visited(m_graph.size(), false),
+        m_out(m_graph.size())
+    {}
+    
+    void solve();
+    bool rewrite();
+    
+private:
+    CopyMap getIn(size_t b) const;
+    
+    std::vector<IrTacStmt>& m_stmts;
+    const size_t m_first;
+    const std::vector<bool>& m_removed;
+    IrFlowGraph m_graph;
+    std::vector<bool> m_visited;
+    std::vector<CopyMap> m_out;
+};
+
+// Copies available on every visited path into the block.
+CopyMap CopyPropagation::getIn(size_t b) const
+{
+    CopyMap in;
+    if (b == 0) return in;
+    
+    bool first = true;
+    for (auto p : m_graph[b].m_preds)
+    {
+        if (!m_visited[p]) continue;
+        if (first)
+        {
+            in = m_out[p];
+            first = false;
+            continue;
+        }
+        for (auto it = in.begin(); it != in.end();)
+        {
+            auto ip = m_out[p].find(it->first);
+            if (ip == m_out[p].end() || getVariableKey(ip->second) != getVariableKey(it->second))
+                it = in.erase(it);
+            else
+                ++it;
+        }
+    }
+    return in;
+}
+
+void CopyPropagation::solve()
+{
+    const std::vector<size_t> order = m_graph.reversePostorder();
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto b : order)
+        {
+            CopyMap copies = getIn(b);
+            for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+            {
+                if (!m_removed[n - m_first]) transfer(m_stmts[n], copies);
+            }
+            if (!m_visited[b] || copies.size() != m_out[b].size() || 
+                !std::equal(copies.begin(), copies.end(), m_out[b].begin(), [](const CopyMap::value_type& a, const CopyMap::value_type& b) {
+                    return (a.first == b.first) && (getVariableKey(a.second) == getVariableKey(b.second));
+                }))
+            {
+                m_out[b].swap(copies);
+                m_visited[b] = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+// Reads of a copy's destination read its source instead.
+bool CopyPropagation::rewrite()
+{
+    bool changed = false;
+    std::vector<const IrTacArg*> used;
+    for (size_t b = 0; b < m_graph.size(); b++)
+    {
+        if (!m_visited[b]) continue;
+        
+        CopyMap copies = getIn(b);
+        for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+        {
+            if (m_removed[n - m_first]) continue;
+            
+            IrTacStmt& stmt = m_stmts[n];
+            getUsedVariables(stmt, used);
+            for (auto it : used)
+            {
+                if (!isReplaceableUse(stmt, it)) continue;
+                auto ic = copies.find(getVariableKey(*it));
+                if (ic == copies.end()) continue;
+                
+                *getOperand(stmt, it) = ic->second;
+                changed = true;
+            }
+            transfer(stmt, copies);
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
+bool IrOptimizer::copyPropagation()
+{
+    generateStatements();
+    
+    bool changed = false;
+    std::vector<bool> removed(m_statements.size(), false);
+    for (auto it : getFunctions(m_statements))
+    {
+        std::vector<bool> functionRemoved(it.second - it.first, false);
+        if (coalesceCopies(m_statements, it.first, it.second, functionRemoved)) changed = true;
+        
+        CopyPropagation function(m_statements, it.first, it.second, functionRemoved);
+        function.solve();
+        if (function.rewrite()) changed = true;
+        
+        std::copy(functionRemoved.begin(), functionRemoved.end(), removed.begin() + it.first);
+    }
+    
+    if (changed)
+    {
+        std::vector<IrTacStmt> propagated;
+        propagated.reserve(m_statements.size());
+        for (size_t n = 0; n < m_statements.size(); n++)
+        {
+            if (!removed[n]) propagated.push_back(m_statements[n]);
+        }
+        m_statements.swap(propagated);
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
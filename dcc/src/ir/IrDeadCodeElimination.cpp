@@ -0,0 +1,223 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Statement without side effects beyond writing its result.  Loads that
+// may fail their bounds check, calls and integer divisions that may trap
+// are kept.
+bool isRemovable(const IrTacStmt& stmt)
+{
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::MOV:
+        case IrOpcode::NOT:
+            return true;
+        case IrOpcode::DIV:
+        case IrOpcode::MOD:
+            return stmt.m_dst.isDouble() || (isIntLiteral(stmt.m_src1) && stmt.m_src1.m_value.m_int != 0);
+        case IrOpcode::LOAD:
+            return isIntLiteral(stmt.m_src1) && stmt.m_src1.m_value.m_int >= 0 && stmt.m_src1.m_value.m_int < stmt.m_info;
+        default:
+            return isBinaryOp(stmt.m_opcode) || isComparisonOp(stmt.m_opcode) || isLogicOp(stmt.m_opcode);
+    }
+}
+
+class DeadCode
+{
+public:
+    DeadCode(const std::vector<IrTacStmt>& stmts, size_t first, size_t last);
+    
+    void solve();
+    bool rewrite(std::vector<IrTacStmt>& result) const;
+    
+private:
+    // Backward scan of a block from the variables live on exit; statements
+    // whose result is dead do not make their operands live.
+    void scan(size_t b, std::vector<bool>& live, std::vector<bool>* dead) const;
+
+    const std::vector<IrTacStmt>& m_stmts;
+    const size_t m_first;
+    IrFlowGraph m_graph;
+    // local variable written and read by each statement (by index, -1 if none)
+    std::vector<int> m_defs;
+    std::vector<std::vector<int>> m_uses;
+    size_t m_numVariables;
+    std::vector<std::vector<bool>> m_liveIn;
+    std::vector<bool> m_reachable;
+};
+
+DeadCode::DeadCode(const std::vector<IrTacStmt>& stmts, size_t first, size_t last) :
+    m_stmts(stmts),
+    m_first(first),
+    m_graph(stmts, first, last),
+    m_defs(last - first, -1),
+    m_uses(last - first),
+    m_numVariables(0),
+    m_liveIn(),
+    m_reachable(m_graph.size(), false)
+{
+    std::unordered_map<std::string, int> variables;
+    auto index = [&variables](const IrTacArg& arg) {
+        auto it = variables.emplace(getVariableKey(arg), (int)variables.size());
+        return it.first->second;
+    };
+    
+    std::vector<const IrTacArg*> used;
+    for (size_t n = first; n < last; n++)
+    {
+        const IrTacArg* def = getDefinedVariable(stmts[n]);
+        if (def != nullptr && def->m_usage == IrUsage::Identifier) m_defs[n - first] = index(*def);
+        
+        getUsedVariables(stmts[n], used);
+        for (auto it : used)
+        {
+            if (it->m_usage == IrUsage::Identifier) m_uses[n - first].push_back(index(*it));
+        }
+    }
+    m_numVariables = variables.size();
+    m_liveIn.assign(m_graph.size(), std::vector<bool>(m_numVariables, false));
+}
+
+void DeadCode::scan(size_t b, std::vector<bool>& live, std::vector<bool>* dead) const
+{
+    for (size_t n = m_graph[b].m_last; n-- > m_graph[b].m_first;)
+    {
+        const int def = m_defs[n - m_first];
+        if (def >= 0)
+        {
+            if (!live[def] && isRemovable(m_stmts[n]))
+            {
+                if (dead) (*dead)[n - m_first] = true;
+                continue;
+            }
+            live[def] = false;
+        }
+        for (auto it : m_uses[n - m_first])
+        {
+            live[it] = true;
+        }
+    }
+}
+
+void DeadCode::solve()
+{
+    std::vector<size_t> order = m_graph.reversePostorder();
+    std::reverse(order.begin(), order.end());
+    for (auto b : order)
+    {
+        m_reachable[b] = true;
+    }
+    
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto b : order)
+        {
+            std::vector<bool> live(m_numVariables, false);
+            for (auto s : m_graph[b].m_succs)
+            {
+                for (size_t v = 0; v < m_numVariables; v++)
+                {
+                    if (m_liveIn[s][v]) live[v] = true;
+                }
+            }
+            scan(b, live, nullptr);
+            if (live != m_liveIn[b])
+            {
+                m_liveIn[b].swap(live);
+                changed = true;
+            }
+        }
+    }
+}
+
+bool DeadCode::rewrite(std::vector<IrTacStmt>& result) const
+{
+    std::vector<bool> dead(m_defs.size(), false);
+    for (size_t b = 0; b < m_graph.size(); b++)
+    {
+        if (!m_reachable[b]) continue;
+        
+        std::vector<bool> live(m_numVariables, false);
+        for (auto s : m_graph[b].m_succs)
+        {
+            for (size_t v = 0; v < m_numVariables; v++)
+            {
+                if (m_liveIn[s][v]) live[v] = true;
+            }
+        }
+        scan(b, live, &dead);
+    }
+    
+    bool changed = false;
+    for (size_t n = 0; n < dead.size(); n++)
+    {
+        if (dead[n])
+            changed = true;
+        else
+            result.push_back(m_stmts[m_first + n]);
+    }
+    return changed;
+}
+
+} // namespace
+
+bool IrOptimizer::deadCodeElimination()
+{
+    generateStatements();
+    
+    const auto functions = getFunctions(m_statements);
+    if (functions.empty()) return false;
+    
+    bool changed = false;
+    std::vector<IrTacStmt> live;
+    live.reserve(m_statements.size());
+    live.insert(live.end(), m_statements.begin(), m_statements.begin() + functions.front().first);
+    for (auto it : functions)
+    {
+        DeadCode function(m_statements, it.first, it.second);
+        function.solve();
+        if (function.rewrite(live)) changed = true;
+    }
+    
+    if (changed)
+    {
+        m_statements.swap(live);
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
@@ -0,0 +1,99 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <map>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+
+namespace Decaf
+{
+
+// Whole program dead declaration elimination: methods main cannot reach,
+// through calls or by passing their address (the bodies of parallel loops,
+// the profile writer), and globals no remaining method names are dropped.
+// Without a main every declaration stays.
+bool IrOptimizer::removeDeadDeclarations(std::vector<std::string>& deadMethods, std::vector<std::string>& deadGlobals)
+{
+    generateStatements();
+    
+    const auto functions = getFunctions(m_statements);
+    std::map<std::string, std::pair<size_t, size_t>> methods;
+    for (auto it : functions)
+    {
+        methods[m_statements[it.first].m_src0.m_asString] = it;
+    }
+    if (methods.count("main") == 0) return false;
+    
+    std::set<std::string> reached = { "main" };
+    std::set<std::string> names;
+    std::vector<std::string> work = { "main" };
+    while (!work.empty())
+    {
+        const auto range = methods[work.back()];
+        work.pop_back();
+        for (size_t n = range.first + 1; n < range.second; n++)
+        {
+            const IrTacStmt& stmt = m_statements[n];
+            for (auto arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+            {
+                if (arg->m_usage == IrUsage::Unused || arg->isLiteral()) continue;
+                names.insert(arg->m_asString);
+                if (methods.count(arg->m_asString) != 0 && reached.insert(arg->m_asString).second)
+                    work.push_back(arg->m_asString);
+            }
+        }
+    }
+    
+    std::vector<bool> removed(m_statements.size(), false);
+    for (size_t n = 0; n < m_statements.size(); n++)
+    {
+        const IrTacStmt& stmt = m_statements[n];
+        if (stmt.m_opcode == IrOpcode::GLOBAL && names.count(stmt.m_src0.m_asString) == 0)
+        {
+            removed[n] = true;
+            deadGlobals.push_back(stmt.m_src0.m_asString);
+        }
+    }
+    for (auto it : functions)
+    {
+        const std::string& name = m_statements[it.first].m_src0.m_asString;
+        if (reached.count(name) != 0) continue;
+        std::fill(removed.begin() + it.first, removed.begin() + it.second, true);
+        deadMethods.push_back(name);
+    }
+    if (deadMethods.empty() && deadGlobals.empty()) return false;
+    
+    std::vector<IrTacStmt> remaining;
+    remaining.reserve(m_statements.size());
+    for (size_t n = 0; n < m_statements.size(); n++)
+    {
+        if (!removed[n]) remaining.push_back(m_statements[n]);
+    }
+    m_statements.swap(remaining);
+    generateBasicBlocks(m_statements);
+    return true;
+}
+
+} // namespace Decaf
@@ -0,0 +1,135 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include "IrFlowGraph.h"
+
+namespace Decaf
+{
+
+IrFlowGraph::IrFlowGraph(const std::vector<IrTacStmt>& stmts, size_t first, size_t last)
+{
+    std::map<std::string, size_t> labels;
+    for (size_t n = first; n < last; n++)
+    {
+        const IrOpcode opcode = stmts[n].m_opcode;
+        if (m_blocks.empty() || opcode == IrOpcode::LABEL)
+        {
+            if (m_blocks.empty() || m_blocks.back().m_last > m_blocks.back().m_first)
+                m_blocks.push_back(IrFlowBlock{n, n, {}, {}});
+            if (opcode == IrOpcode::LABEL)
+                labels[stmts[n].m_src0.m_asString] = m_blocks.size() - 1;
+        }
+        m_blocks.back().m_last = n + 1;
+        
+        if ((opcode == IrOpcode::JUMP || opcode == IrOpcode::IFZ || opcode == IrOpcode::IFNZ || opcode == IrOpcode::RETURN) && n + 1 < last)
+        {
+            m_blocks.push_back(IrFlowBlock{n + 1, n + 1, {}, {}});
+        }
+    }
+    if (!m_blocks.empty() && m_blocks.back().m_last == m_blocks.back().m_first) m_blocks.pop_back();
+    
+    for (size_t b = 0; b < m_blocks.size(); b++)
+    {
+        IrFlowBlock& block = m_blocks[b];
+        const IrTacStmt& stmt = stmts[block.m_last - 1];
+        
+        if (stmt.m_opcode != IrOpcode::JUMP && stmt.m_opcode != IrOpcode::RETURN && b + 1 < m_blocks.size())
+            block.m_succs.push_back(b + 1);
+        
+        const IrTacArg* target = getBranchTarget(stmt);
+        if (target)
+        {
+            auto it = labels.find(target->m_asString);
+            if (it != labels.end() && std::find(block.m_succs.begin(), block.m_succs.end(), it->second) == block.m_succs.end())
+                block.m_succs.push_back(it->second);
+        }
+        for (auto it : block.m_succs)
+        {
+            m_blocks[it].m_preds.push_back(b);
+        }
+    }
+}
+
+std::vector<size_t> IrFlowGraph::reversePostorder() const
+{
+    std::vector<size_t> order;
+    if (m_blocks.empty()) return order;
+    
+    std::vector<bool> visited(m_blocks.size(), false);
+    std::vector<std::pair<size_t, size_t>> stack;
+    stack.push_back(std::make_pair(0, 0));
+    visited[0] = true;
+    while (!stack.empty())
+    {
+        const size_t b = stack.back().first;
+        const size_t next = stack.back().second;
+        if (next < m_blocks[b].m_succs.size())
+        {
+            stack.back().second++;
+            const size_t s = m_blocks[b].m_succs[next];
+            if (!visited[s])
+            {
+                visited[s] = true;
+                stack.push_back(std::make_pair(s, 0));
+            }
+        }
+        else
+        {
+            order.push_back(b);
+            stack.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+std::vector<std::pair<size_t, size_t>> getFunctions(const std::vector<IrTacStmt>& stmts)
+{
+    std::vector<std::pair<size_t, size_t>> functions;
+    for (size_t n = 0; n < stmts.size(); n++)
+    {
+        if (stmts[n].m_opcode != IrOpcode::FBEGIN) continue;
+        
+        if (!functions.empty()) functions.back().second = n;
+        functions.push_back(std::make_pair(n, stmts.size()));
+    }
+    return functions;
+}
+
+std::ptrdiff_t getFrameEnd(const std::vector<IrTacStmt>& stmts, size_t first, size_t last)
+{
+    std::ptrdiff_t end = stmts[first].m_info;
+    for (size_t k = first; k < last; k++)
+    {
+        for (auto arg : { &stmts[k].m_src0, &stmts[k].m_src1, &stmts[k].m_dst })
+        {
+            if (arg->m_usage == IrUsage::Identifier)
+                end = std::max(end, arg->m_value.m_address + 8);
+        }
+    }
+    return end;
+}
+
+} // namespace Decaf
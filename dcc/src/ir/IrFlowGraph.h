@@ -0,0 +1,66 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+#include "IrTAC.h"
+
+namespace Decaf
+{
+
+// Basic block of an IrFlowGraph: statements [m_first, m_last).
+struct IrFlowBlock
+{
+    size_t m_first;
+    size_t m_last;
+    std::vector<size_t> m_succs;
+    std::vector<size_t> m_preds;
+};
+
+// Control flow graph over the statements of one function, built on demand by
+// the global passes.  Blocks start at labels and end after branches and
+// returns; block 0 is the function entry.
+class IrFlowGraph
+{
+public:
+    IrFlowGraph(const std::vector<IrTacStmt>& stmts, size_t first, size_t last);
+    
+    size_t size() const { return m_blocks.size(); }
+    const IrFlowBlock& operator[](size_t n) const { return m_blocks[n]; }
+    
+    // Blocks reachable from the entry, in reverse postorder.
+    std::vector<size_t> reversePostorder() const;
+    
+private:
+    std::vector<IrFlowBlock> m_blocks;
+};
+
+// Statement ranges [first, last) of the functions in a statement list.
+std::vector<std::pair<size_t, size_t>> getFunctions(const std::vector<IrTacStmt>& stmts);
+
+// First free frame address of the function in [first, last).
+std::ptrdiff_t getFrameEnd(const std::vector<IrTacStmt>& stmts, size_t first, size_t last);
+
+} // namespace Decaf
@@ -0,0 +1,439 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+#include "IrIdentifier.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Longest arm, in statements, that is executed unconditionally.
+const size_t MAX_CONVERTED_ARM = 4;
+// Profiled branches that go the same way at least this often are predicted
+// well and cost less than the conditional moves.
+const double PREDICTABLE_BRANCH = 0.98;
+
+bool isPredictable(const IrTacStmt& branch)
+{
+    if (branch.m_count <= 0 || branch.m_taken < 0) return false;
+    const double taken = (double)branch.m_taken / (double)branch.m_count;
+    return std::max(taken, 1.0 - taken) >= PREDICTABLE_BRANCH;
+}
+
+// Statements that can run whether or not their arm was taken: no memory
+// access, no call and nothing that can trap.
+bool isSpeculatable(const IrTacStmt& stmt)
+{
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::MOV:
+        case IrOpcode::ADD:
+        case IrOpcode::SUB:
+        case IrOpcode::MUL:
+        case IrOpcode::AND:
+        case IrOpcode::OR:
+        case IrOpcode::NOT:
+            break;
+        default:
+            if (!isComparisonOp(stmt.m_opcode)) return false;
+            break;
+    }
+    const IrTacArg* def = getDefinedVariable(stmt);
+    return (def != nullptr) && !def->isDouble();
+}
+
+bool isSameOperand(const IrTacArg& a, const IrTacArg& b)
+{
+    if (a.isLiteral() && b.isLiteral())
+        return (a.m_type == b.m_type) && (a.m_value.m_int == b.m_value.m_int);
+    return a.isMemory() && b.isMemory() && (getOperandKey(a) == getOperandKey(b));
+}
+
+bool writesVariable(const std::vector<IrTacStmt>& code, size_t first, size_t last, const IrTacArg& arg)
+{
+    for (size_t k = first; k < last; k++)
+    {
+        if (isSameOperand(code[k].m_dst, arg)) return true;
+    }
+    return false;
+}
+
+IrOpcode negateComparison(IrOpcode opcode)
+{
+    switch (opcode)
+    {
+        case IrOpcode::LESS: return IrOpcode::GREATEREQUAL;
+        case IrOpcode::LESSEQUAL: return IrOpcode::GREATER;
+        case IrOpcode::GREATER: return IrOpcode::LESSEQUAL;
+        case IrOpcode::GREATEREQUAL: return IrOpcode::LESS;
+        default: break;
+    }
+    return IrOpcode::NOOP;
+}
+
+// MIN or MAX of the compared operands for 'test ? a : b' where (a test b)
+// is an ordering comparison, NOOP otherwise.
+IrOpcode selectMinMax(IrOpcode test)
+{
+    switch (test)
+    {
+        case IrOpcode::LESS:
+        case IrOpcode::LESSEQUAL:
+            return IrOpcode::MIN;
+        case IrOpcode::GREATER:
+        case IrOpcode::GREATEREQUAL:
+            return IrOpcode::MAX;
+        default: break;
+    }
+    return IrOpcode::NOOP;
+}
+
+IrOpcode otherMinMax(IrOpcode opcode)
+{
+    if (opcode == IrOpcode::MIN) return IrOpcode::MAX;
+    if (opcode == IrOpcode::MAX) return IrOpcode::MIN;
+    return IrOpcode::NOOP;
+}
+
+// Counts every mention of a label, not just branches.
+void countLabelRefs(const std::vector<IrTacStmt>& code, std::map<std::string, int>& refs)
+{
+    refs.clear();
+    for (const auto& stmt : code)
+    {
+        if (stmt.m_opcode == IrOpcode::LABEL) continue;
+        for (auto arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+        {
+            if (arg->m_usage == IrUsage::Label) refs[arg->m_asString]++;
+        }
+    }
+}
+
+// Without CFG simplification the arms still carry the labels and jumps the
+// statement codegen leaves behind; drop the ones that go nowhere.
+bool removeTrivialFlow(std::vector<IrTacStmt>& code)
+{
+    std::map<std::string, int> refs;
+    bool changed = false, removed = true;
+    while (removed)
+    {
+        countLabelRefs(code, refs);
+        const size_t N = code.size();
+        auto isTrivial = [&](size_t k)
+        {
+            const IrTacStmt& stmt = code[k];
+            if (stmt.m_opcode == IrOpcode::LABEL) return (refs[stmt.m_src0.m_asString] == 0);
+            return (stmt.m_opcode == IrOpcode::JUMP) && (k + 1 < N) && (code[k+1].m_opcode == IrOpcode::LABEL) &&
+                   (code[k+1].m_src0.m_asString == stmt.m_src0.m_asString);
+        };
+        std::vector<IrTacStmt> kept;
+        kept.reserve(N);
+        for (size_t k = 0; k < N; k++)
+        {
+            if (!isTrivial(k)) kept.push_back(code[k]);
+        }
+        removed = (kept.size() != N);
+        changed |= removed;
+        code.swap(kept);
+    }
+    return changed;
+}
+
+class IfConverter
+{
+public:
+    IfConverter(std::vector<IrTacStmt>& code, std::ptrdiff_t& frameEnd);
+    
+    bool run();
+    
+private:
+    bool matchMinMax(const IrTacStmt& branch, size_t thenFirst, size_t thenLast, size_t elseFirst, size_t elseLast);
+    void speculate(size_t first, size_t last, IrOpcode move, const IrTacArg& cond, std::vector<IrTacStmt>& commits);
+    
+    std::vector<IrTacStmt>& m_code;
+    std::ptrdiff_t& m_frameEnd;
+    std::vector<IrTacStmt> m_result;
+    std::map<std::string, int> m_labelRefs;
+    std::map<std::string, int> m_tempRefs;
+};
+
+IfConverter::IfConverter(std::vector<IrTacStmt>& code, std::ptrdiff_t& frameEnd) :
+    m_code(code),
+    m_frameEnd(frameEnd),
+    m_result(),
+    m_labelRefs(),
+    m_tempRefs()
+{
+    countLabelRefs(code, m_labelRefs);
+    for (const auto& stmt : code)
+    {
+        for (auto arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+        {
+            if (isCompilerTemporary(*arg)) m_tempRefs[arg->m_asString]++;
+        }
+    }
+}
+
+// Rewrites one layer of triangles and diamonds; nested ones become
+// straight-line as their inner branches go away on the next run.
+bool IfConverter::run()
+{
+    const size_t N = m_code.size();
+    bool changed = false;
+    for (size_t n = 0; n < N; n++)
+    {
+        const IrTacStmt branch = m_code[n];
+        if ((branch.m_opcode != IrOpcode::IFZ && branch.m_opcode != IrOpcode::IFNZ) || branch.m_src0.isLiteral() || isPredictable(branch))
+        {
+            m_result.push_back(branch);
+            continue;
+        }
+        const std::string& target = branch.m_src1.m_asString;
+        
+        size_t thenLast = n + 1;
+        while (thenLast < N && isSpeculatable(m_code[thenLast])) thenLast++;
+        if (thenLast == n + 1 || thenLast == N || thenLast - n - 1 > MAX_CONVERTED_ARM)
+        {
+            m_result.push_back(branch);
+            continue;
+        }
+        
+        // triangle: IFZ c, L; <then>; L:
+        // diamond:  IFZ c, L; <then>; JUMP E; L: <else>; E:
+        size_t elseFirst = thenLast, elseLast = thenLast, last = thenLast;
+        const IrTacStmt& stop = m_code[thenLast];
+        if (stop.m_opcode == IrOpcode::JUMP && thenLast + 1 < N &&
+            m_code[thenLast+1].m_opcode == IrOpcode::LABEL && m_code[thenLast+1].m_src0.m_asString == target &&
+            m_labelRefs[target] == 1)
+        {
+            elseFirst = elseLast = thenLast + 2;
+            while (elseLast < N && isSpeculatable(m_code[elseLast])) elseLast++;
+            if (elseLast == N || elseLast - elseFirst > MAX_CONVERTED_ARM ||
+                m_code[elseLast].m_opcode != IrOpcode::LABEL || m_code[elseLast].m_src0.m_asString != stop.m_src0.m_asString)
+            {
+                m_result.push_back(branch);
+                continue;
+            }
+            last = elseLast;
+        }
+        else if (stop.m_opcode != IrOpcode::LABEL || stop.m_src0.m_asString != target)
+        {
+            m_result.push_back(branch);
+            continue;
+        }
+        
+        // the condition has to survive the moves that commit the arms
+        if (writesVariable(m_code, n + 1, last, branch.m_src0))
+        {
+            m_result.push_back(branch);
+            continue;
+        }
+        
+        if (!matchMinMax(branch, n + 1, thenLast, elseFirst, elseLast))
+        {
+            // fall-through runs the then arm, the branch target the else arm
+            const bool thenOnZero = (branch.m_opcode == IrOpcode::IFNZ);
+            std::vector<IrTacStmt> commits;
+            speculate(n + 1, thenLast, thenOnZero ? IrOpcode::MOVZ : IrOpcode::MOVNZ, branch.m_src0, commits);
+            speculate(elseFirst, elseLast, thenOnZero ? IrOpcode::MOVNZ : IrOpcode::MOVZ, branch.m_src0, commits);
+            m_result.insert(m_result.end(), commits.begin(), commits.end());
+        }
+        
+        // labels other branches still reach stay in place
+        if (m_labelRefs[m_code[last].m_src0.m_asString] > 1) m_result.push_back(m_code[last]);
+        n = last;
+        changed = true;
+    }
+    
+    if (changed) m_code.swap(m_result);
+    return changed;
+}
+
+// Clip and select idioms whose arms copy one of the compared operands:
+//   if (a < b) a = b;              -> MAX a, b -> a
+//   if (a > b) y = a; else y = b;  -> MAX a, b -> y
+bool IfConverter::matchMinMax(const IrTacStmt& branch, size_t thenFirst, size_t thenLast, size_t elseFirst, size_t elseLast)
+{
+    if (m_result.empty() || thenLast - thenFirst != 1 || elseLast - elseFirst > 1) return false;
+    
+    const IrTacStmt test = m_result.back();
+    if (negateComparison(test.m_opcode) == IrOpcode::NOOP || !isSameOperand(test.m_dst, branch.m_src0) ||
+        !isCompilerTemporary(test.m_dst) || m_tempRefs[test.m_dst.m_asString] != 2) return false;
+    if (test.m_src0.m_type != IrArgType::Integer || test.m_src1.m_type != IrArgType::Integer) return false;
+    
+    // comparison under which the then arm runs
+    const IrOpcode taken = (branch.m_opcode == IrOpcode::IFZ) ? test.m_opcode : negateComparison(test.m_opcode);
+    const IrTacArg& a = test.m_src0;
+    const IrTacArg& b = test.m_src1;
+    const IrTacStmt& copy = m_code[thenFirst];
+    if (copy.m_opcode != IrOpcode::MOV) return false;
+    
+    IrTacStmt select(IrOpcode::NOOP, branch.m_lineNo);
+    select.m_dst = copy.m_dst;
+    if (elseLast == elseFirst)
+    {
+        // x = (x test v) ? v : x
+        if (isSameOperand(copy.m_dst, a) && isSameOperand(copy.m_src0, b))
+            select.m_opcode = otherMinMax(selectMinMax(taken));
+        else if (isSameOperand(copy.m_dst, b) && isSameOperand(copy.m_src0, a))
+            select.m_opcode = selectMinMax(taken);
+        select.m_src0 = copy.m_dst;
+        select.m_src1 = copy.m_src0;
+    }
+    else
+    {
+        // y = (a test b) ? p : q
+        const IrTacStmt& other = m_code[elseFirst];
+        if (other.m_opcode != IrOpcode::MOV || !isSameOperand(other.m_dst, copy.m_dst)) return false;
+        if (isSameOperand(copy.m_src0, a) && isSameOperand(other.m_src0, b))
+            select.m_opcode = selectMinMax(taken);
+        else if (isSameOperand(copy.m_src0, b) && isSameOperand(other.m_src0, a))
+            select.m_opcode = otherMinMax(selectMinMax(taken));
+        select.m_src0 = a;
+        select.m_src1 = b;
+    }
+    if (select.m_opcode == IrOpcode::NOOP) return false;
+    
+    m_result.pop_back();
+    m_result.push_back(select);
+    return true;
+}
+
+// Appends the arm [first, last) with its assignments redirected to fresh
+// temporaries, and queues the conditional moves that commit them. Variables
+// read by the arm keep their old values until all the arms have run.
+void IfConverter::speculate(size_t first, size_t last, IrOpcode move, const IrTacArg& cond, std::vector<IrTacStmt>& commits)
+{
+    std::map<std::string, int> localRefs, localDefs;
+    for (size_t k = first; k < last; k++)
+    {
+        for (auto arg : { &m_code[k].m_src0, &m_code[k].m_src1, &m_code[k].m_dst })
+        {
+            if (isCompilerTemporary(*arg)) localRefs[arg->m_asString]++;
+        }
+        localDefs[getOperandKey(m_code[k].m_dst)]++;
+    }
+    auto isPrivate = [&](const IrTacArg& arg)
+    {
+        return isCompilerTemporary(arg) && (localRefs[arg.m_asString] == m_tempRefs[arg.m_asString]);
+    };
+    
+    std::map<std::string, IrTacArg> renamed;
+    std::set<std::string> fresh;
+    std::vector<const IrTacArg*> used;
+    for (size_t k = first; k < last; k++)
+    {
+        IrTacStmt stmt = m_code[k];
+        getUsedVariables(stmt, used);
+        for (auto arg : used)
+        {
+            auto it = renamed.find(getOperandKey(*arg));
+            if (it != renamed.end()) *getOperand(stmt, arg) = it->second;
+        }
+        
+        // temporaries private to the arm need no commit
+        const IrTacArg dst = stmt.m_dst;
+        if (isPrivate(dst))
+        {
+            m_result.push_back(stmt);
+            continue;
+        }
+        
+        IrTacStmt commit(move, stmt.m_lineNo);
+        commit.m_src0 = cond;
+        commit.m_dst = dst;
+        // a copy commits its source directly when no commit can change it
+        const IrTacArg& src = stmt.m_src0;
+        if (stmt.m_opcode == IrOpcode::MOV &&
+            (src.isLiteral() || fresh.count(src.m_asString) != 0 || (isPrivate(src) && localDefs[src.m_asString] == 1)))
+        {
+            commit.m_src1 = src;
+        }
+        else
+        {
+            commit.m_src1.buildTemporary(IrIdentifier::CreateTemporary()->getIdentifier(), m_frameEnd, dst.m_type);
+            m_frameEnd += 8;
+            stmt.m_dst = commit.m_src1;
+            fresh.insert(commit.m_src1.m_asString);
+            m_result.push_back(stmt);
+        }
+        renamed[getOperandKey(dst)] = commit.m_src1;
+        commits.push_back(commit);
+    }
+}
+
+} // namespace
+
+// Short conditional arms whose statements cannot fault or touch memory are
+// executed unconditionally and committed with conditional moves, so data
+// dependent branches (clipping a pixel, picking the larger value) no longer
+// mispredict. Selections of one of the compared operands become MIN/MAX.
+// Runs on the final control flow, after the other global passes.
+bool IrOptimizer::ifConversion()
+{
+    generateStatements();
+    
+    const auto functions = getFunctions(m_statements);
+    if (functions.empty()) return false;
+    
+    bool changed = false;
+    std::vector<IrTacStmt> result;
+    result.reserve(m_statements.size());
+    result.insert(result.end(), m_statements.begin(), m_statements.begin() + functions.front().first);
+    for (auto it : functions)
+    {
+        std::vector<IrTacStmt> code(m_statements.begin() + it.first, m_statements.begin() + it.second);
+        std::ptrdiff_t frameEnd = getFrameEnd(m_statements, it.first, it.second);
+        
+        bool converted = removeTrivialFlow(code);
+        while (IfConverter(code, frameEnd).run())
+        {
+            converted = true;
+        }
+        
+        if (converted)
+        {
+            code.front().m_info = std::max(code.front().m_info, alignFrameSize(frameEnd));
+            changed = true;
+        }
+        result.insert(result.end(), code.begin(), code.end());
+    }
+    
+    if (changed)
+    {
+        m_statements.swap(result);
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
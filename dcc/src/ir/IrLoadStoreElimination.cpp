@@ -0,0 +1,385 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "IrOptimizer.h"
+#include "IrCallSummary.h"
+#include "IrFlowGraph.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Array elements a[i] and a[j] are known to differ only for distinct literal indices.
+bool mayAlias(const IrTacArg& index0, const IrTacArg& index1)
+{
+    if (index0.isLiteral() && index1.isLiteral()) return (index0.m_value.m_int == index1.m_value.m_int);
+    return true;
+}
+
+// Calls may touch arrays and globals (see IrCallSummary); returns leave the function.
+bool isMemoryBarrier(const IrTacStmt& stmt)
+{
+    return (stmt.m_opcode == IrOpcode::CALL || stmt.m_opcode == IrOpcode::PARFOR || stmt.m_opcode == IrOpcode::RETURN);
+}
+
+bool isGlobalIn(const IrTacArg& arg, const std::function<bool(const std::string&)>& pred)
+{
+    return (arg.m_usage == IrUsage::Global) && pred(arg.m_asString);
+}
+
+// Value last loaded from or stored to an array element.
+struct ElementValue
+{
+    std::string m_array;
+    IrTacArg m_index;
+    IrTacArg m_value;
+};
+
+// Element values available on entry to/exit from a block, keyed by element.
+typedef std::map<std::string, ElementValue> ElementMap;
+
+void killVariable(ElementMap& elements, const std::string& key)
+{
+    for (auto it = elements.begin(); it != elements.end();)
+    {
+        const ElementValue& element = it->second;
+        if ((element.m_index.isMemory() && getVariableKey(element.m_index) == key) || 
+            (element.m_value.isMemory() && getVariableKey(element.m_value) == key))
+            it = elements.erase(it);
+        else
+            ++it;
+    }
+}
+
+void killElements(ElementMap& elements, const std::string& array, const IrTacArg& index)
+{
+    for (auto it = elements.begin(); it != elements.end();)
+    {
+        if (it->second.m_array == array && mayAlias(it->second.m_index, index))
+            it = elements.erase(it);
+        else
+            ++it;
+    }
+}
+
+void transfer(const IrTacStmt& stmt, const IrCallSummary& summary, ElementMap& elements)
+{
+    if (stmt.m_opcode == IrOpcode::CALL)
+    {
+        // elements of arrays the callee leaves alone survive the call
+        auto written = [&](const std::string& name) { return summary.mayWrite(stmt, name); };
+        for (auto it = elements.begin(); it != elements.end();)
+        {
+            const ElementValue& element = it->second;
+            if (written(element.m_array) || isGlobalIn(element.m_index, written) || isGlobalIn(element.m_value, written))
+                it = elements.erase(it);
+            else
+                ++it;
+        }
+    }
+    else if (isMemoryBarrier(stmt))
+    {
+        elements.clear();
+    }
+    
+    const IrTacArg* def = getDefinedVariable(stmt);
+    if (def != nullptr) killVariable(elements, getVariableKey(*def));
+    
+    if (stmt.m_opcode == IrOpcode::LOAD)
+    {
+        // the element is gone when the load overwrites its own index
+        if (stmt.m_src1.isMemory() && getVariableKey(stmt.m_src1) == getVariableKey(stmt.m_dst)) return;
+        
+        const std::string& array = stmt.m_src0.m_asString;
+        elements[array + "[" + getOperandKey(stmt.m_src1) + "]"] = ElementValue{ array, stmt.m_src1, stmt.m_dst };
+    }
+    else if (stmt.m_opcode == IrOpcode::STORE)
+    {
+        const std::string& array = stmt.m_src1.m_asString;
+        killElements(elements, array, stmt.m_dst);
+        elements[array + "[" + getOperandKey(stmt.m_dst) + "]"] = ElementValue{ array, stmt.m_dst, stmt.m_src0 };
+    }
+}
+
+// Forwards the value of an array element from an earlier load or store of
+// the same element to later loads:
+//   STORE x, a, i; ...; LOAD a, i, y  =>  STORE x, a, i; ...; MOV x, y
+// The earlier access did the bounds check already.
+class LoadElimination
+{
+public:
+    LoadElimination(std::vector<IrTacStmt>& stmts, size_t first, size_t last, const IrCallSummary& summary) :
+        m_stmts(stmts),
+        m_summary(summary),
+        m_graph(stmts, first, last),
+        m_visited(m_graph.size(), false),
+        m_out(m_graph.size())
+    {}
+    
+    void solve();
+    bool rewrite();
+    
+private:
+    ElementMap getIn(size_t b) const;
+    
+    std::vector<IrTacStmt>& m_stmts;
+    const IrCallSummary& m_summary;
+    IrFlowGraph m_graph;
+    std::vector<bool> m_visited;
+    std::vector<ElementMap> m_out;
+};
+
+// Element values available with the same value on every visited path into the block.
+ElementMap LoadElimination::getIn(size_t b) const
+{
+    ElementMap in;
+    if (b == 0) return in;
+    
+    bool first = true;
+    for (auto p : m_graph[b].m_preds)
+    {
+        if (!m_visited[p]) continue;
+        if (first)
+        {
+            in = m_out[p];
+            first = false;
+            continue;
+        }
+        for (auto it = in.begin(); it != in.end();)
+        {
+            auto ip = m_out[p].find(it->first);
+            if (ip == m_out[p].end() || getOperandKey(ip->second.m_value) != getOperandKey(it->second.m_value))
+                it = in.erase(it);
+            else
+                ++it;
+        }
+    }
+    return in;
+}
+
+void LoadElimination::solve()
+{
+    const std::vector<size_t> order = m_graph.reversePostorder();
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto b : order)
+        {
+            ElementMap elements = getIn(b);
+            for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+            {
+                transfer(m_stmts[n], m_summary, elements);
+            }
+            if (!m_visited[b] || elements.size() != m_out[b].size() || 
+                !std::equal(elements.begin(), elements.end(), m_out[b].begin(), [](const ElementMap::value_type& a, const ElementMap::value_type& b) {
+                    return (a.first == b.first) && (getOperandKey(a.second.m_value) == getOperandKey(b.second.m_value));
+                }))
+            {
+                m_out[b].swap(elements);
+                m_visited[b] = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool LoadElimination::rewrite()
+{
+    bool changed = false;
+    for (size_t b = 0; b < m_graph.size(); b++)
+    {
+        if (!m_visited[b]) continue;
+        
+        ElementMap elements = getIn(b);
+        for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+        {
+            IrTacStmt& stmt = m_stmts[n];
+            if (stmt.m_opcode == IrOpcode::LOAD)
+            {
+                auto it = elements.find(stmt.m_src0.m_asString + "[" + getOperandKey(stmt.m_src1) + "]");
+                if (it != elements.end() && it->second.m_value.m_type == stmt.m_dst.m_type)
+                {
+                    IrTacStmt copy(IrOpcode::MOV, stmt.m_lineNo);
+                    copy.m_src0 = it->second.m_value;
+                    copy.m_dst = stmt.m_dst;
+                    stmt = copy;
+                    changed = true;
+                }
+            }
+            transfer(stmt, m_summary, elements);
+        }
+    }
+    return changed;
+}
+
+// Stores overwritten in the same block before anything can read them:
+//   STORE x, a, i; ...; STORE y, a, i  =>  ...; STORE y, a, i
+//   MOV x, g; ...; MOV y, g  =>  ...; MOV y, g
+// An out of bounds array store must still fail on its own line, so array
+// stores go only when the index is a literal in range or the overwriting 
+// store comes from the same source line.
+bool removeDeadStores(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, const IrCallSummary& summary, 
+                      std::vector<bool>& removed)
+{
+    bool changed = false;
+    IrFlowGraph graph(stmts, first, last);
+    std::vector<const IrTacArg*> used;
+    for (size_t b = 0; b < graph.size(); b++)
+    {
+        // overwritten elements and the line of the overwriting store, overwritten globals
+        std::map<std::string, std::pair<ElementValue, int>> elements;
+        std::unordered_map<std::string, bool> globals;
+        for (size_t n = graph[b].m_last; n-- > graph[b].m_first;)
+        {
+            const IrTacStmt& stmt = stmts[n];
+            if (stmt.m_opcode == IrOpcode::CALL)
+            {
+                // the callee may read what was about to be overwritten
+                for (auto it = elements.begin(); it != elements.end();)
+                {
+                    if (summary.mayRead(stmt, it->second.first.m_array))
+                        it = elements.erase(it);
+                    else
+                        ++it;
+                }
+                for (auto it = globals.begin(); it != globals.end();)
+                {
+                    if (summary.mayRead(stmt, it->first))
+                        it = globals.erase(it);
+                    else
+                        ++it;
+                }
+            }
+            else if (isMemoryBarrier(stmt))
+            {
+                elements.clear();
+                globals.clear();
+            }
+            
+            if (stmt.m_opcode == IrOpcode::STORE)
+            {
+                const std::string& array = stmt.m_src1.m_asString;
+                const std::string key = array + "[" + getOperandKey(stmt.m_dst) + "]";
+                auto it = elements.find(key);
+                if (it != elements.end())
+                {
+                    const bool inBounds = stmt.m_dst.isLiteral() && stmt.m_dst.m_value.m_int >= 0 && stmt.m_dst.m_value.m_int < stmt.m_info;
+                    if (inBounds || it->second.second == stmt.m_lineNo)
+                    {
+                        removed[n - first] = true;
+                        changed = true;
+                        continue;
+                    }
+                }
+                elements[key] = std::make_pair(ElementValue{ array, stmt.m_dst, IrTacArg() }, stmt.m_lineNo);
+            }
+            else if (stmt.m_opcode == IrOpcode::LOAD)
+            {
+                for (auto it = elements.begin(); it != elements.end();)
+                {
+                    if (it->second.first.m_array == stmt.m_src0.m_asString && mayAlias(it->second.first.m_index, stmt.m_src1))
+                        it = elements.erase(it);
+                    else
+                        ++it;
+                }
+            }
+            
+            const IrTacArg* def = getDefinedVariable(stmt);
+            if (def != nullptr)
+            {
+                const std::string key = getVariableKey(*def);
+                if (def->m_usage == IrUsage::Global)
+                {
+                    if (stmt.m_opcode == IrOpcode::MOV && globals.count(key) != 0)
+                    {
+                        removed[n - first] = true;
+                        changed = true;
+                        continue;
+                    }
+                    globals[key] = true;
+                }
+                
+                // later stores indexed by the variable address other elements
+                for (auto it = elements.begin(); it != elements.end();)
+                {
+                    const IrTacArg& index = it->second.first.m_index;
+                    if (index.isMemory() && getVariableKey(index) == key)
+                        it = elements.erase(it);
+                    else
+                        ++it;
+                }
+            }
+            
+            getUsedVariables(stmt, used);
+            for (auto it : used)
+            {
+                if (it->m_usage == IrUsage::Global) globals.erase(getVariableKey(*it));
+            }
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
+bool IrOptimizer::loadStoreElimination()
+{
+    generateStatements();
+    
+    bool changed = false;
+    std::vector<bool> removed(m_statements.size(), false);
+    const IrCallSummary& summary = getCallSummary();
+    for (auto it : getFunctions(m_statements))
+    {
+        LoadElimination function(m_statements, it.first, it.second, summary);
+        function.solve();
+        if (function.rewrite()) changed = true;
+        
+        std::vector<bool> functionRemoved(it.second - it.first, false);
+        if (removeDeadStores(m_statements, it.first, it.second, summary, functionRemoved)) changed = true;
+        std::copy(functionRemoved.begin(), functionRemoved.end(), removed.begin() + it.first);
+    }
+    
+    if (changed)
+    {
+        std::vector<IrTacStmt> remaining;
+        remaining.reserve(m_statements.size());
+        for (size_t n = 0; n < m_statements.size(); n++)
+        {
+            if (!removed[n]) remaining.push_back(m_statements[n]);
+        }
+        m_statements.swap(remaining);
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
@@ -0,0 +1,238 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include "IrLoop.h"
+#include "IrIdentifier.h"
+
+namespace Decaf
+{
+
+bool isCompilerTemporary(const IrTacArg& arg)
+{
+    return arg.isMemory() && (arg.m_asString.compare(0, 3, ".LC") == 0);
+}
+
+bool isUserVariable(const IrTacArg& arg)
+{
+    return arg.isMemory() && !isCompilerTemporary(arg);
+}
+
+bool isSimpleStatement(const IrTacStmt& stmt)
+{
+    return isMoveOp(stmt.m_opcode) || isBinaryOp(stmt.m_opcode) || isComparisonOp(stmt.m_opcode) ||
+           isLogicOp(stmt.m_opcode) || (stmt.m_opcode == IrOpcode::NOT);
+}
+
+bool isLabelReferencedOutside(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, const std::set<std::string>& labels)
+{
+    if (labels.empty()) return false;
+    for (size_t k = 0; k < stmts.size(); k++)
+    {
+        if (k == first) 
+        {
+            k = last - 1;
+            continue;
+        }
+        const IrTacArg* target = getBranchTarget(stmts[k]);
+        if (target && labels.count(target->m_asString)) return true;
+    }
+    return false;
+}
+
+void copyRegion(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, std::vector<IrTacStmt>& result, std::ptrdiff_t& frameEnd)
+{
+    std::map<std::string, IrTacArg> temps;
+    std::map<std::string, std::string> labels;
+    for (size_t k = first; k < last; k++)
+    {
+        const IrTacStmt& stmt = stmts[k];
+        if (stmt.m_opcode == IrOpcode::LABEL)
+        {
+            labels[stmt.m_src0.m_asString] = IrIdentifier::CreateLabel()->getIdentifier();
+        }
+        const IrTacArg* def = getDefinedVariable(stmt);
+        if (def != nullptr && isCompilerTemporary(*def) && temps.count(def->m_asString) == 0)
+        {
+            IrTacArg& temp = temps[def->m_asString];
+            temp.buildTemporary(IrIdentifier::CreateTemporary()->getIdentifier(), frameEnd, def->m_type);
+            frameEnd += 8;
+        }
+    }
+    
+    for (size_t k = first; k < last; k++)
+    {
+        IrTacStmt stmt = stmts[k];
+        for (auto arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+        {
+            if (arg->m_usage == IrUsage::Label)
+            {
+                auto it = labels.find(arg->m_asString);
+                if (it != labels.end()) arg->buildLabel(it->second);
+            }
+            else if (isCompilerTemporary(*arg))
+            {
+                auto it = temps.find(arg->m_asString);
+                if (it != temps.end()) *arg = it->second;
+            }
+        }
+        result.push_back(stmt);
+    }
+}
+
+bool matchForLoop(const std::vector<IrTacStmt>& stmts, size_t n, IrForLoop& loop)
+{
+    const size_t N = stmts.size();
+    if (n + 1 >= N) return false;
+    
+    const IrTacStmt& init = stmts[n];
+    if (init.m_opcode != IrOpcode::MOV || !isUserVariable(init.m_dst)) return false;
+    if (!init.m_src0.isLiteral() && !isUserVariable(init.m_src0)) return false;
+    if (stmts[n+1].m_opcode != IrOpcode::LABEL) return false;
+    const std::string& topLabel = stmts[n+1].m_src0.m_asString;
+    
+    size_t test = n + 2;
+    while (test < N && isSimpleStatement(stmts[test])) test++;
+    if (test >= N || stmts[test].m_opcode != IrOpcode::IFZ) return false;
+    const std::string& endLabel = stmts[test].m_src1.m_asString;
+    
+    size_t end = test + 1;
+    while (end < N && !(stmts[end].m_opcode == IrOpcode::LABEL && stmts[end].m_src0.m_asString == endLabel))
+    {
+        if (stmts[end].m_opcode == IrOpcode::FBEGIN) return false;
+        end++;
+    }
+    if (end >= N) return false;
+    
+    const size_t jump = end - 1;
+    if (stmts[jump].m_opcode != IrOpcode::JUMP || stmts[jump].m_src0.m_asString != topLabel) return false;
+    
+    size_t cont = jump - 1;
+    while (cont > test && isSimpleStatement(stmts[cont])) cont--;
+    if (cont <= test || stmts[cont].m_opcode != IrOpcode::LABEL) return false;
+    
+    // the step must advance the counter
+    const std::string counter = getVariableKey(init.m_dst);
+    bool advances = false;
+    for (size_t k = cont + 1; k < jump; k++)
+    {
+        const IrTacArg* def = getDefinedVariable(stmts[k]);
+        if (def && getVariableKey(*def) == counter) advances = true;
+    }
+    if (!advances) return false;
+    
+    loop.m_init = n;
+    loop.m_test = test;
+    loop.m_continue = cont;
+    loop.m_jump = jump;
+    loop.m_end = end;
+    return true;
+}
+
+long IrAffineExpr::coefficient(const std::string& key) const
+{
+    auto it = m_terms.find(key);
+    return (it == m_terms.end()) ? 0 : it->second;
+}
+
+void IrAffineExpr::add(const IrAffineExpr& rhs, long scale)
+{
+    m_constant += scale * rhs.m_constant;
+    for (auto it : rhs.m_terms)
+    {
+        long& coef = m_terms[it.first];
+        coef += scale * it.second;
+        if (coef == 0) m_terms.erase(it.first);
+    }
+}
+
+void IrAffineExpr::scale(long factor)
+{
+    if (factor == 0) m_terms.clear();
+    for (auto& it : m_terms) it.second *= factor;
+    m_constant *= factor;
+}
+
+static bool evaluateAffine(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, const IrTacArg& arg, 
+                           const std::function<bool(const IrTacArg&)>& isTerm, IrAffineExpr& expr, int depth)
+{
+    expr = IrAffineExpr();
+    if (isIntLiteral(arg))
+    {
+        expr.m_constant = arg.m_value.m_int;
+        return true;
+    }
+    if (!arg.isMemory() || depth > 16) return false;
+    
+    if (!isCompilerTemporary(arg))
+    {
+        if (!isTerm(arg)) return false;
+        expr.m_terms[getVariableKey(arg)] = 1;
+        return true;
+    }
+    
+    const IrTacStmt* def = nullptr;
+    for (size_t k = first; k < last; k++)
+    {
+        const IrTacArg* d = getDefinedVariable(stmts[k]);
+        if (d && d->m_asString == arg.m_asString)
+        {
+            if (def) return false;
+            def = &stmts[k];
+        }
+    }
+    if (def == nullptr) return false;
+    
+    IrAffineExpr lhs, rhs;
+    switch (def->m_opcode)
+    {
+        case IrOpcode::MOV:
+            return evaluateAffine(stmts, first, last, def->m_src0, isTerm, expr, depth+1);
+        case IrOpcode::ADD:
+        case IrOpcode::SUB:
+            // a missing left operand is a negation
+            if (def->hasSrc0() && !evaluateAffine(stmts, first, last, def->m_src0, isTerm, lhs, depth+1)) return false;
+            if (!evaluateAffine(stmts, first, last, def->m_src1, isTerm, rhs, depth+1)) return false;
+            expr = lhs;
+            expr.add(rhs, (def->m_opcode == IrOpcode::ADD) ? 1 : -1);
+            return true;
+        case IrOpcode::MUL:
+            if (!evaluateAffine(stmts, first, last, def->m_src0, isTerm, lhs, depth+1)) return false;
+            if (!evaluateAffine(stmts, first, last, def->m_src1, isTerm, rhs, depth+1)) return false;
+            if (!lhs.isConstant()) std::swap(lhs, rhs);
+            if (!lhs.isConstant()) return false;
+            expr = rhs;
+            expr.scale(lhs.m_constant);
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+bool evaluateAffine(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, const IrTacArg& arg, 
+                    const std::function<bool(const IrTacArg&)>& isTerm, IrAffineExpr& expr)
+{
+    return evaluateAffine(stmts, first, last, arg, isTerm, expr, 0);
+}
+
+} // namespace Decaf
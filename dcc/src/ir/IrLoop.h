@@ -0,0 +1,99 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "IrTAC.h"
+
+namespace Decaf
+{
+
+// Canonical for-loop as laid out by IrForStatement::codegen(), given as
+// statement indices:
+//
+//       MOV init, i         <- m_init
+//   top:
+//       <condition>
+//       IFZ cond, end       <- m_test
+//       <body>
+//   continue:               <- m_continue
+//       <step>
+//       JUMP top            <- m_jump
+//   end:                    <- m_end
+struct IrForLoop
+{
+    size_t m_init;
+    size_t m_test;
+    size_t m_continue;
+    size_t m_jump;
+    size_t m_end;
+    
+    size_t top() const { return m_init + 1; }
+    size_t bodyBegin() const { return m_test + 1; }
+    size_t bodyEnd() const { return m_continue; }
+};
+
+bool matchForLoop(const std::vector<IrTacStmt>& stmts, size_t n, IrForLoop& loop);
+
+// Compiler generated temporary (.LC<n>) or user variable.
+bool isCompilerTemporary(const IrTacArg& arg);
+bool isUserVariable(const IrTacArg& arg);
+
+// True when a branch outside [first, last) targets one of 'labels'.
+bool isLabelReferencedOutside(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, const std::set<std::string>& labels);
+
+// Appends a copy of [first, last) to 'result' with fresh labels and fresh
+// temporaries, whose frame slots are taken from 'frameEnd'.
+void copyRegion(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, std::vector<IrTacStmt>& result, std::ptrdiff_t& frameEnd);
+
+// Statements without control flow, calls or memory accesses.
+bool isSimpleStatement(const IrTacStmt& stmt);
+
+// Affine expression sum(k*v) + constant over variables keyed by getVariableKey().
+struct IrAffineExpr
+{
+    std::map<std::string, long> m_terms;
+    long m_constant = 0;
+    
+    bool isConstant() const { return m_terms.empty(); }
+    long coefficient(const std::string& key) const;
+    
+    void add(const IrAffineExpr& rhs, long scale = 1);
+    void scale(long factor);
+    
+    bool operator==(const IrAffineExpr& rhs) const
+    {
+        return (m_terms == rhs.m_terms) && (m_constant == rhs.m_constant);
+    }
+};
+
+// Express 'arg' as an affine function of the variables accepted by 'isTerm'.
+// Temporaries are expanded through their single definition in [first, last).
+bool evaluateAffine(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, const IrTacArg& arg, 
+                    const std::function<bool(const IrTacArg&)>& isTerm, IrAffineExpr& expr);
+
+} // namespace Decaf
@@ -0,0 +1,359 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <map>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Memory and control flow summary of a loop body.
+struct BodySummary
+{
+    std::set<std::string> m_reads;
+    std::set<std::string> m_writes;
+    // variables unconditionally written before being read on each iteration
+    std::set<std::string> m_private;
+    std::set<std::string> m_arraysRead;
+    std::set<std::string> m_arraysWritten;
+    std::set<std::string> m_labels;
+    std::set<std::string> m_targets;
+    bool m_hasCall = false;
+    bool m_hasReturn = false;
+    bool m_touchesGlobals = false;
+};
+
+// Operands match, allowing a consistent renaming of temporaries.
+bool sameArg(const IrTacArg& a, const IrTacArg& b, std::map<std::string, std::string>& renames)
+{
+    if (a.m_usage != b.m_usage || a.m_type != b.m_type) return false;
+    if (!a.isMemory()) return (a.m_asString == b.m_asString);
+    
+    if (isCompilerTemporary(a) != isCompilerTemporary(b)) return false;
+    if (!isCompilerTemporary(a)) return (getVariableKey(a) == getVariableKey(b));
+    
+    auto it = renames.find(b.m_asString);
+    if (it != renames.end()) return (it->second == a.m_asString);
+    for (auto ir : renames)
+    {
+        if (ir.second == a.m_asString) return false;
+    }
+    renames[b.m_asString] = a.m_asString;
+    return true;
+}
+
+bool sameCode(const std::vector<IrTacStmt>& stmts, size_t first0, size_t last0, size_t first1, size_t last1, 
+              std::map<std::string, std::string>& renames)
+{
+    if (last0 - first0 != last1 - first1) return false;
+    
+    for (size_t k = 0; k < last0 - first0; k++)
+    {
+        const IrTacStmt& a = stmts[first0 + k];
+        const IrTacStmt& b = stmts[first1 + k];
+        if (a.m_opcode != b.m_opcode) return false;
+        if (!sameArg(a.m_src0, b.m_src0, renames) || !sameArg(a.m_src1, b.m_src1, renames) || !sameArg(a.m_dst, b.m_dst, renames)) 
+            return false;
+    }
+    return true;
+}
+
+void summarizeBody(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, BodySummary& body)
+{
+    bool straightLine = true;
+    std::set<std::string> seen;
+    std::vector<const IrTacArg*> used;
+    
+    for (size_t k = first; k < last; k++)
+    {
+        const IrTacStmt& stmt = stmts[k];
+        switch (stmt.m_opcode)
+        {
+            case IrOpcode::LABEL:
+                body.m_labels.insert(stmt.m_src0.m_asString);
+                straightLine = false;
+                break;
+            case IrOpcode::JUMP:
+                body.m_targets.insert(stmt.m_src0.m_asString);
+                straightLine = false;
+                break;
+            case IrOpcode::IFZ:
+            case IrOpcode::IFNZ:
+                body.m_targets.insert(stmt.m_src1.m_asString);
+                break;
+            case IrOpcode::CALL:
+                body.m_hasCall = true;
+                break;
+            case IrOpcode::RETURN:
+            case IrOpcode::FBEGIN:
+                body.m_hasReturn = true;
+                break;
+            case IrOpcode::LOAD:
+                body.m_arraysRead.insert(stmt.m_src0.m_asString);
+                body.m_touchesGlobals = true;
+                break;
+            case IrOpcode::STORE:
+                body.m_arraysWritten.insert(stmt.m_src1.m_asString);
+                body.m_touchesGlobals = true;
+                break;
+            default:
+                break;
+        }
+        
+        getUsedVariables(stmt, used);
+        for (auto it : used)
+        {
+            const std::string key = getVariableKey(*it);
+            body.m_reads.insert(key);
+            seen.insert(key);
+            if (it->m_usage == IrUsage::Global) body.m_touchesGlobals = true;
+        }
+        
+        const IrTacArg* def = getDefinedVariable(stmt);
+        if (def)
+        {
+            const std::string key = getVariableKey(*def);
+            body.m_writes.insert(key);
+            if (def->m_usage == IrUsage::Global) body.m_touchesGlobals = true;
+            if (seen.insert(key).second && straightLine) body.m_private.insert(key);
+        }
+        
+        if (stmt.m_opcode == IrOpcode::IFZ || stmt.m_opcode == IrOpcode::IFNZ) 
+            straightLine = false;
+    }
+}
+
+// Straight-line code between the loops can move above the first loop when the
+// two do not interact.
+bool canHoistAbove(const IrTacStmt& stmt, const BodySummary& loop)
+{
+    if (!isSimpleStatement(stmt)) return false;
+    
+    std::vector<const IrTacArg*> used;
+    getUsedVariables(stmt, used);
+    for (auto it : used)
+    {
+        if (loop.m_writes.count(getVariableKey(*it))) return false;
+        if (loop.m_hasCall && it->m_usage == IrUsage::Global) return false;
+    }
+    
+    const IrTacArg* def = getDefinedVariable(stmt);
+    if (def)
+    {
+        const std::string key = getVariableKey(*def);
+        if (loop.m_reads.count(key) || loop.m_writes.count(key)) return false;
+        if (loop.m_hasCall && def->m_usage == IrUsage::Global) return false;
+    }
+    return true;
+}
+
+// Every access to 'array' in the range uses 'index' (or sets it if not yet known).
+bool sameArrayIndex(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, const std::string& array,
+                    const std::string& counter, const std::set<std::string>& variant, IrAffineExpr& index, bool& known)
+{
+    auto isTerm = [&](const IrTacArg& arg) 
+    {
+        const std::string key = getVariableKey(arg);
+        return (key == counter) || (variant.count(key) == 0);
+    };
+    
+    for (size_t k = first; k < last; k++)
+    {
+        const IrTacStmt& stmt = stmts[k];
+        const IrTacArg* offset = nullptr;
+        if (stmt.m_opcode == IrOpcode::LOAD && stmt.m_src0.m_asString == array)
+            offset = &stmt.m_src1;
+        else if (stmt.m_opcode == IrOpcode::STORE && stmt.m_src1.m_asString == array)
+            offset = &stmt.m_dst;
+        if (offset == nullptr) continue;
+        
+        IrAffineExpr access;
+        if (!evaluateAffine(stmts, first, last, *offset, isTerm, access)) return false;
+        if (!known)
+        {
+            // a loop invariant index carries a dependence between iterations
+            if (access.coefficient(counter) == 0) return false;
+            index = access;
+            known = true;
+        }
+        else if (!(access == index))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool canFuse(const std::vector<IrTacStmt>& stmts, const IrForLoop& first, const IrForLoop& second)
+{
+    // identical iteration space: same counter, start, condition and step
+    const IrTacStmt& init0 = stmts[first.m_init];
+    const IrTacStmt& init1 = stmts[second.m_init];
+    std::map<std::string, std::string> renames;
+    if (!sameArg(init0.m_src0, init1.m_src0, renames) || !sameArg(init0.m_dst, init1.m_dst, renames)) return false;
+    if (!sameCode(stmts, first.m_init + 2, first.m_test, second.m_init + 2, second.m_test, renames)) return false;
+    if (!sameArg(stmts[first.m_test].m_src0, stmts[second.m_test].m_src0, renames)) return false;
+    if (!sameCode(stmts, first.m_continue + 1, first.m_jump, second.m_continue + 1, second.m_jump, renames)) return false;
+    
+    const std::string counter = getVariableKey(init0.m_dst);
+    
+    BodySummary body0, body1;
+    summarizeBody(stmts, first.m_test + 1, first.m_continue, body0);
+    summarizeBody(stmts, second.m_test + 1, second.m_continue, body1);
+    
+    // single entry and exit bodies only: no break, continue, goto or return
+    for (auto body : { &body0, &body1 })
+    {
+        if (body->m_hasReturn) return false;
+        for (auto it : body->m_targets)
+        {
+            if (body->m_labels.count(it) == 0) return false;
+        }
+    }
+    if (isLabelReferencedOutside(stmts, first.m_test + 1, first.m_continue, body0.m_labels)) return false;
+    if (isLabelReferencedOutside(stmts, second.m_test + 1, second.m_continue, body1.m_labels)) return false;
+    
+    // neither body may change the iteration space
+    std::set<std::string> control;
+    bool controlGlobal = (init0.m_dst.m_usage == IrUsage::Global) || (init0.m_src0.m_usage == IrUsage::Global);
+    control.insert(counter);
+    if (init0.m_src0.isMemory()) control.insert(getVariableKey(init0.m_src0));
+    std::vector<const IrTacArg*> used;
+    for (size_t k = first.m_init + 2; k < first.m_jump; k++)
+    {
+        if (k == first.m_test + 1) k = first.m_continue + 1;
+        getUsedVariables(stmts[k], used);
+        for (auto it : used)
+        {
+            if (isCompilerTemporary(*it)) continue;
+            control.insert(getVariableKey(*it));
+            if (it->m_usage == IrUsage::Global) controlGlobal = true;
+        }
+    }
+    for (auto it : control)
+    {
+        if (body0.m_writes.count(it) || body1.m_writes.count(it)) return false;
+    }
+    
+    // calls may have arbitrary effects on globals and must stay in order
+    if (body0.m_hasCall && body1.m_hasCall) return false;
+    if (body0.m_hasCall && (body1.m_touchesGlobals || controlGlobal)) return false;
+    if (body1.m_hasCall && (body0.m_touchesGlobals || controlGlobal)) return false;
+    
+    // scalars shared between the bodies must be private to each iteration of both
+    for (auto it : body0.m_writes)
+    {
+        if (body1.m_reads.count(it) || body1.m_writes.count(it))
+        {
+            if (!body1.m_writes.count(it) || !body0.m_private.count(it) || !body1.m_private.count(it)) return false;
+        }
+    }
+    for (auto it : body1.m_writes)
+    {
+        if (body0.m_reads.count(it))
+        {
+            if (!body0.m_writes.count(it) || !body0.m_private.count(it) || !body1.m_private.count(it)) return false;
+        }
+    }
+    
+    // arrays written by one body and accessed by the other must be indexed
+    // identically by an affine function of the counter
+    std::set<std::string> variant(body0.m_writes);
+    variant.insert(body1.m_writes.begin(), body1.m_writes.end());
+    std::set<std::string> arrays(body0.m_arraysWritten);
+    arrays.insert(body1.m_arraysWritten.begin(), body1.m_arraysWritten.end());
+    for (auto it : arrays)
+    {
+        const bool inFirst = body0.m_arraysRead.count(it) || body0.m_arraysWritten.count(it);
+        const bool inSecond = body1.m_arraysRead.count(it) || body1.m_arraysWritten.count(it);
+        if (!inFirst || !inSecond) continue;
+        
+        IrAffineExpr index;
+        bool known = false;
+        if (!sameArrayIndex(stmts, first.m_test + 1, first.m_continue, it, counter, variant, index, known)) return false;
+        if (!sameArrayIndex(stmts, second.m_test + 1, second.m_continue, it, counter, variant, index, known)) return false;
+    }
+    
+    return true;
+}
+
+} // namespace
+
+bool IrOptimizer::loopFusion()
+{
+    generateStatements();
+    
+    bool changed = false;
+    size_t n = 0;
+    while (n < m_statements.size())
+    {
+        IrForLoop first, second;
+        if (!matchForLoop(m_statements, n, first))
+        {
+            n++;
+            continue;
+        }
+        
+        BodySummary loop;
+        summarizeBody(m_statements, first.m_init, first.m_end + 1, loop);
+        size_t gap = first.m_end + 1;
+        while (gap < m_statements.size() && canHoistAbove(m_statements[gap], loop)) gap++;
+        
+        if (matchForLoop(m_statements, gap, second) && canFuse(m_statements, first, second))
+        {
+            // Statements between the loops move above the first loop, the second
+            // body joins the first and the second loop's control and its now
+            // unreferenced labels are dropped:
+            //   gap; init; top: cond; IFZ end; body0; body1; continue: step; JUMP top; end:
+            std::vector<IrTacStmt> fused;
+            fused.reserve(m_statements.size());
+            fused.insert(fused.end(), m_statements.begin(), m_statements.begin() + first.m_init);
+            fused.insert(fused.end(), m_statements.begin() + first.m_end + 1, m_statements.begin() + gap);
+            fused.insert(fused.end(), m_statements.begin() + first.m_init, m_statements.begin() + first.m_continue);
+            fused.insert(fused.end(), m_statements.begin() + second.m_test + 1, m_statements.begin() + second.m_continue);
+            fused.insert(fused.end(), m_statements.begin() + first.m_continue, m_statements.begin() + first.m_end + 1);
+            fused.insert(fused.end(), m_statements.begin() + second.m_end + 1, m_statements.end());
+            m_statements.swap(fused);
+            
+            // try to fuse the result with the following loop
+            n += gap - first.m_end - 1;
+            changed = true;
+            continue;
+        }
+        n++;
+    }
+    
+    if (changed)
+    {
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
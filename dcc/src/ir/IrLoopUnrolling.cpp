@@ -0,0 +1,371 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+#include "IrIdentifier.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Code size budget of an unrolled loop body, in statements.
+const long UNROLL_BUDGET = 128;
+
+// Canonical for-loop whose counter moves by a constant step until a
+// comparison against a loop invariant bound fails:
+//   for (i = init; i < bound; i += step)
+struct CountedLoop
+{
+    IrForLoop m_loop;
+    IrTacArg m_counter;
+    // the comparison of the counter with the bound, ending the condition
+    size_t m_compare;
+    long m_step;
+    // the body has no labels or branches
+    bool m_straightLine;
+};
+
+bool isCounter(const IrTacArg& arg, const std::string& counter)
+{
+    return arg.isMemory() && (getVariableKey(arg) == counter);
+}
+
+// Constant added to the counter by the step statements, or 0.
+long getStep(const std::vector<IrTacStmt>& stmts, const IrForLoop& loop, const std::string& counter)
+{
+    size_t def = loop.m_jump;
+    for (size_t k = loop.m_continue + 1; k < loop.m_jump; k++)
+    {
+        const IrTacArg* d = getDefinedVariable(stmts[k]);
+        if (d == nullptr) continue;
+        if (isCounter(*d, counter))
+        {
+            if (def != loop.m_jump) return 0;
+            def = k;
+        }
+        else if (!isCompilerTemporary(*d))
+        {
+            return 0;
+        }
+    }
+    
+    // nothing after the update may see the new value
+    std::vector<const IrTacArg*> used;
+    for (size_t k = def + 1; k < loop.m_jump; k++)
+    {
+        getUsedVariables(stmts[k], used);
+        for (auto it : used)
+        {
+            if (isCounter(*it, counter)) return 0;
+        }
+    }
+    
+    auto isTerm = [&counter](const IrTacArg& arg) { return getVariableKey(arg) == counter; };
+    const IrTacStmt& update = stmts[def];
+    IrAffineExpr value, rhs;
+    if (update.m_opcode == IrOpcode::MOV)
+    {
+        if (!evaluateAffine(stmts, loop.m_continue + 1, loop.m_jump, update.m_src0, isTerm, value)) return 0;
+    }
+    else if (update.m_opcode == IrOpcode::ADD || update.m_opcode == IrOpcode::SUB)
+    {
+        if (!update.hasSrc0() || !evaluateAffine(stmts, loop.m_continue + 1, loop.m_jump, update.m_src0, isTerm, value)) return 0;
+        if (!evaluateAffine(stmts, loop.m_continue + 1, loop.m_jump, update.m_src1, isTerm, rhs)) return 0;
+        value.add(rhs, (update.m_opcode == IrOpcode::ADD) ? 1 : -1);
+    }
+    else
+    {
+        return 0;
+    }
+    if (value.m_terms.size() != 1 || value.coefficient(counter) != 1) return 0;
+    return value.m_constant;
+}
+
+bool matchCountedLoop(const std::vector<IrTacStmt>& stmts, size_t n, CountedLoop& counted)
+{
+    IrForLoop& loop = counted.m_loop;
+    if (!matchForLoop(stmts, n, loop)) return false;
+    
+    // a global counter could change behind a call
+    const IrTacStmt& init = stmts[loop.m_init];
+    if (init.m_dst.m_usage != IrUsage::Identifier || init.m_dst.m_type != IrArgType::Integer) return false;
+    counted.m_counter = init.m_dst;
+    const std::string counter = getVariableKey(init.m_dst);
+    
+    // the condition only computes temporaries and reads the counter once, in the final comparison
+    if (loop.m_test <= loop.top() + 1) return false;
+    counted.m_compare = loop.m_test - 1;
+    const IrTacStmt& compare = stmts[counted.m_compare];
+    if (compare.m_opcode != IrOpcode::LESS && compare.m_opcode != IrOpcode::LESSEQUAL &&
+        compare.m_opcode != IrOpcode::GREATER && compare.m_opcode != IrOpcode::GREATEREQUAL) return false;
+    if (!isCounter(compare.m_src0, counter) || !compare.m_dst.isMemory() || 
+        !stmts[loop.m_test].m_src0.isMemory() || getVariableKey(compare.m_dst) != getVariableKey(stmts[loop.m_test].m_src0)) return false;
+    
+    // a call in the condition must run once per test, as it was written
+    std::vector<const IrTacArg*> used;
+    for (size_t k = loop.top() + 1; k < counted.m_compare; k++)
+    {
+        if (stmts[k].m_opcode == IrOpcode::CALL) return false;
+        const IrTacArg* def = getDefinedVariable(stmts[k]);
+        if (def != nullptr && !isCompilerTemporary(*def)) return false;
+        getUsedVariables(stmts[k], used);
+        for (auto it : used)
+        {
+            if (isCounter(*it, counter)) return false;
+        }
+    }
+    if (isCounter(compare.m_src1, counter)) return false;
+    
+    counted.m_step = getStep(stmts, loop, counter);
+    const bool up = (compare.m_opcode == IrOpcode::LESS || compare.m_opcode == IrOpcode::LESSEQUAL);
+    if ((up && counted.m_step <= 0) || (!up && counted.m_step >= 0)) return false;
+    
+    // the body leaves the counter alone and has no break, continue or goto out of it
+    std::set<std::string> labels, targets;
+    counted.m_straightLine = true;
+    for (size_t k = loop.bodyBegin(); k < loop.bodyEnd(); k++)
+    {
+        const IrTacStmt& stmt = stmts[k];
+        const IrTacArg* def = getDefinedVariable(stmt);
+        if (def != nullptr && isCounter(*def, counter)) return false;
+        
+        if (stmt.m_opcode == IrOpcode::LABEL) labels.insert(stmt.m_src0.m_asString);
+        const IrTacArg* target = getBranchTarget(stmt);
+        if (target != nullptr) targets.insert(target->m_asString);
+        if (stmt.m_opcode == IrOpcode::LABEL || target != nullptr || stmt.m_opcode == IrOpcode::PARFOR) counted.m_straightLine = false;
+    }
+    for (auto it : targets)
+    {
+        if (labels.count(it) == 0) return false;
+    }
+    if (isLabelReferencedOutside(stmts, loop.bodyBegin(), loop.bodyEnd(), labels)) return false;
+    
+    std::set<std::string> loopLabels = { stmts[loop.top()].m_src0.m_asString, stmts[loop.m_continue].m_src0.m_asString };
+    return !isLabelReferencedOutside(stmts, loop.m_init, loop.m_end, loopLabels);
+}
+
+// Trip count of a loop with literal start and bound, or -1.
+long getTripCount(const std::vector<IrTacStmt>& stmts, const CountedLoop& counted)
+{
+    const IrTacArg& init = stmts[counted.m_loop.m_init].m_src0;
+    const IrTacStmt& compare = stmts[counted.m_compare];
+    if (!isIntLiteral(init) || !isIntLiteral(compare.m_src1)) return -1;
+    
+    // distance to the last value passing the test, counted in the step direction
+    long distance = 0;
+    const long step = std::abs(counted.m_step);
+    switch (compare.m_opcode)
+    {
+        case IrOpcode::LESS:         distance = compare.m_src1.m_value.m_int - 1 - init.m_value.m_int; break;
+        case IrOpcode::LESSEQUAL:    distance = compare.m_src1.m_value.m_int - init.m_value.m_int; break;
+        case IrOpcode::GREATER:      distance = init.m_value.m_int - compare.m_src1.m_value.m_int - 1; break;
+        case IrOpcode::GREATEREQUAL: distance = init.m_value.m_int - compare.m_src1.m_value.m_int; break;
+        default: return -1;
+    }
+    return (distance < 0) ? 0 : (distance / step + 1);
+}
+
+// Iterations per entry measured by a profile, or -1 without one.  Each test
+// of the condition either runs the body or leaves the loop.
+double getProfiledTrips(const std::vector<IrTacStmt>& stmts, const IrForLoop& loop)
+{
+    const long tests = stmts[loop.top()].m_count;
+    const long iterations = stmts[loop.bodyBegin()].m_count;
+    if (tests < 0 || iterations < 0) return -1.0;
+    if (tests == 0) return 0.0;
+    return (double)iterations / (double)std::max(1l, tests - iterations);
+}
+
+// The body is copied once per iteration with the counter replaced by its
+// value; the counter is left with its final value.
+bool unrollFully(const std::vector<IrTacStmt>& stmts, const CountedLoop& counted, std::ptrdiff_t& frameEnd, std::vector<IrTacStmt>& result)
+{
+    const IrForLoop& loop = counted.m_loop;
+    const long trips = getTripCount(stmts, counted);
+    const long size = std::max<long>(1, (long)(loop.bodyEnd() - loop.bodyBegin()));
+    if (trips < 0 || trips * size > UNROLL_BUDGET) return false;
+    
+    const std::string counter = getVariableKey(counted.m_counter);
+    const long init = stmts[loop.m_init].m_src0.m_value.m_int;
+    std::vector<const IrTacArg*> used;
+    for (long trip = 0; trip < trips; trip++)
+    {
+        IrTacArg value;
+        value.buildInteger(init + trip * counted.m_step);
+        const size_t first = result.size();
+        copyRegion(stmts, loop.bodyBegin(), loop.bodyEnd(), result, frameEnd);
+        for (size_t k = first; k < result.size(); k++)
+        {
+            getUsedVariables(result[k], used);
+            for (auto it : used)
+            {
+                if (isCounter(*it, counter)) *getOperand(result[k], it) = value;
+            }
+        }
+    }
+    
+    IrTacStmt last(IrOpcode::MOV, stmts[loop.m_init].m_lineNo);
+    last.m_src0.buildInteger(init + trips * counted.m_step);
+    last.m_dst = counted.m_counter;
+    result.push_back(last);
+    result.push_back(stmts[loop.m_end]);
+    return true;
+}
+
+// 'factor' iterations run back to back while the last of them still passes
+// the test; the original loop is left to run the remaining ones:
+//   MOV init, i
+//   top':   ADD i, (factor-1)*step, t; <condition on t>; IFZ cond, top
+//           <body; step> x factor
+//           JUMP top'
+//   top:    <original loop>
+bool unrollPartially(const std::vector<IrTacStmt>& stmts, const CountedLoop& counted, int factor, std::ptrdiff_t& frameEnd, 
+                     std::vector<IrTacStmt>& result)
+{
+    const IrForLoop& loop = counted.m_loop;
+    if (!counted.m_straightLine) return false;
+    
+    const long size = std::max<long>(1, (long)(loop.bodyEnd() - loop.bodyBegin() + loop.m_jump - loop.m_continue - 1));
+    factor = (int)std::min<long>(factor, UNROLL_BUDGET / size);
+    if (factor < 2) return false;
+    
+    // the bound must not change inside the loop
+    std::set<std::string> written;
+    bool hasCall = false;
+    for (size_t k = loop.bodyBegin(); k < loop.m_jump; k++)
+    {
+        const IrTacArg* def = getDefinedVariable(stmts[k]);
+        if (def != nullptr) written.insert(getVariableKey(*def));
+        hasCall |= (stmts[k].m_opcode == IrOpcode::CALL);
+    }
+    std::vector<const IrTacArg*> used;
+    for (size_t k = loop.top() + 1; k <= counted.m_compare; k++)
+    {
+        // the look-ahead test would run a call in the condition an extra time
+        if (stmts[k].m_opcode == IrOpcode::CALL) return false;
+        getUsedVariables(stmts[k], used);
+        for (auto it : used)
+        {
+            if (isCounter(*it, getVariableKey(counted.m_counter))) continue;
+            if (written.count(getVariableKey(*it)) != 0 || (hasCall && it->m_usage == IrUsage::Global)) return false;
+        }
+    }
+    
+    const int lineNo = stmts[loop.m_test].m_lineNo;
+    result.push_back(stmts[loop.m_init]);
+    
+    IrTacStmt top(IrOpcode::LABEL, lineNo);
+    top.m_src0.buildLabel(IrIdentifier::CreateLabel()->getIdentifier());
+    result.push_back(top);
+    
+    IrTacStmt ahead(IrOpcode::ADD, lineNo);
+    ahead.m_src0 = counted.m_counter;
+    ahead.m_src1.buildInteger((factor - 1) * counted.m_step);
+    ahead.m_dst.buildTemporary(IrIdentifier::CreateTemporary()->getIdentifier(), frameEnd);
+    frameEnd += 8;
+    result.push_back(ahead);
+    
+    const size_t guard = result.size();
+    copyRegion(stmts, loop.top() + 1, loop.m_test + 1, result, frameEnd);
+    result[guard + (counted.m_compare - loop.top() - 1)].m_src0 = ahead.m_dst;
+    result.back().m_src1 = stmts[loop.top()].m_src0;
+    
+    for (int k = 0; k < factor; k++)
+    {
+        copyRegion(stmts, loop.bodyBegin(), loop.bodyEnd(), result, frameEnd);
+        copyRegion(stmts, loop.m_continue + 1, loop.m_jump, result, frameEnd);
+    }
+    
+    IrTacStmt jump(IrOpcode::JUMP, lineNo);
+    jump.m_src0 = top.m_src0;
+    result.push_back(jump);
+    result.insert(result.end(), stmts.begin() + loop.top(), stmts.begin() + loop.m_end + 1);
+    return true;
+}
+
+} // namespace
+
+// Counted loops with a small constant trip count are unrolled completely;
+// other counted loops with straight-line bodies run 'factor' iterations per
+// test, within a code size budget.  Inner loops are unrolled first.
+bool IrOptimizer::loopUnrolling(int factor)
+{
+    generateStatements();
+    
+    const auto functions = getFunctions(m_statements);
+    if (functions.empty()) return false;
+    
+    bool changed = false;
+    std::vector<IrTacStmt> result;
+    result.reserve(m_statements.size());
+    result.insert(result.end(), m_statements.begin(), m_statements.begin() + functions.front().first);
+    for (auto it : functions)
+    {
+        std::vector<IrTacStmt> code(m_statements.begin() + it.first, m_statements.begin() + it.second);
+        std::ptrdiff_t frameEnd = getFrameEnd(m_statements, it.first, it.second);
+        
+        bool unrolled = false;
+        for (size_t n = code.size(); n-- > 1;)
+        {
+            CountedLoop counted;
+            if (!matchCountedLoop(code, n, counted)) continue;
+            
+            // profiled loops that never ran keep their size, short ones are not
+            // worth a partially unrolled copy
+            const double trips = getProfiledTrips(code, counted.m_loop);
+            if (trips == 0.0) continue;
+            const bool isShort = (trips > 0.0) && (trips < factor);
+            
+            std::vector<IrTacStmt> loop;
+            if (!unrollFully(code, counted, frameEnd, loop) && (isShort || !unrollPartially(code, counted, factor, frameEnd, loop))) continue;
+            
+            code.erase(code.begin() + n, code.begin() + counted.m_loop.m_end + 1);
+            code.insert(code.begin() + n, loop.begin(), loop.end());
+            unrolled = true;
+        }
+        
+        if (unrolled)
+        {
+            code.front().m_info = std::max(code.front().m_info, alignFrameSize(frameEnd));
+            changed = true;
+        }
+        result.insert(result.end(), code.begin(), code.end());
+    }
+    
+    if (changed)
+    {
+        m_statements.swap(result);
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
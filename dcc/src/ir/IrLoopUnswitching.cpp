@@ -0,0 +1,293 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+#include "IrIdentifier.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Largest loop, in statements, that is duplicated.
+const size_t MAX_UNSWITCHED_LOOP = 256;
+
+// Branch in a loop body whose condition does not change inside the loop,
+// with the statements computing the condition.
+struct InvariantTest
+{
+    size_t m_branch;
+    std::vector<size_t> m_slice;
+};
+
+class InvariantFinder
+{
+public:
+    InvariantFinder(const std::vector<IrTacStmt>& stmts, const IrForLoop& loop);
+    
+    bool find(InvariantTest& test) const;
+    
+private:
+    bool trace(const IrTacArg& arg, std::vector<size_t>& slice, int depth) const;
+    
+    const std::vector<IrTacStmt>& m_stmts;
+    const IrForLoop& m_loop;
+    std::set<std::string> m_written;
+    bool m_hasCall;
+};
+
+InvariantFinder::InvariantFinder(const std::vector<IrTacStmt>& stmts, const IrForLoop& loop) :
+    m_stmts(stmts),
+    m_loop(loop),
+    m_written(),
+    m_hasCall(false)
+{
+    for (size_t k = loop.m_init; k <= loop.m_end; k++)
+    {
+        const IrTacArg* def = getDefinedVariable(stmts[k]);
+        if (def != nullptr) m_written.insert(getVariableKey(*def));
+        m_hasCall |= (stmts[k].m_opcode == IrOpcode::CALL || stmts[k].m_opcode == IrOpcode::PARFOR);
+    }
+}
+
+// Variables the loop does not write are invariant; temporaries are when
+// their single definition in the loop is a pure computation of invariants.
+bool InvariantFinder::trace(const IrTacArg& arg, std::vector<size_t>& slice, int depth) const
+{
+    if (arg.isLiteral()) return true;
+    if (!arg.isMemory() || depth > 8) return false;
+    if (!isCompilerTemporary(arg))
+    {
+        // a call may change a global
+        return (m_written.count(getVariableKey(arg)) == 0) && !(m_hasCall && arg.m_usage == IrUsage::Global);
+    }
+    
+    size_t def = m_loop.m_end;
+    for (size_t k = m_loop.m_init; k < m_loop.m_end; k++)
+    {
+        const IrTacArg* d = getDefinedVariable(m_stmts[k]);
+        if (d == nullptr || getVariableKey(*d) != getVariableKey(arg)) continue;
+        if (def != m_loop.m_end) return false;
+        def = k;
+    }
+    if (def == m_loop.m_end) return false;
+    
+    const IrTacStmt& stmt = m_stmts[def];
+    if (!isSimpleStatement(stmt)) return false;
+    if ((stmt.m_opcode == IrOpcode::DIV || stmt.m_opcode == IrOpcode::MOD) && !stmt.m_dst.isDouble()) return false;
+    
+    std::vector<const IrTacArg*> used;
+    getUsedVariables(stmt, used);
+    for (auto it : used)
+    {
+        if (!trace(*it, slice, depth + 1)) return false;
+    }
+    if (std::find(slice.begin(), slice.end(), def) == slice.end()) slice.push_back(def);
+    return true;
+}
+
+bool InvariantFinder::find(InvariantTest& test) const
+{
+    for (size_t k = m_loop.bodyBegin(); k < m_loop.bodyEnd(); k++)
+    {
+        const IrTacStmt& stmt = m_stmts[k];
+        if (stmt.m_opcode != IrOpcode::IFZ && stmt.m_opcode != IrOpcode::IFNZ) continue;
+        
+        test.m_slice.clear();
+        if (!trace(stmt.m_src0, test.m_slice, 0)) continue;
+        test.m_branch = k;
+        std::sort(test.m_slice.begin(), test.m_slice.end());
+        return true;
+    }
+    return false;
+}
+
+// Drops the code a removed or unconditional branch left unreachable in
+// [first, last) of a loop body, jumps to the next statement and the labels
+// nothing refers to any more.  Returns the new end of the body.
+size_t removeDeadArms(std::vector<IrTacStmt>& stmts, size_t first, size_t last)
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        std::set<std::string> targets;
+        for (auto& stmt : stmts)
+        {
+            const IrTacArg* target = getBranchTarget(stmt);
+            if (target != nullptr) targets.insert(target->m_asString);
+        }
+        
+        bool reachable = true;
+        for (size_t k = first; k < last;)
+        {
+            const IrTacStmt& stmt = stmts[k];
+            bool dead = false;
+            if (stmt.m_opcode == IrOpcode::LABEL)
+            {
+                dead = (targets.count(stmt.m_src0.m_asString) == 0);
+                if (!dead) reachable = true;
+            }
+            else if (!reachable)
+            {
+                dead = true;
+            }
+            else if (stmt.m_opcode == IrOpcode::JUMP)
+            {
+                dead = (k + 1 < last) && (stmts[k + 1].m_opcode == IrOpcode::LABEL) && (stmts[k + 1].m_src0.m_asString == stmt.m_src0.m_asString);
+                reachable = dead;
+            }
+            else if (stmt.m_opcode == IrOpcode::RETURN)
+            {
+                reachable = false;
+            }
+            
+            if (dead)
+            {
+                stmts.erase(stmts.begin() + k);
+                last--;
+                changed = true;
+            }
+            else
+            {
+                k++;
+            }
+        }
+    }
+    return last;
+}
+
+} // namespace
+
+// A loop that tests a loop invariant condition is duplicated, one copy for
+// each outcome, and the test moves in front of the loops:
+//   t = <invariant>; IFZ t, else
+//   <loop, branch never taken>
+//   JUMP join
+//   else: <loop, branch always taken>
+//   join:
+// The condition is computed ahead of the loop even when the loop does not
+// run, so only pure computations qualify.
+bool IrOptimizer::loopUnswitching()
+{
+    generateStatements();
+    
+    const auto functions = getFunctions(m_statements);
+    if (functions.empty()) return false;
+    
+    bool changed = false;
+    std::vector<IrTacStmt> result;
+    result.reserve(m_statements.size());
+    result.insert(result.end(), m_statements.begin(), m_statements.begin() + functions.front().first);
+    for (auto it : functions)
+    {
+        std::vector<IrTacStmt> code(m_statements.begin() + it.first, m_statements.begin() + it.second);
+        std::ptrdiff_t frameEnd = getFrameEnd(m_statements, it.first, it.second);
+        
+        bool unswitched = false;
+        for (size_t n = code.size(); n-- > 1;)
+        {
+            IrForLoop loop;
+            if (!matchForLoop(code, n, loop) || loop.m_end - loop.m_init + 1 > MAX_UNSWITCHED_LOOP) continue;
+            
+            std::set<std::string> labels;
+            for (size_t k = loop.m_init; k <= loop.m_end; k++)
+            {
+                if (code[k].m_opcode == IrOpcode::LABEL) labels.insert(code[k].m_src0.m_asString);
+            }
+            if (isLabelReferencedOutside(code, loop.m_init, loop.m_end + 1, labels)) continue;
+            
+            InvariantTest test;
+            if (!InvariantFinder(code, loop).find(test)) continue;
+            const IrTacStmt branch = code[test.m_branch];
+            const size_t offset = test.m_branch - loop.m_init;
+            const size_t bodyBegin = loop.bodyBegin() - loop.m_init;
+            const size_t bodyEnd = loop.bodyEnd() - loop.m_init;
+            
+            std::vector<IrTacStmt> unswitchedLoop;
+            std::vector<IrTacStmt> slice;
+            for (auto k : test.m_slice)
+            {
+                slice.push_back(code[k]);
+            }
+            copyRegion(slice, 0, slice.size(), unswitchedLoop, frameEnd);
+            
+            IrTacStmt hoisted = branch;
+            if (!slice.empty()) hoisted.m_src0 = unswitchedLoop.back().m_dst;
+            hoisted.m_src1.buildLabel(IrIdentifier::CreateLabel()->getIdentifier());
+            unswitchedLoop.push_back(hoisted);
+            
+            // not taken: the branch goes away
+            std::vector<IrTacStmt> notTaken(code.begin() + loop.m_init, code.begin() + loop.m_end + 1);
+            notTaken.erase(notTaken.begin() + offset);
+            removeDeadArms(notTaken, bodyBegin, bodyEnd - 1);
+            
+            // taken: the branch becomes a jump
+            std::vector<IrTacStmt> taken;
+            copyRegion(code, loop.m_init, loop.m_end + 1, taken, frameEnd);
+            IrTacStmt jump(IrOpcode::JUMP, branch.m_lineNo);
+            jump.m_src0 = taken[offset].m_src1;
+            taken[offset] = jump;
+            removeDeadArms(taken, bodyBegin, bodyEnd);
+            
+            IrTacStmt join(IrOpcode::LABEL, branch.m_lineNo);
+            join.m_src0.buildLabel(IrIdentifier::CreateLabel()->getIdentifier());
+            IrTacStmt skip(IrOpcode::JUMP, branch.m_lineNo);
+            skip.m_src0 = join.m_src0;
+            IrTacStmt other(IrOpcode::LABEL, branch.m_lineNo);
+            other.m_src0 = hoisted.m_src1;
+            
+            unswitchedLoop.insert(unswitchedLoop.end(), notTaken.begin(), notTaken.end());
+            unswitchedLoop.push_back(skip);
+            unswitchedLoop.push_back(other);
+            unswitchedLoop.insert(unswitchedLoop.end(), taken.begin(), taken.end());
+            unswitchedLoop.push_back(join);
+            
+            code.erase(code.begin() + loop.m_init, code.begin() + loop.m_end + 1);
+            code.insert(code.begin() + loop.m_init, unswitchedLoop.begin(), unswitchedLoop.end());
+            unswitched = true;
+        }
+        
+        if (unswitched)
+        {
+            code.front().m_info = std::max(code.front().m_info, alignFrameSize(frameEnd));
+            changed = true;
+        }
+        result.insert(result.end(), code.begin(), code.end());
+    }
+    
+    if (changed)
+    {
+        m_statements.swap(result);
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
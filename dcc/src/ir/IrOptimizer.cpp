@@ -23,7 +23,10 @@
 //
 #include <cstring>
 #include <cassert>
+#include <iomanip>
 #include "IrOptimizer.h"
+#include "IrBlockFrequency.h"
+#include "IrFlowGraph.h"
 
 namespace Decaf
 {
@@ -65,6 +68,7 @@ void IrOptimizer::generateBasicBlocks(const std::vector<IrTacStmt>& statements)
     m_controlFlowGraphExits.clear();
     
     const size_t N = m_blocks.size();
+    delete[] m_blockAdjacencyMat;
     m_blockAdjacencyMat = new unsigned char[N*N];
     memset(m_blockAdjacencyMat, 0, sizeof(unsigned char) * N * N);
     size_t n = 0;
@@ -152,20 +156,40 @@ void IrOptimizer::generateBasicBlocks(const std::vector<IrTacStmt>& statements)
     }
 }
 
-void IrOptimizer::basicBlocksOptimizations(IrBasicBlockOpts which)
+bool IrOptimizer::basicBlocksOptimizations(IrBasicBlockOpts which)
 {    
+    // the front end keeps a temporary in one block, but the global passes
+    // (load forwarding, unrolling, ...) may carry one into others
+    std::unordered_map<std::string, IrBasicBlock*> tempBlock;
+    std::unordered_set<std::string> sharedTemps;
     for (auto it : m_blocks)
     {
-        it->optimize(which);
+        for (const auto& stmt : it->getStatements())
+        {
+            for (auto arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+            {
+                if (!isTempIdentifier(*arg)) continue;
+                auto ib = tempBlock.emplace(arg->m_asString, it.get()).first;
+                if (ib->second != it.get()) sharedTemps.insert(arg->m_asString);
+            }
+        }
+    }
+    
+    bool changed = false;
+    for (auto it : m_blocks)
+    {
+        if (it->optimize(which, sharedTemps)) changed = true;
     }        
+    return changed;
 }
 
-void IrOptimizer::globalCommonSubexpressionElimination()
+bool IrOptimizer::globalCommonSubexpressionElimination()
 {
     for (auto ig : m_controlFlowGraphRoots)
     {
         generateExpressions(ig);  
     }
+    return pureCallElimination();
 }
 
 int IrOptimizer::getValueNumber(const std::string& ident, std::unordered_map<std::string, int>& variable_value_map)
@@ -237,6 +261,17 @@ void IrOptimizer::generateExpressions(unsigned int root)
     std::cout << "Total expressions: " << expression_value_map.size() << std::endl;
 }
 
+const IrCallSummary& IrOptimizer::getCallSummary()
+{
+    if (!m_callSummary) m_callSummary.reset(new IrCallSummary(m_statements));
+    return *m_callSummary;
+}
+
+void IrOptimizer::invalidateAnalyses()
+{
+    m_callSummary.reset();
+}
+
 void IrOptimizer::generateStatements()
 {
     m_statements.clear();
@@ -282,11 +317,47 @@ bool IrOptimizer::isLeader(const IrTacStmt& stmt)
 
 void IrOptimizer::print(std::ostream& stream)
 {
+    // estimated frequency, loop depth and taken probability of the branch
+    // ending the block, by statement
+    generateStatements();
+    std::vector<double> frequency(m_statements.size(), -1.0);
+    std::vector<int> depth(m_statements.size(), 0);
+    std::vector<double> taken(m_statements.size(), -1.0);
+    for (auto function : getFunctions(m_statements))
+    {
+        const IrFlowGraph graph(m_statements, function.first, function.second);
+        const IrBlockFrequency estimate(m_statements, graph);
+        for (size_t b = 0; b < graph.size(); b++)
+        {
+            for (size_t k = graph[b].m_first; k < graph[b].m_last; k++)
+            {
+                frequency[k] = estimate.getFrequency(b);
+                depth[k] = estimate.getLoopDepth(b);
+            }
+            if (graph[b].m_succs.size() == 2)
+                taken[graph[b].m_last - 1] = estimate.getEdgeProbability(b, graph[b].m_succs[1]);
+        }
+    }
+    
     size_t n = 0;
+    size_t k = 0;
+    const std::ios_base::fmtflags flags = stream.flags();
+    const std::streamsize precision = stream.precision();
     stream << "---------------------------" << std::endl;
     for (auto it : m_blocks)
     {
-        stream << "Block[" << n << "]:  NumStatements: " << it->getStatements().size() << std::endl;
+        const size_t size = it->getStatements().size();
+        stream << "Block[" << n << "]:  NumStatements: " << size;
+        const size_t last = k + size - 1;
+        if (size > 0 && frequency[last] >= 0.0)
+        {
+            stream << std::fixed << std::setprecision(3) << "  Frequency: " << frequency[last] << "  LoopDepth: " << depth[last];
+            if (taken[last] >= 0.0) stream << "  Taken: " << taken[last];
+            stream.flags(flags);
+            stream.precision(precision);
+        }
+        stream << std::endl;
+        k += size;
         it->print(stream);
         stream << "---------------------------" << std::endl;
         n++;
@@ -28,6 +28,7 @@
 #include <list>
 #include "IrCommon.h"
 #include "IrBasicBlock.h"
+#include "IrCallSummary.h"
 #include "IrTAC.h"
 
 namespace Decaf
@@ -42,7 +43,10 @@ public:
         m_statements(),
         m_blockAdjacencyMat(nullptr),
         m_controlFlowGraphRoots(),
-        m_controlFlowGraphExits()
+        m_controlFlowGraphExits(),
+        m_outlinedLoops(0),
+        m_specializedMethods(0),
+        m_callSummary()
     {}
     
     virtual ~IrOptimizer() 
@@ -51,12 +55,40 @@ public:
     }
    
     void generateBasicBlocks(const std::vector<IrTacStmt>& statements);
-    void basicBlocksOptimizations(IrBasicBlockOpts which);
-    void globalCommonSubexpressionElimination();
+    bool basicBlocksOptimizations(IrBasicBlockOpts which);
+    bool globalCommonSubexpressionElimination();
+    bool pureCallElimination();
+    bool scalarReplacement();
+    bool constantPropagation();
+    bool simplifyControlFlow();
+    bool loadStoreElimination();
+    bool partialRedundancyElimination();
+    bool copyPropagation();
+    bool deadCodeElimination();
+    bool ifConversion();
+    bool blockLayout();
+    bool removeDeadDeclarations(std::vector<std::string>& deadMethods, std::vector<std::string>& deadGlobals);
+    bool scheduleInstructions(bool allocated);
+    bool assignTemporarySlots();
+    bool interproceduralConstants(int cloneBudget);
+    bool loopFusion();
+    bool loopUnswitching();
+    bool loopUnrolling(int factor);
+    bool parallelizeLoops();
+    bool lowerParallelLoops();
+    bool instrumentProfile(const std::string& filename);
+    bool applyProfile(const std::string& filename);
+    bool applySampleProfile(const std::string& filename);
     void generateStatements();
     
     const std::vector<IrTacStmt>& getOptimizedStatements() const { return m_statements; }
     
+    // Side effects of the methods, built from the current statements on first
+    // use and kept until invalidateAnalyses; passes that only remove or move
+    // code within methods leave it valid (see IrPassManager).
+    const IrCallSummary& getCallSummary();
+    void invalidateAnalyses();
+    
     void print(std::ostream& stream = std::cout);
     
 protected:
@@ -82,6 +114,14 @@ protected:
         
     int m_next_value_number;
     
+    // loop bodies outlined into functions of their own
+    int m_outlinedLoops;
+    
+    // copies of methods specialized for constant arguments
+    int m_specializedMethods;
+    
+    std::unique_ptr<IrCallSummary> m_callSummary;
+    
 private:
     IrOptimizer(const IrOptimizer& rhs) = delete;
 };
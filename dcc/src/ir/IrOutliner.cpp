@@ -0,0 +1,373 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include "IrOutliner.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Shortest sequence worth a call.
+const size_t MIN_SEQUENCE = 2;
+const size_t CALL_BYTES = 5;
+const size_t RET_BYTES = 1;
+
+std::string trim(const std::string& line)
+{
+    const size_t first = line.find_first_not_of(" \t");
+    if (first == std::string::npos) return "";
+    const size_t last = line.find_last_not_of(" \t\r");
+    return line.substr(first, last - first + 1);
+}
+
+std::string getMnemonic(const std::string& insn)
+{
+    return insn.substr(0, insn.find(' '));
+}
+
+// Operands of an instruction, split at the commas outside parentheses.
+std::vector<std::string> getOperands(const std::string& insn)
+{
+    std::vector<std::string> operands;
+    const size_t space = insn.find(' ');
+    if (space == std::string::npos) return operands;
+    
+    std::string current;
+    int depth = 0;
+    for (size_t k = space + 1; k < insn.size(); k++)
+    {
+        const char c = insn[k];
+        if (c == '(') depth++;
+        if (c == ')') depth--;
+        if (c == ',' && depth == 0)
+        {
+            operands.push_back(trim(current));
+            current.clear();
+        }
+        else
+        {
+            current += c;
+        }
+    }
+    operands.push_back(trim(current));
+    return operands;
+}
+
+bool fitsByte(const std::string& number)
+{
+    char* end = nullptr;
+    const long value = std::strtol(number.c_str(), &end, 10);
+    return (end != number.c_str()) && (*end == '\0') && (value >= -128) && (value <= 127);
+}
+
+// Approximate x86-64 encoding size of an AT&T syntax instruction: prefixes,
+// opcode, ModRM and SIB, displacement and immediate.
+size_t estimateSize(const std::string& insn)
+{
+    const std::string mnemonic = getMnemonic(insn);
+    if (mnemonic == "ret" || mnemonic == "leave") return 1;
+    if (mnemonic == "cqto") return 2;
+    if (mnemonic == "enter") return 4;
+    if (mnemonic == "call" || mnemonic == "jmp") return 5;
+    if (mnemonic[0] == 'j') return 6;
+    if (mnemonic == "movabsq") return 10;
+    
+    const bool isSse = (mnemonic.find("sd") != std::string::npos) || (mnemonic.compare(0, 3, "cvt") == 0) ||
+                       (mnemonic.compare(0, 5, "ucomi") == 0);
+    size_t size = 2;
+    if (isSse)
+        size += 2;
+    else if (mnemonic.compare(0, 3, "set") == 0 || mnemonic.compare(0, 4, "cmov") == 0 || mnemonic.compare(0, 4, "movz") == 0)
+        size += 1;
+    if ((!isSse && mnemonic.back() == 'q') || insn.find("%r") != std::string::npos) size += 1;
+    
+    for (const auto& operand : getOperands(insn))
+    {
+        if (operand.empty() || operand[0] == '%') continue;
+        if (operand[0] == '$')
+        {
+            const bool small = fitsByte(operand.substr(1)) && (mnemonic.compare(0, 3, "mov") != 0);
+            size += small ? 1 : 4;
+            continue;
+        }
+        const size_t paren = operand.find('(');
+        if (paren == std::string::npos || operand.find("(%rip)") != std::string::npos || operand[0] == '.')
+        {
+            size += 4;
+        }
+        else if (paren > 0)
+        {
+            size += fitsByte(operand.substr(0, paren)) ? 1 : 4;
+        }
+        if (paren != std::string::npos && operand.find(',', paren) != std::string::npos) size += 1;
+    }
+    return size;
+}
+
+// Instructions that behave the same called: no control flow and nothing that
+// touches the stack the return address goes on.
+bool isOutlinable(const std::string& insn)
+{
+    if (insn.empty() || insn[0] == '.' || insn.back() == ':') return false;
+    
+    const std::string mnemonic = getMnemonic(insn);
+    if (mnemonic[0] == 'j' || mnemonic == "call" || mnemonic == "ret" || mnemonic == "enter" || mnemonic == "leave" ||
+        mnemonic.compare(0, 4, "push") == 0 || mnemonic.compare(0, 3, "pop") == 0)
+        return false;
+    return (insn.find("%rsp") == std::string::npos) && (insn.find("%esp") == std::string::npos);
+}
+
+// Suffix array by prefix doubling.
+std::vector<size_t> buildSuffixArray(const std::vector<int>& text)
+{
+    const size_t N = text.size();
+    std::vector<size_t> suffixes(N);
+    std::iota(suffixes.begin(), suffixes.end(), 0);
+    std::vector<long> rank(text.begin(), text.end());
+    std::vector<long> next(N);
+    for (size_t k = 1; N > 0; k *= 2)
+    {
+        auto before = [&](size_t a, size_t b)
+        {
+            if (rank[a] != rank[b]) return rank[a] < rank[b];
+            const long ra = (a + k < N) ? rank[a + k] : -1;
+            const long rb = (b + k < N) ? rank[b + k] : -1;
+            return ra < rb;
+        };
+        std::sort(suffixes.begin(), suffixes.end(), before);
+        next[suffixes[0]] = 0;
+        for (size_t i = 1; i < N; i++)
+        {
+            next[suffixes[i]] = next[suffixes[i - 1]] + (before(suffixes[i - 1], suffixes[i]) ? 1 : 0);
+        }
+        rank.swap(next);
+        if (rank[suffixes[N - 1]] == (long)N - 1) break;
+    }
+    return suffixes;
+}
+
+// Common prefix of each suffix with the one before it (Kasai et al.).
+std::vector<size_t> buildLcp(const std::vector<int>& text, const std::vector<size_t>& suffixes)
+{
+    const size_t N = text.size();
+    std::vector<size_t> rank(N);
+    for (size_t i = 0; i < N; i++)
+    {
+        rank[suffixes[i]] = i;
+    }
+    std::vector<size_t> lcp(N, 0);
+    size_t h = 0;
+    for (size_t i = 0; i < N; i++)
+    {
+        if (rank[i] == 0)
+        {
+            h = 0;
+            continue;
+        }
+        const size_t j = suffixes[rank[i] - 1];
+        while (i + h < N && j + h < N && text[i + h] == text[j + h])
+        {
+            h++;
+        }
+        lcp[rank[i]] = h;
+        if (h > 0) h--;
+    }
+    return lcp;
+}
+
+struct Candidate
+{
+    size_t m_length;
+    std::vector<size_t> m_starts;
+    size_t m_benefit;
+};
+
+} // namespace
+
+IrOutliner::IrOutliner(const std::string& assembly) :
+    m_lines(),
+    m_ids(),
+    m_bytes(),
+    m_calls(),
+    m_functions(),
+    m_numSequences(0),
+    m_originalSize(0),
+    m_size(0)
+{
+    std::istringstream stream(assembly);
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        m_lines.push_back(line);
+    }
+    
+    // only the main text section is outlined, not the cold paths pushed to
+    // .text.unlikely or anything after a .section
+    std::map<std::string, int> ids;
+    bool inText = false;
+    int pushed = 0;
+    for (const auto& it : m_lines)
+    {
+        const std::string insn = trim(it);
+        int id = -1;
+        if (insn == ".text") inText = true;
+        else if (insn.compare(0, 9, ".section ") == 0) inText = (trim(insn.substr(9)) == ".text");
+        else if (insn.compare(0, 12, ".pushsection") == 0) pushed++;
+        else if (insn.compare(0, 11, ".popsection") == 0) pushed--;
+        else if (inText && pushed == 0 && isOutlinable(insn)) id = ids.emplace(insn, (int)ids.size()).first->second;
+        
+        const bool isCode = !insn.empty() && insn[0] != '.' && insn.back() != ':';
+        m_ids.push_back(id);
+        m_bytes.push_back(isCode ? estimateSize(insn) : 0);
+    }
+    m_calls.assign(m_lines.size(), -1);
+    m_originalSize = std::accumulate(m_bytes.begin(), m_bytes.end(), (size_t)0);
+    m_size = m_originalSize;
+}
+
+bool IrOutliner::run()
+{
+    // lines that cannot be outlined get symbols of their own, so no repeat
+    // spans them
+    const size_t N = m_ids.size();
+    if (N == 0) return false;
+    std::vector<int> text(m_ids);
+    int unique = (int)N;
+    for (auto& it : text)
+    {
+        if (it < 0) it = unique++;
+    }
+    
+    const std::vector<size_t> suffixes = buildSuffixArray(text);
+    const std::vector<size_t> lcp = buildLcp(text, suffixes);
+    std::vector<size_t> prefix(N + 1, 0);
+    for (size_t i = 0; i < N; i++)
+    {
+        prefix[i + 1] = prefix[i] + m_bytes[i];
+    }
+    
+    // repeats that do not overlap themselves and the bytes outlining them saves
+    auto evaluate = [&](Candidate& candidate, const std::vector<bool>& taken)
+    {
+        std::vector<size_t> starts;
+        for (auto start : candidate.m_starts)
+        {
+            if (!starts.empty() && start < starts.back() + candidate.m_length) continue;
+            if (std::any_of(taken.begin() + start, taken.begin() + start + candidate.m_length, [](bool t) { return t; })) continue;
+            starts.push_back(start);
+        }
+        candidate.m_starts.swap(starts);
+        
+        const size_t bytes = prefix[candidate.m_starts.empty() ? 0 : candidate.m_starts[0] + candidate.m_length] -
+                             prefix[candidate.m_starts.empty() ? 0 : candidate.m_starts[0]];
+        const size_t count = candidate.m_starts.size();
+        const size_t before = count * bytes;
+        const size_t after = count * CALL_BYTES + bytes + RET_BYTES;
+        candidate.m_benefit = (count >= 2 && before > after) ? before - after : 0;
+    };
+    
+    // internal nodes of the suffix tree, as the lcp intervals of the suffix
+    // array (Abouelhoda, Kurtz and Ohlebusch)
+    const std::vector<bool> none(N, false);
+    std::vector<Candidate> candidates;
+    std::vector<std::pair<size_t, size_t>> stack(1, std::make_pair((size_t)0, (size_t)0));
+    for (size_t i = 1; i <= N; i++)
+    {
+        const size_t depth = (i < N) ? lcp[i] : 0;
+        size_t left = i - 1;
+        while (depth < stack.back().first)
+        {
+            const auto node = stack.back();
+            stack.pop_back();
+            left = node.second;
+            if (node.first >= MIN_SEQUENCE)
+            {
+                Candidate candidate;
+                candidate.m_length = node.first;
+                candidate.m_starts.assign(suffixes.begin() + node.second, suffixes.begin() + i);
+                std::sort(candidate.m_starts.begin(), candidate.m_starts.end());
+                evaluate(candidate, none);
+                if (candidate.m_benefit > 0) candidates.push_back(candidate);
+            }
+        }
+        if (depth > stack.back().first) stack.push_back(std::make_pair(depth, left));
+    }
+    
+    // most profitable first, each time without the lines already outlined
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.m_benefit > b.m_benefit; });
+    std::vector<bool> taken(N, false);
+    for (auto& candidate : candidates)
+    {
+        evaluate(candidate, taken);
+        if (candidate.m_benefit == 0) continue;
+        
+        const int function = (int)m_functions.size();
+        m_functions.push_back(Function{candidate.m_starts[0], candidate.m_length});
+        for (auto start : candidate.m_starts)
+        {
+            m_calls[start] = function;
+            std::fill(taken.begin() + start, taken.begin() + start + candidate.m_length, true);
+        }
+        m_numSequences += (int)candidate.m_starts.size();
+        m_size -= candidate.m_benefit;
+    }
+    return !m_functions.empty();
+}
+
+void IrOutliner::write(std::ostream& stream) const
+{
+    for (size_t n = 0; n < m_lines.size(); )
+    {
+        if (m_calls[n] >= 0)
+        {
+            stream << "call .OUTLINED" << m_calls[n] << std::endl;
+            n += m_functions[m_calls[n]].m_length;
+        }
+        else
+        {
+            stream << m_lines[n] << std::endl;
+            n++;
+        }
+    }
+    
+    if (m_functions.empty()) return;
+    stream << ".text" << std::endl;
+    for (size_t f = 0; f < m_functions.size(); f++)
+    {
+        stream << ".OUTLINED" << f << ":" << std::endl;
+        for (size_t n = m_functions[f].m_first; n < m_functions[f].m_first + m_functions[f].m_length; n++)
+        {
+            stream << m_lines[n] << std::endl;
+        }
+        stream << "ret" << std::endl;
+    }
+}
+
+} // namespace Decaf
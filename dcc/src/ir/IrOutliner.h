@@ -0,0 +1,69 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace Decaf
+{
+
+// Machine outliner for code size.  Instruction sequences that repeat in the
+// generated assembly of a module become functions of their own, called from
+// every place they occurred.  Repeats are the internal nodes of the suffix
+// tree over the instruction stream, taken in order of the bytes they save.
+class IrOutliner
+{
+public:
+    explicit IrOutliner(const std::string& assembly);
+    
+    bool run();
+    void write(std::ostream& stream) const;
+    
+    int getNumSequences() const { return m_numSequences; }
+    int getNumFunctions() const { return (int)m_functions.size(); }
+    // Estimated bytes of code before and after outlining.
+    size_t getOriginalSize() const { return m_originalSize; }
+    size_t getSize() const { return m_size; }
+    
+private:
+    struct Function
+    {
+        size_t m_first;
+        size_t m_length;
+    };
+    
+    std::vector<std::string> m_lines;
+    // per line, the instruction's id or -1 when it cannot be outlined
+    std::vector<int> m_ids;
+    std::vector<size_t> m_bytes;
+    // per line, the function replacing the sequence that starts there or -1
+    std::vector<int> m_calls;
+    std::vector<Function> m_functions;
+    int m_numSequences;
+    size_t m_originalSize;
+    size_t m_size;
+};
+
+} // namespace Decaf
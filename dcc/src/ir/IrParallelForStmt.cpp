@@ -0,0 +1,148 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <iostream>
+#include <sstream>
+#include "IrCommon.h"
+#include "IrParallelForStmt.h"
+#include "IrIdentifier.h"
+#include "IrAssignExpr.h"
+#include "IrBooleanExpr.h"
+#include "IrIntLiteral.h"
+#include "IrLocation.h"
+#include "IrTravCtx.h"
+
+namespace Decaf
+{
+// Template:
+//
+// PARFOR <runtime entry>
+// <for loop>
+//
+// IrOptimizer::lowerParallelLoops() outlines the loop body and replaces the
+// loop with a call to the runtime entry.
+
+IrParallelForStatement::IrParallelForStatement(int lineNumber, int columnNumber, const std::string& filename, IrIdentifierPtr schedule,
+        IrExpressionPtr initialExpr, IrExpressionPtr endExpr, IrExpressionPtr loopExpr, IrStatementPtr block) :
+    IrForStatement(lineNumber, columnNumber, filename, initialExpr, endExpr, loopExpr, block),
+    m_schedule(schedule),
+    m_dynamic(false),
+    m_outerScopes(0)
+{
+}
+
+IrParallelForStatement::~IrParallelForStatement()
+{
+}
+
+void IrParallelForStatement::print(unsigned int depth)
+{
+    IRPRINT_INDENT(depth);
+    std::cout << "Parallel For(" << getLineNumber() << "," << getColumnNumber() << ")" << std::endl;
+    if (m_schedule)
+    {
+        IRPRINT_INDENT(depth+1);
+        std::cout << "Schedule: " << m_schedule->getIdentifier() << std::endl;
+    }
+    
+    if (m_initialExpr) m_initialExpr->print(depth+1);
+    m_terminatingExpr->print(depth+1);
+    if (m_loopExpr) m_loopExpr->print(depth+1);
+    
+    if (m_body) m_body->print(depth+1);
+}
+
+bool IrParallelForStatement::isCounter(const IrExpressionPtr& expr) const
+{
+    const IrAssignExpression* init = dynamic_cast<const IrAssignExpression*>(m_initialExpr.get());
+    if (init == nullptr) return false;
+    
+    const IrLocation* counter = dynamic_cast<const IrLocation*>(init->getLeftHandSide().get());
+    const IrLocation* location = dynamic_cast<const IrLocation*>(expr.get());
+    if (counter == nullptr || location == nullptr) return false;
+    if (counter->getIndex() || location->getIndex()) return false;
+    
+    return (counter->getIdentifier()->getIdentifier() == location->getIdentifier()->getIdentifier());
+}
+
+bool IrParallelForStatement::analyze(IrTraversalContext* ctx)
+{
+    m_outerScopes = ctx->getNumSymbols();
+    
+    bool valid = IrForStatement::analyze(ctx);
+    
+    if (m_schedule)
+    {
+        if (m_schedule->getIdentifier() == "dynamic")
+        {
+            m_dynamic = true;
+        }
+        else if (m_schedule->getIdentifier() != "static")
+        {
+            std::stringstream msg;
+            msg << "unknown parallel for schedule '" << m_schedule->getIdentifier() << "'.  Expected static or dynamic.";
+            ctx->error(this, msg.str());
+            valid = false;
+        }
+    }
+    
+    // Rule: the loop must run a counter over [lo, hi) in steps of one.
+    const IrAssignExpression* init = dynamic_cast<const IrAssignExpression*>(m_initialExpr.get());
+    const IrBooleanExpression* test = dynamic_cast<const IrBooleanExpression*>(m_terminatingExpr.get());
+    const IrAssignExpression* step = dynamic_cast<const IrAssignExpression*>(m_loopExpr.get());
+    const IrIntegerLiteral* one = step ? dynamic_cast<const IrIntegerLiteral*>(step->getRightHandSide().get()) : nullptr;
+    
+    bool wellFormed = (init && init->getOperator() == IrAssignmentOperator::Assign && isCounter(init->getLeftHandSide()));
+    wellFormed = wellFormed && (test && test->getOperator() == IrBooleanOperator::Less && isCounter(test->getLeftHandSide()));
+    wellFormed = wellFormed && (step && step->getOperator() == IrAssignmentOperator::IncrementAssign && isCounter(step->getLeftHandSide()));
+    wellFormed = wellFormed && (one && one->getValue() == 1);
+    if (!wellFormed)
+    {
+        ctx->error(this, "parallel for loop must have the form 'for (i = <low>; i < <high>; i += 1)'.");
+        valid = false;
+    }
+    
+    return valid;
+}
+
+bool IrParallelForStatement::codegen(IrTraversalContext* ctx)
+{
+    IrTacStmt marker(IrOpcode::PARFOR, getLineNumber());
+    marker.m_src0.buildLabel(m_dynamic ? "dcc_parallel_for" : "dcc_parallel_for_static");
+    ctx->append(marker);
+    
+    return IrForStatement::codegen(ctx);
+}
+
+const IrParallelForStatement* IrParallelForStatement::FindEnclosing(const IrTraversalContext* ctx)
+{
+    for (size_t i = 1; i < ctx->getNumParents(); i++)
+    {
+        const IrParallelForStatement* loop = dynamic_cast<const IrParallelForStatement*>(ctx->getParent(i));
+        if (loop && loop->isBody(ctx->getParent(i-1)))
+            return loop;
+    }
+    return nullptr;
+}
+
+} // namespace Decaf
@@ -0,0 +1,72 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+#include <memory>
+#include "IrCommon.h"
+#include "IrForStmt.h"
+
+namespace Decaf
+{
+
+// parallel [(static|dynamic)] for (i = lo; i < hi; i += 1) body
+//
+// Iterations run on the runtime thread pool.  Static scheduling gives each
+// thread one contiguous block of iterations, dynamic scheduling hands out
+// chunks and lets idle threads steal.
+class IrParallelForStatement : public IrForStatement
+{
+public:
+    IrParallelForStatement(int lineNumber, int columnNumber, const std::string& filename, IrIdentifierPtr schedule,
+        IrExpressionPtr initialExpr, IrExpressionPtr endExpr, IrExpressionPtr loopExpr, IrStatementPtr block = nullptr);
+    
+    virtual ~IrParallelForStatement();
+    
+    virtual void print(unsigned int depth);
+    virtual bool analyze(IrTraversalContext* ctx);
+    virtual bool codegen(IrTraversalContext* ctx);
+    virtual const std::string& asString() const { return m_parallelFor; }
+    
+    bool isBody(const IrBase* node) const { return node == m_body.get(); }
+    
+    // Number of scopes visible outside the loop body.
+    size_t getOuterScopes() const { return m_outerScopes; }
+    
+    // Innermost parallel for whose body contains the node being traversed.
+    static const IrParallelForStatement* FindEnclosing(const IrTraversalContext* ctx);
+    
+protected:
+    
+    bool isCounter(const IrExpressionPtr& expr) const;
+    
+    IrIdentifierPtr m_schedule;
+    bool m_dynamic;
+    size_t m_outerScopes;
+    
+    const std::string m_parallelFor = "parallel for";
+private:
+    IrParallelForStatement() = delete;
+    IrParallelForStatement(const IrParallelForStatement& rhs) = delete;
+};
+
+} // namespace Decaf
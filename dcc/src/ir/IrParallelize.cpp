@@ -0,0 +1,883 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+#include "IrIdentifier.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Runtime entry (6035.c): dcc_parallel_for(body, lo, hi, arg0, arg1, arg2) runs
+// body(first, last, arg0, arg1, arg2) over chunks [first, last) of [lo, hi).
+// dcc_parallel_for_static takes the same arguments.
+const char* const PARALLEL_FOR_ENTRY = "dcc_parallel_for";
+const size_t MAX_PARALLEL_ARGS = 3;
+
+// Loops with a known trip count and less work than this stay serial.
+const long MIN_PARALLEL_WORK = 4096;
+
+// Values taken by a loop counter, as affine functions of loop invariants.
+struct CounterRange
+{
+    std::string m_counter;
+    IrForLoop m_loop;
+    IrAffineExpr m_lo;
+    IrAffineExpr m_hi;
+};
+
+IrTacStmt makeTac(IrOpcode opcode, int lineNo, const IrTacArg& src0, const IrTacArg& src1 = IrTacArg(), const IrTacArg& dst = IrTacArg())
+{
+    IrTacStmt stmt(opcode, lineNo);
+    stmt.m_src0 = src0;
+    stmt.m_src1 = src1;
+    stmt.m_dst = dst;
+    return stmt;
+}
+
+IrTacArg makeLabel(const std::string& name)
+{
+    IrTacArg label;
+    label.buildLabel(name);
+    return label;
+}
+
+IrTacArg makeInteger(long value)
+{
+    IrTacArg literal;
+    literal.buildInteger(value);
+    return literal;
+}
+
+IrTacArg makeSlot(std::ptrdiff_t address)
+{
+    IrTacArg temp;
+    temp.buildTemporary(IrIdentifier::CreateTemporary()->getIdentifier(), address);
+    return temp;
+}
+
+// Positive constant step of a single 'ADD $k, i, i' statement, or 0.
+long counterIncrement(const std::vector<IrTacStmt>& stmts, const IrForLoop& loop)
+{
+    if (loop.m_continue + 2 != loop.m_jump) return 0;
+    
+    const IrTacStmt& step = stmts[loop.m_continue + 1];
+    const std::string counter = getOperandKey(stmts[loop.m_init].m_dst);
+    if (step.m_opcode != IrOpcode::ADD || getOperandKey(step.m_dst) != counter) return 0;
+    
+    const IrTacArg* amount = nullptr;
+    if (step.m_src1.isMemory() && getOperandKey(step.m_src1) == counter)
+        amount = &step.m_src0;
+    else if (step.m_src0.isMemory() && getOperandKey(step.m_src0) == counter)
+        amount = &step.m_src1;
+    if (amount == nullptr || !isIntLiteral(*amount) || amount->m_value.m_int <= 0) return 0;
+    
+    return amount->m_value.m_int;
+}
+
+// Bound of a loop tested as 'LESS i, bound' right before the IFZ, or nullptr.
+// The rest of the condition may only compute temporaries without the counter.
+const IrTacArg* counterBound(const std::vector<IrTacStmt>& stmts, const IrForLoop& loop)
+{
+    if (loop.m_test < loop.top() + 2) return nullptr;
+    
+    const std::string counter = getOperandKey(stmts[loop.m_init].m_dst);
+    const IrTacStmt& less = stmts[loop.m_test - 1];
+    if (less.m_opcode != IrOpcode::LESS || !less.m_src0.isMemory() || getOperandKey(less.m_src0) != counter) return nullptr;
+    if (!less.m_dst.isMemory() || getOperandKey(less.m_dst) != getOperandKey(stmts[loop.m_test].m_src0)) return nullptr;
+    
+    std::vector<const IrTacArg*> used;
+    for (size_t k = loop.top() + 1; k < loop.m_test - 1; k++)
+    {
+        const IrTacArg* def = getDefinedVariable(stmts[k]);
+        if (def == nullptr || !isCompilerTemporary(*def)) return nullptr;
+        getUsedVariables(stmts[k], used);
+        for (auto it : used)
+        {
+            if (getOperandKey(*it) == counter) return nullptr;
+        }
+    }
+    return &less.m_src1;
+}
+
+// Dependence analysis and outlining of one candidate loop.
+//
+// Iterations are independent when the body makes no calls, every scalar it
+// writes is assigned before use in each iteration (and dead after the loop),
+// and every array written is accessed at c*i + f, where f stays within a
+// window narrower than c.  Window and bounds conditions that depend on
+// run time values become checks guarding the parallel call, with the
+// original loop kept as the fallback.
+class ParallelLoop
+{
+public:
+    ParallelLoop(const std::vector<IrTacStmt>& stmts, const IrForLoop& loop, size_t functionBegin, size_t functionEnd) :
+        m_stmts(stmts),
+        m_loop(loop),
+        m_functionBegin(functionBegin),
+        m_functionEnd(functionEnd),
+        m_counter(getOperandKey(stmts[loop.m_init].m_dst)),
+        m_bound(nullptr),
+        m_race()
+    {}
+    
+    bool analyze();
+    // Loops marked by 'parallel for' only need a shape the outliner handles.
+    bool analyzeMarked();
+    // Why a marked loop was rejected, when that is a race rather than its shape.
+    const std::string& getRace() const { return m_race; }
+    
+    // Emit the replacement for the loop and its outlined body; returns the
+    // frame size both need.
+    int outline(const std::string& name, const std::string& entry, std::ptrdiff_t frameEnd, 
+                std::vector<IrTacStmt>& replacement, std::vector<IrTacStmt>& function) const;
+    
+private:
+    bool hasPrivateCounter() const;
+    bool isInvariant(const IrTacArg& arg) const;
+    const CounterRange* findRange(const std::string& counter, size_t position) const;
+    
+    bool summarizeBody(bool marked);
+    bool findCounters();
+    bool checkScalars() const;
+    bool isLiveAfterLoop() const;
+    bool checkArrays();
+    bool addCheck(const IrAffineExpr& expr);
+    
+    void emitCheck(const std::map<std::string, long>& terms, long constant, const IrTacArg& acc, const IrTacArg& product,
+                   const IrTacArg& test, const IrTacArg& fail, std::vector<IrTacStmt>& code) const;
+    
+    const std::vector<IrTacStmt>& m_stmts;
+    IrForLoop m_loop;
+    size_t m_functionBegin;
+    size_t m_functionEnd;
+    std::string m_counter;
+    const IrTacArg* m_bound;
+    std::string m_race;
+    
+    std::set<std::string> m_writes;
+    std::set<std::string> m_labels;
+    std::vector<CounterRange> m_ranges;
+    // loop invariant locals handed to the outlined body
+    std::map<std::string, IrTacArg> m_arguments;
+    // user variables by key, to materialize run time checks
+    std::map<std::string, IrTacArg> m_variables;
+    // run time checks: sum(terms) + constant <= 0
+    std::map<std::map<std::string, long>, long> m_checks;
+};
+
+// Each worker steps its own copy of a local counter; a global one would be
+// stepped by all of them at once.
+bool ParallelLoop::hasPrivateCounter() const
+{
+    return m_stmts[m_loop.m_init].m_dst.m_usage == IrUsage::Identifier;
+}
+
+bool ParallelLoop::isInvariant(const IrTacArg& arg) const
+{
+    if (!isUserVariable(arg)) return false;
+    const std::string key = getOperandKey(arg);
+    return (key != m_counter) && (m_writes.count(key) == 0);
+}
+
+const CounterRange* ParallelLoop::findRange(const std::string& counter, size_t position) const
+{
+    const CounterRange* found = nullptr;
+    for (auto& it : m_ranges)
+    {
+        if (it.m_counter == counter && it.m_loop.top() < position && position < it.m_loop.m_jump)
+        {
+            if (found) return nullptr;
+            found = &it;
+        }
+    }
+    return found;
+}
+
+bool ParallelLoop::analyze()
+{
+    if (!hasPrivateCounter() || counterIncrement(m_stmts, m_loop) != 1) return false;
+    m_bound = counterBound(m_stmts, m_loop);
+    if (m_bound == nullptr) return false;
+    
+    if (!summarizeBody(false)) return false;
+    if (!findCounters()) return false;
+    
+    // skip loops known to do too little work to pay for the dispatch
+    const CounterRange& outer = m_ranges.front();
+    if (outer.m_lo.isConstant() && outer.m_hi.isConstant())
+    {
+        const long trips = outer.m_hi.m_constant - outer.m_lo.m_constant + 1;
+        const long size = (long)(m_loop.bodyEnd() - m_loop.bodyBegin());
+        if (trips * size < MIN_PARALLEL_WORK) return false;
+    }
+    
+    return checkScalars() && checkArrays();
+}
+
+bool ParallelLoop::analyzeMarked()
+{
+    if (!hasPrivateCounter())
+    {
+        m_race = "its counter '" + m_stmts[m_loop.m_init].m_dst.m_asString + "' is a global";
+        return false;
+    }
+    if (counterIncrement(m_stmts, m_loop) != 1) return false;
+    m_bound = counterBound(m_stmts, m_loop);
+    
+    return (m_bound != nullptr) && summarizeBody(true);
+}
+
+bool ParallelLoop::summarizeBody(bool marked)
+{
+    const std::string& continueLabel = m_stmts[m_loop.m_continue].m_src0.m_asString;
+    std::vector<const IrTacArg*> used;
+    
+    for (size_t k = m_loop.bodyBegin(); k < m_loop.bodyEnd(); k++)
+    {
+        if (m_stmts[k].m_opcode == IrOpcode::LABEL) m_labels.insert(m_stmts[k].m_src0.m_asString);
+    }
+    
+    for (size_t k = m_loop.bodyBegin(); k < m_loop.bodyEnd(); k++)
+    {
+        const IrTacStmt& stmt = m_stmts[k];
+        switch (stmt.m_opcode)
+        {
+            case IrOpcode::CALL:
+            case IrOpcode::PARAM:
+                if (!marked) return false;
+                break;
+            case IrOpcode::RETURN:
+            case IrOpcode::FBEGIN:
+            case IrOpcode::GETPARAM:
+                return false;
+            default:
+                break;
+        }
+        
+        // only 'continue' may leave the body
+        const IrTacArg* target = getBranchTarget(stmt);
+        if (target && !m_labels.count(target->m_asString) && target->m_asString != continueLabel) return false;
+        
+        const IrTacArg* def = getDefinedVariable(stmt);
+        if (def)
+        {
+            // every iteration would write the one copy of a global
+            if (def->m_usage == IrUsage::Global)
+            {
+                if (marked) m_race = "its iterations race on the global '" + def->m_asString + "'";
+                return false;
+            }
+            m_writes.insert(getOperandKey(*def));
+            if (isUserVariable(*def)) m_variables[getOperandKey(*def)] = *def;
+        }
+        getUsedVariables(stmt, used);
+        for (auto it : used)
+        {
+            if (isUserVariable(*it)) m_variables[getOperandKey(*it)] = *it;
+        }
+    }
+    if (m_writes.count(m_counter)) return false;
+    if (isLabelReferencedOutside(m_stmts, m_loop.bodyBegin(), m_loop.bodyEnd(), m_labels)) return false;
+    
+    for (size_t k = m_loop.top() + 1; k < m_loop.m_test; k++)
+    {
+        getUsedVariables(m_stmts[k], used);
+        for (auto it : used)
+        {
+            if (isUserVariable(*it)) m_variables[getOperandKey(*it)] = *it;
+        }
+    }
+    const IrTacArg& init = m_stmts[m_loop.m_init].m_src0;
+    if (isUserVariable(init)) m_variables[getOperandKey(init)] = init;
+    
+    // invariant locals are copied into the outlined function's frame
+    for (size_t k = m_loop.bodyBegin(); k < m_loop.bodyEnd(); k++)
+    {
+        getUsedVariables(m_stmts[k], used);
+        for (auto it : used)
+        {
+            const std::string key = getOperandKey(*it);
+            if (it->m_usage != IrUsage::Identifier || key == m_counter || m_writes.count(key)) continue;
+            if (isCompilerTemporary(*it) || it->isDouble()) return false;
+            m_arguments[key] = *it;
+        }
+    }
+    return m_arguments.size() <= MAX_PARALLEL_ARGS;
+}
+
+bool ParallelLoop::findCounters()
+{
+    auto isTerm = [this](const IrTacArg& arg) { return isInvariant(arg); };
+    
+    const IrTacStmt& init = m_stmts[m_loop.m_init];
+    CounterRange outer;
+    outer.m_counter = m_counter;
+    outer.m_loop = m_loop;
+    if (!evaluateAffine(m_stmts, m_loop.top() + 1, m_loop.m_test, init.m_src0, isTerm, outer.m_lo)) return false;
+    if (!evaluateAffine(m_stmts, m_loop.top() + 1, m_loop.m_test, *m_bound, isTerm, outer.m_hi)) return false;
+    outer.m_hi.m_constant -= 1;
+    m_ranges.push_back(outer);
+    
+    // counters of nested canonical loops with invariant bounds
+    std::vector<CounterRange> inner;
+    std::map<std::string, std::set<size_t>> updates;
+    for (size_t k = m_loop.bodyBegin(); k < m_loop.bodyEnd(); k++)
+    {
+        IrForLoop loop;
+        if (!matchForLoop(m_stmts, k, loop) || loop.m_end >= m_loop.bodyEnd()) continue;
+        if (counterIncrement(m_stmts, loop) == 0) continue;
+        const IrTacArg* bound = counterBound(m_stmts, loop);
+        if (bound == nullptr) continue;
+        
+        CounterRange range;
+        range.m_counter = getOperandKey(m_stmts[k].m_dst);
+        range.m_loop = loop;
+        if (!evaluateAffine(m_stmts, loop.top() + 1, loop.m_test, m_stmts[k].m_src0, isTerm, range.m_lo)) continue;
+        if (!evaluateAffine(m_stmts, loop.top() + 1, loop.m_test, *bound, isTerm, range.m_hi)) continue;
+        range.m_hi.m_constant -= 1;
+        
+        inner.push_back(range);
+        updates[range.m_counter].insert(loop.m_init);
+        updates[range.m_counter].insert(loop.m_continue + 1);
+    }
+    
+    // a counter written anywhere else has no known range
+    for (size_t k = m_loop.bodyBegin(); k < m_loop.bodyEnd(); k++)
+    {
+        const IrTacArg* def = getDefinedVariable(m_stmts[k]);
+        if (def == nullptr) continue;
+        auto it = updates.find(getOperandKey(*def));
+        if (it != updates.end() && !it->second.count(k)) updates.erase(it);
+    }
+    for (auto& it : inner)
+    {
+        if (updates.count(it.m_counter)) m_ranges.push_back(it);
+    }
+    return true;
+}
+
+bool ParallelLoop::checkScalars() const
+{
+    // Forward must-be-assigned analysis over one iteration of the body: every
+    // read of a variable the body writes must see a write from the same
+    // iteration.
+    const size_t first = m_loop.bodyBegin();
+    const size_t N = m_loop.bodyEnd() - first;
+    if (N == 0) return true;
+    
+    std::map<std::string, size_t> index;
+    for (auto it : m_writes)
+    {
+        const size_t n = index.size();
+        index[it] = n;
+    }
+    std::map<std::string, size_t> labels;
+    for (size_t k = 0; k < N; k++)
+    {
+        if (m_stmts[first + k].m_opcode == IrOpcode::LABEL) labels[m_stmts[first + k].m_src0.m_asString] = k;
+    }
+    std::vector<std::vector<size_t>> preds(N);
+    for (size_t k = 0; k < N; k++)
+    {
+        const IrTacStmt& stmt = m_stmts[first + k];
+        if (k + 1 < N && stmt.m_opcode != IrOpcode::JUMP) preds[k+1].push_back(k);
+        const IrTacArg* target = getBranchTarget(stmt);
+        if (target && labels.count(target->m_asString)) preds[labels[target->m_asString]].push_back(k);
+    }
+    
+    const std::vector<bool> all(index.size(), true);
+    std::vector<std::vector<bool>> in(N, all), out(N, all);
+    in[0].assign(index.size(), false);
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t k = 0; k < N; k++)
+        {
+            std::vector<bool> assigned = in[k];
+            if (k > 0 && !preds[k].empty())
+            {
+                assigned = all;
+                for (auto p : preds[k])
+                {
+                    for (size_t v = 0; v < assigned.size(); v++) assigned[v] = assigned[v] && out[p][v];
+                }
+            }
+            if (k == 0) assigned.assign(index.size(), false);
+            std::vector<bool> result = assigned;
+            const IrTacArg* def = getDefinedVariable(m_stmts[first + k]);
+            if (def) result[index[getOperandKey(*def)]] = true;
+            if (assigned != in[k] || result != out[k])
+            {
+                in[k] = assigned;
+                out[k] = result;
+                changed = true;
+            }
+        }
+    }
+    
+    std::vector<const IrTacArg*> used;
+    for (size_t k = 0; k < N; k++)
+    {
+        getUsedVariables(m_stmts[first + k], used);
+        for (auto it : used)
+        {
+            auto iv = index.find(getOperandKey(*it));
+            if (iv != index.end() && !in[k][iv->second]) return false;
+        }
+    }
+    
+    // private copies are lost, so their final values must not be needed
+    return !isLiveAfterLoop();
+}
+
+bool ParallelLoop::isLiveAfterLoop() const
+{
+    // Backward liveness of the variables the body writes over the statements
+    // of the function.
+    const size_t N = m_functionEnd - m_functionBegin;
+    std::map<std::string, size_t> index;
+    for (auto it : m_writes)
+    {
+        const size_t n = index.size();
+        index[it] = n;
+    }
+    std::map<std::string, size_t> labels;
+    for (size_t k = 0; k < N; k++)
+    {
+        if (m_stmts[m_functionBegin + k].m_opcode == IrOpcode::LABEL) labels[m_stmts[m_functionBegin + k].m_src0.m_asString] = k;
+    }
+    
+    std::vector<std::vector<bool>> live(N, std::vector<bool>(index.size(), false));
+    std::vector<const IrTacArg*> used;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t k = N; k-- > 0;)
+        {
+            const IrTacStmt& stmt = m_stmts[m_functionBegin + k];
+            std::vector<bool> in(index.size(), false);
+            if (k + 1 < N && stmt.m_opcode != IrOpcode::JUMP && stmt.m_opcode != IrOpcode::RETURN) in = live[k+1];
+            const IrTacArg* target = getBranchTarget(stmt);
+            if (target && labels.count(target->m_asString))
+            {
+                const std::vector<bool>& other = live[labels[target->m_asString]];
+                for (size_t v = 0; v < in.size(); v++) in[v] = in[v] || other[v];
+            }
+            
+            const IrTacArg* def = getDefinedVariable(stmt);
+            if (def && index.count(getOperandKey(*def))) in[index[getOperandKey(*def)]] = false;
+            getUsedVariables(stmt, used);
+            for (auto it : used)
+            {
+                auto iv = index.find(getOperandKey(*it));
+                if (iv != index.end()) in[iv->second] = true;
+            }
+            if (in != live[k])
+            {
+                live[k] = in;
+                changed = true;
+            }
+        }
+    }
+    
+    const std::vector<bool>& exit = live[m_loop.m_end - m_functionBegin];
+    return std::find(exit.begin(), exit.end(), true) != exit.end();
+}
+
+bool ParallelLoop::addCheck(const IrAffineExpr& expr)
+{
+    if (expr.isConstant()) return (expr.m_constant <= 0);
+    
+    auto it = m_checks.find(expr.m_terms);
+    if (it == m_checks.end())
+        m_checks[expr.m_terms] = expr.m_constant;
+    else
+        it->second = std::max(it->second, expr.m_constant);
+    return true;
+}
+
+bool ParallelLoop::checkArrays()
+{
+    struct Access
+    {
+        IrAffineExpr m_lo;      // footprint within an iteration of the outer loop
+        IrAffineExpr m_hi;
+        long m_stride;          // coefficient of the outer counter
+        bool m_write;
+    };
+    std::map<std::string, std::vector<Access>> accesses;
+    
+    auto isTerm = [this](const IrTacArg& arg) 
+    {
+        const std::string key = getOperandKey(arg);
+        if (isInvariant(arg)) return true;
+        for (auto& it : m_ranges)
+        {
+            if (it.m_counter == key) return true;
+        }
+        return false;
+    };
+    
+    for (size_t k = m_loop.bodyBegin(); k < m_loop.bodyEnd(); k++)
+    {
+        const IrTacStmt& stmt = m_stmts[k];
+        const IrTacArg* offset = nullptr;
+        const std::string* array = nullptr;
+        if (stmt.m_opcode == IrOpcode::LOAD)
+        {
+            array = &stmt.m_src0.m_asString;
+            offset = &stmt.m_src1;
+        }
+        else if (stmt.m_opcode == IrOpcode::STORE)
+        {
+            array = &stmt.m_src1.m_asString;
+            offset = &stmt.m_dst;
+        }
+        if (offset == nullptr) continue;
+        if (stmt.m_info <= 0) return false;
+        
+        IrAffineExpr index;
+        if (!evaluateAffine(m_stmts, m_loop.bodyBegin(), m_loop.bodyEnd(), *offset, isTerm, index)) return false;
+        
+        Access access;
+        access.m_stride = index.coefficient(m_counter);
+        access.m_write = (stmt.m_opcode == IrOpcode::STORE);
+        access.m_lo.m_constant = access.m_hi.m_constant = index.m_constant;
+        for (auto it : index.m_terms)
+        {
+            if (it.first == m_counter) continue;
+            const long coef = it.second;
+            IrAffineExpr term;
+            term.m_terms[it.first] = 1;
+            const CounterRange* range = nullptr;
+            for (auto& ir : m_ranges)
+            {
+                if (ir.m_counter == it.first) 
+                {
+                    range = findRange(it.first, k);
+                    if (range == nullptr) return false;
+                    break;
+                }
+            }
+            access.m_lo.add(range ? (coef > 0 ? range->m_lo : range->m_hi) : term, coef);
+            access.m_hi.add(range ? (coef > 0 ? range->m_hi : range->m_lo) : term, coef);
+        }
+        
+        // every access stays within the array
+        const CounterRange& outer = m_ranges.front();
+        IrAffineExpr lo = access.m_lo, hi = access.m_hi;
+        lo.add(access.m_stride > 0 ? outer.m_lo : outer.m_hi, access.m_stride);
+        hi.add(access.m_stride > 0 ? outer.m_hi : outer.m_lo, access.m_stride);
+        lo.scale(-1);
+        hi.m_constant -= stmt.m_info - 1;
+        if (!addCheck(lo) || !addCheck(hi)) return false;
+        
+        accesses[*array].push_back(access);
+    }
+    
+    // arrays written in the body: footprints of different iterations are disjoint
+    for (auto& it : accesses)
+    {
+        const std::vector<Access>& list = it.second;
+        if (std::none_of(list.begin(), list.end(), [](const Access& a) { return a.m_write; })) continue;
+        
+        const long stride = list.front().m_stride;
+        if (stride == 0) return false;
+        for (auto& a : list)
+        {
+            if (a.m_stride != stride) return false;
+            for (auto& b : list)
+            {
+                IrAffineExpr span = a.m_hi;
+                span.add(b.m_lo, -1);
+                span.m_constant -= std::abs(stride) - 1;
+                if (!addCheck(span)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+void ParallelLoop::emitCheck(const std::map<std::string, long>& terms, long constant, const IrTacArg& acc, const IrTacArg& product,
+                             const IrTacArg& test, const IrTacArg& fail, std::vector<IrTacStmt>& code) const
+{
+    const int lineNo = m_stmts[m_loop.m_init].m_lineNo;
+    bool first = true;
+    for (auto it : terms)
+    {
+        const IrTacArg& var = m_variables.at(it.first);
+        if (first)
+        {
+            if (it.second == 1)
+                code.push_back(makeTac(IrOpcode::MOV, lineNo, var, IrTacArg(), acc));
+            else
+                code.push_back(makeTac(IrOpcode::MUL, lineNo, var, makeInteger(it.second), acc));
+            first = false;
+        }
+        else if (it.second == 1)
+        {
+            code.push_back(makeTac(IrOpcode::ADD, lineNo, acc, var, acc));
+        }
+        else
+        {
+            code.push_back(makeTac(IrOpcode::MUL, lineNo, var, makeInteger(it.second), product));
+            code.push_back(makeTac(IrOpcode::ADD, lineNo, acc, product, acc));
+        }
+    }
+    code.push_back(makeTac(IrOpcode::LESSEQUAL, lineNo, acc, makeInteger(-constant), test));
+    code.push_back(makeTac(IrOpcode::IFZ, lineNo, test, fail));
+}
+
+int ParallelLoop::outline(const std::string& name, const std::string& entry, std::ptrdiff_t frameEnd, 
+                          std::vector<IrTacStmt>& replacement, std::vector<IrTacStmt>& function) const
+{
+    const IrTacStmt& init = m_stmts[m_loop.m_init];
+    const IrTacArg& counter = init.m_dst;
+    const int lineNo = init.m_lineNo;
+    
+    // new slots past everything the function uses; both frames share the layout
+    const IrTacArg fixup = makeSlot(frameEnd);
+    const IrTacArg acc = makeSlot(frameEnd + 8);
+    const IrTacArg product = makeSlot(frameEnd + 16);
+    const IrTacArg hi = makeSlot(frameEnd);
+    const IrTacArg test = makeSlot(frameEnd + 8);
+    const int frameSize = alignFrameSize(frameEnd + 24);
+    
+    const IrTacArg done = makeLabel(IrIdentifier::CreateLabel()->getIdentifier());
+    const IrTacArg serial = makeLabel(IrIdentifier::CreateLabel()->getIdentifier());
+    const IrTacArg& end = m_stmts[m_loop.m_end].m_src0;
+    
+    // caller: evaluate the bound, run the checks and hand the range to the runtime
+    replacement.push_back(init);
+    replacement.insert(replacement.end(), m_stmts.begin() + m_loop.top() + 1, m_stmts.begin() + m_loop.m_test - 1);
+    for (auto it : m_checks)
+    {
+        emitCheck(it.first, it.second, acc, product, fixup, serial, replacement);
+    }
+    
+    IrTacStmt param = makeTac(IrOpcode::PARAM, lineNo, makeLabel(name));
+    replacement.push_back(param);
+    param.m_src0 = counter;
+    param.m_info = 1;
+    replacement.push_back(param);
+    param.m_src0 = *m_bound;
+    param.m_info = 2;
+    replacement.push_back(param);
+    for (auto it : m_arguments)
+    {
+        param.m_src0 = it.second;
+        param.m_info++;
+        replacement.push_back(param);
+    }
+    while (param.m_info < 2 + (int)MAX_PARALLEL_ARGS)
+    {
+        param.m_src0 = makeInteger(0);
+        param.m_info++;
+        replacement.push_back(param);
+    }
+    replacement.push_back(makeTac(IrOpcode::CALL, lineNo, makeLabel(entry)));
+    
+    // the counter leaves the loop as max(init, bound)
+    replacement.push_back(makeTac(IrOpcode::LESS, lineNo, counter, *m_bound, fixup));
+    replacement.push_back(makeTac(IrOpcode::IFZ, lineNo, fixup, done));
+    replacement.push_back(makeTac(IrOpcode::MOV, lineNo, *m_bound, IrTacArg(), counter));
+    replacement.push_back(makeTac(IrOpcode::LABEL, lineNo, done));
+    if (!m_checks.empty())
+    {
+        replacement.push_back(makeTac(IrOpcode::JUMP, lineNo, end));
+        replacement.push_back(makeTac(IrOpcode::LABEL, lineNo, serial));
+        replacement.insert(replacement.end(), m_stmts.begin() + m_loop.top(), m_stmts.begin() + m_loop.m_jump + 1);
+    }
+    replacement.push_back(m_stmts[m_loop.m_end]);
+    
+    // outlined body: name(first, last, args...) runs the iterations [first, last)
+    std::map<std::string, std::string> labels;
+    for (auto it : m_labels)
+    {
+        labels[it] = IrIdentifier::CreateLabel()->getIdentifier();
+    }
+    const std::string& continueLabel = m_stmts[m_loop.m_continue].m_src0.m_asString;
+    labels[continueLabel] = IrIdentifier::CreateLabel()->getIdentifier();
+    const IrTacArg top = makeLabel(IrIdentifier::CreateLabel()->getIdentifier());
+    const IrTacArg exit = makeLabel(IrIdentifier::CreateLabel()->getIdentifier());
+    
+    IrTacStmt begin = makeTac(IrOpcode::FBEGIN, lineNo, makeLabel(name));
+    begin.m_info = frameSize;
+    function.push_back(begin);
+    IrTacStmt getParam = makeTac(IrOpcode::GETPARAM, lineNo, counter);
+    function.push_back(getParam);
+    getParam.m_src0 = hi;
+    getParam.m_info++;
+    function.push_back(getParam);
+    for (auto it : m_arguments)
+    {
+        getParam.m_src0 = it.second;
+        getParam.m_info++;
+        function.push_back(getParam);
+    }
+    function.push_back(makeTac(IrOpcode::LABEL, lineNo, top));
+    function.push_back(makeTac(IrOpcode::LESS, lineNo, counter, hi, test));
+    function.push_back(makeTac(IrOpcode::IFZ, lineNo, test, exit));
+    for (size_t k = m_loop.bodyBegin(); k <= m_loop.m_continue + 1; k++)
+    {
+        IrTacStmt stmt = m_stmts[k];
+        IrTacArg* label = nullptr;
+        if (stmt.m_opcode == IrOpcode::LABEL || stmt.m_opcode == IrOpcode::JUMP)
+            label = &stmt.m_src0;
+        else if (stmt.m_opcode == IrOpcode::IFZ || stmt.m_opcode == IrOpcode::IFNZ)
+            label = &stmt.m_src1;
+        if (label && labels.count(label->m_asString)) label->m_asString = labels[label->m_asString];
+        function.push_back(stmt);
+    }
+    function.push_back(makeTac(IrOpcode::JUMP, lineNo, top));
+    function.push_back(makeTac(IrOpcode::LABEL, lineNo, exit));
+    function.push_back(makeTac(IrOpcode::RETURN, lineNo, IrTacArg()));
+    
+    return frameSize;
+}
+
+} // namespace
+
+bool IrOptimizer::parallelizeLoops()
+{
+    generateStatements();
+    
+    std::vector<IrTacStmt> outlined;
+    bool changed = false;
+    size_t functionBegin = 0;
+    size_t n = 0;
+    while (n < m_statements.size())
+    {
+        if (m_statements[n].m_opcode == IrOpcode::FBEGIN) functionBegin = n;
+        
+        IrForLoop loop;
+        if (m_statements[functionBegin].m_opcode == IrOpcode::FBEGIN && matchForLoop(m_statements, n, loop))
+        {
+            size_t functionEnd = n;
+            while (functionEnd < m_statements.size() && m_statements[functionEnd].m_opcode != IrOpcode::FBEGIN) functionEnd++;
+            
+            ParallelLoop candidate(m_statements, loop, functionBegin, functionEnd);
+            if (candidate.analyze())
+            {
+                IrTacStmt& begin = m_statements[functionBegin];
+                const std::string name = begin.m_src0.m_asString + ".par" + std::to_string(m_outlinedLoops++);
+                
+                std::vector<IrTacStmt> replacement;
+                const int frameSize = candidate.outline(name, PARALLEL_FOR_ENTRY, getFrameEnd(m_statements, functionBegin, functionEnd), replacement, outlined);
+                begin.m_info = std::max(begin.m_info, frameSize);
+                
+                m_statements.erase(m_statements.begin() + loop.m_init, m_statements.begin() + loop.m_end + 1);
+                m_statements.insert(m_statements.begin() + loop.m_init, replacement.begin(), replacement.end());
+                n = loop.m_init + replacement.size();
+                changed = true;
+                continue;
+            }
+        }
+        n++;
+    }
+    
+    if (changed)
+    {
+        m_statements.insert(m_statements.end(), outlined.begin(), outlined.end());
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+bool IrOptimizer::lowerParallelLoops()
+{
+    generateStatements();
+    
+    bool changed = false;
+    size_t functionBegin = 0;
+    size_t n = 0;
+    while (n < m_statements.size())
+    {
+        if (m_statements[n].m_opcode == IrOpcode::FBEGIN) functionBegin = n;
+        if (m_statements[n].m_opcode != IrOpcode::PARFOR)
+        {
+            n++;
+            continue;
+        }
+        
+        const IrTacStmt marker = m_statements[n];
+        m_statements.erase(m_statements.begin() + n);
+        changed = true;
+        
+        // the loop follows the code computing its initial value
+        IrForLoop loop;
+        size_t first = n;
+        while (first < m_statements.size() && !matchForLoop(m_statements, first, loop) && isSimpleStatement(m_statements[first])) first++;
+        size_t functionEnd = n;
+        while (functionEnd < m_statements.size() && m_statements[functionEnd].m_opcode != IrOpcode::FBEGIN) functionEnd++;
+        
+        bool lowered = false;
+        std::string race;
+        if (first < functionEnd && matchForLoop(m_statements, first, loop))
+        {
+            ParallelLoop candidate(m_statements, loop, functionBegin, functionEnd);
+            if (candidate.analyzeMarked())
+            {
+                IrTacStmt& begin = m_statements[functionBegin];
+                const std::string name = begin.m_src0.m_asString + ".par" + std::to_string(m_outlinedLoops++);
+                
+                std::vector<IrTacStmt> replacement, outlined;
+                const int frameSize = candidate.outline(name, marker.m_src0.m_asString, getFrameEnd(m_statements, functionBegin, functionEnd), replacement, outlined);
+                begin.m_info = std::max(begin.m_info, frameSize);
+                
+                m_statements.erase(m_statements.begin() + loop.m_init, m_statements.begin() + loop.m_end + 1);
+                m_statements.insert(m_statements.begin() + loop.m_init, replacement.begin(), replacement.end());
+                // outlined bodies are scanned too, for nested parallel loops
+                m_statements.insert(m_statements.end(), outlined.begin(), outlined.end());
+                n = loop.m_init + replacement.size();
+                lowered = true;
+            }
+            else
+            {
+                race = candidate.getRace();
+            }
+        }
+        if (!lowered)
+        {
+            std::cerr << "warning: parallel for loop on line " << marker.m_lineNo << " runs serially; "
+                      << (race.empty() ? "its body could not be outlined" : race) << "." << std::endl;
+        }
+    }
+    
+    if (changed) generateBasicBlocks(m_statements);
+    return changed;
+}
+
+} // namespace Decaf
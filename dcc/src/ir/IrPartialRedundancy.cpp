@@ -0,0 +1,625 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "IrOptimizer.h"
+#include "IrCallSummary.h"
+#include "IrFlowGraph.h"
+#include "IrIdentifier.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// longest loop test duplicated by loop rotation
+const size_t MAX_ROTATED_TEST = 8;
+// rounds of elimination separated by copy propagation
+const int MAX_PRE_ROUNDS = 3;
+
+IrTacStmt makeStmt(IrOpcode opcode, int lineNo, const IrTacArg& src0, const IrTacArg& src1 = IrTacArg())
+{
+    IrTacStmt stmt(opcode, lineNo);
+    stmt.m_src0 = src0;
+    stmt.m_src1 = src1;
+    return stmt;
+}
+
+// Loops tested at the top are rotated to test at the bottom, so a loop's 
+// body is entered through an edge where its invariant expressions are 
+// anticipated:
+//   top: test; IFZ c, end; body; JUMP top  =>  top: test; IFZ c, end; L: body; test; IFNZ c, L; JUMP end
+bool rotateLoops(std::vector<IrTacStmt>& stmts)
+{
+    std::unordered_map<std::string, size_t> labels;
+    for (size_t n = 0; n < stmts.size(); n++)
+    {
+        if (stmts[n].m_opcode == IrOpcode::LABEL) labels[stmts[n].m_src0.m_asString] = n;
+    }
+    
+    // back edge jump => first test statement, loop branch
+    std::map<size_t, std::pair<size_t, size_t>> rotations;
+    // statement following a loop branch => label for the loop body
+    std::map<size_t, IrTacArg> bodyLabels;
+    for (size_t n = 0; n < stmts.size(); n++)
+    {
+        if (stmts[n].m_opcode != IrOpcode::JUMP) continue;
+        auto it = labels.find(stmts[n].m_src0.m_asString);
+        if (it == labels.end() || it->second > n) continue;
+        
+        size_t test = it->second;
+        while (stmts[test].m_opcode == IrOpcode::LABEL) test++;
+        size_t branch = test;
+        while (branch < n && branch - test <= MAX_ROTATED_TEST && stmts[branch].m_opcode != IrOpcode::LABEL &&
+               stmts[branch].m_opcode != IrOpcode::CALL && getBranchTarget(stmts[branch]) == nullptr && 
+               stmts[branch].m_opcode != IrOpcode::RETURN) 
+            branch++;
+        if (branch >= n || branch - test > MAX_ROTATED_TEST) continue;
+        if (stmts[branch].m_opcode != IrOpcode::IFZ && stmts[branch].m_opcode != IrOpcode::IFNZ) continue;
+        
+        rotations[n] = std::make_pair(test, branch);
+        if (bodyLabels.count(branch + 1) == 0)
+        {
+            IrTacArg label;
+            if (stmts[branch + 1].m_opcode == IrOpcode::LABEL)
+                label = stmts[branch + 1].m_src0;
+            else
+                label.buildLabel(IrIdentifier::CreateLabel()->getIdentifier());
+            bodyLabels[branch + 1] = label;
+        }
+    }
+    if (rotations.empty()) return false;
+    
+    std::vector<IrTacStmt> rotated;
+    rotated.reserve(stmts.size() + rotations.size() * (MAX_ROTATED_TEST + 2));
+    for (size_t n = 0; n < stmts.size(); n++)
+    {
+        auto ib = bodyLabels.find(n);
+        if (ib != bodyLabels.end() && stmts[n].m_opcode != IrOpcode::LABEL)
+        {
+            rotated.push_back(makeStmt(IrOpcode::LABEL, stmts[n].m_lineNo, ib->second));
+        }
+        
+        auto ir = rotations.find(n);
+        if (ir == rotations.end())
+        {
+            rotated.push_back(stmts[n]);
+            continue;
+        }
+        
+        const size_t test = ir->second.first;
+        const size_t branch = ir->second.second;
+        rotated.insert(rotated.end(), stmts.begin() + test, stmts.begin() + branch);
+        IrTacStmt loop = stmts[branch];
+        loop.m_opcode = (loop.m_opcode == IrOpcode::IFZ) ? IrOpcode::IFNZ : IrOpcode::IFZ;
+        loop.m_src1 = bodyLabels[branch + 1];
+        if (loop.m_taken >= 0) loop.m_taken = loop.m_count - loop.m_taken;
+        rotated.push_back(loop);
+        rotated.push_back(makeStmt(IrOpcode::JUMP, stmts[branch].m_lineNo, stmts[branch].m_src1));
+    }
+    stmts.swap(rotated);
+    return true;
+}
+
+// Set of expressions, by number.
+class ExprSet
+{
+public:
+    ExprSet(size_t size = 0, bool full = false) :
+        m_bits((size + 63) / 64, full ? ~0UL : 0UL)
+    {
+        if (full && size % 64 != 0) m_bits.back() = (1UL << (size % 64)) - 1;
+    }
+    
+    bool test(size_t n) const { return (m_bits[n / 64] >> (n % 64)) & 1; }
+    void set(size_t n) { m_bits[n / 64] |= (1UL << (n % 64)); }
+    void reset(size_t n) { m_bits[n / 64] &= ~(1UL << (n % 64)); }
+    
+    ExprSet& operator&=(const ExprSet& rhs) 
+    {
+        for (size_t k = 0; k < m_bits.size(); k++) m_bits[k] &= rhs.m_bits[k];
+        return *this;
+    }
+    ExprSet& operator|=(const ExprSet& rhs) 
+    {
+        for (size_t k = 0; k < m_bits.size(); k++) m_bits[k] |= rhs.m_bits[k];
+        return *this;
+    }
+    ExprSet& operator-=(const ExprSet& rhs) 
+    {
+        for (size_t k = 0; k < m_bits.size(); k++) m_bits[k] &= ~rhs.m_bits[k];
+        return *this;
+    }
+    bool operator==(const ExprSet& rhs) const { return m_bits == rhs.m_bits; }
+    bool operator!=(const ExprSet& rhs) const { return m_bits != rhs.m_bits; }
+    
+private:
+    std::vector<unsigned long> m_bits;
+};
+
+ExprSet operator|(ExprSet lhs, const ExprSet& rhs) { return lhs |= rhs; }
+ExprSet operator-(ExprSet lhs, const ExprSet& rhs) { return lhs -= rhs; }
+
+// Pure computation of variables and literals; integer divisions may trap and
+// stay where they are.
+bool isCandidate(const IrTacStmt& stmt)
+{
+    if (!isBinaryOp(stmt.m_opcode) && !isComparisonOp(stmt.m_opcode) && !isLogicOp(stmt.m_opcode) && stmt.m_opcode != IrOpcode::NOT)
+        return false;
+    if ((stmt.m_opcode == IrOpcode::DIV || stmt.m_opcode == IrOpcode::MOD) && !stmt.m_dst.isDouble()) return false;
+    if (!stmt.m_dst.isMemory()) return false;
+    
+    for (auto arg : { &stmt.m_src0, &stmt.m_src1 })
+    {
+        if (arg->m_usage != IrUsage::Unused && arg->m_usage != IrUsage::Literal && !arg->isMemory())
+            return false;
+    }
+    return true;
+}
+
+// Lazy code motion (Knoop, Ruething and Steffen; in the edge based form of
+// Drechsler and Stadel) over the blocks of one function.  Every computation
+// of an expression is made to go through one temporary per expression; 
+// computations made redundant by insertions on edges are replaced by copies
+// of the temporary.
+class PartialRedundancy
+{
+public:
+    PartialRedundancy(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, const IrCallSummary& summary);
+    
+    void solve();
+    bool rewrite(std::vector<IrTacStmt>& result, std::ptrdiff_t& frameEnd);
+    
+private:
+    struct Edge
+    {
+        size_t m_from;
+        size_t m_to;
+        ExprSet m_insert;
+    };
+    
+    void computeLocal();
+    ExprSet later(const Edge& edge, const std::vector<ExprSet>& earliest, size_t e) const;
+    bool isBranchTarget(size_t from, size_t to) const;
+    template <typename Func>
+    void forEachKilled(const IrTacStmt& stmt, Func func) const;
+    
+    const std::vector<IrTacStmt>& m_stmts;
+    const size_t m_first;
+    const size_t m_last;
+    const IrCallSummary& m_summary;
+    IrFlowGraph m_graph;
+    std::vector<bool> m_reachable;
+    
+    // expression computed by each statement, or -1
+    std::vector<int> m_exprOf;
+    // a statement computing each expression
+    std::vector<size_t> m_exprStmt;
+    // expressions reading each variable
+    std::unordered_map<std::string, std::vector<int>> m_readers;
+    // globals read by expressions, which calls may change
+    std::vector<std::string> m_globalsRead;
+    
+    // upward exposed, downward exposed and killed expressions of each block
+    std::vector<ExprSet> m_ueExpr;
+    std::vector<ExprSet> m_deExpr;
+    std::vector<ExprSet> m_exprKill;
+    ExprSet m_locallyRedundant;
+    
+    std::vector<Edge> m_edges;
+    std::vector<ExprSet> m_laterIn;
+    std::vector<ExprSet> m_delete;
+};
+
+PartialRedundancy::PartialRedundancy(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, const IrCallSummary& summary) :
+    m_stmts(stmts),
+    m_first(first),
+    m_last(last),
+    m_summary(summary),
+    m_graph(stmts, first, last),
+    m_reachable(m_graph.size(), false),
+    m_exprOf(last - first, -1)
+{
+    std::unordered_map<std::string, int> exprs;
+    for (size_t n = first; n < last; n++)
+    {
+        const IrTacStmt& stmt = stmts[n];
+        if (!isCandidate(stmt)) continue;
+        
+        const std::string key = std::to_string((int)stmt.m_opcode) + " " + getOperandKey(stmt.m_src0) + " " + 
+                                getOperandKey(stmt.m_src1) + " " + std::to_string((int)stmt.m_dst.m_type);
+        auto it = exprs.emplace(key, (int)m_exprStmt.size());
+        if (it.second)
+        {
+            m_exprStmt.push_back(n);
+            for (auto arg : { &stmt.m_src0, &stmt.m_src1 })
+            {
+                if (!arg->isMemory()) continue;
+                auto& readers = m_readers[getVariableKey(*arg)];
+                if (readers.empty() && arg->m_usage == IrUsage::Global) m_globalsRead.push_back(arg->m_asString);
+                readers.push_back(it.first->second);
+            }
+        }
+        m_exprOf[n - first] = it.first->second;
+    }
+    for (auto b : m_graph.reversePostorder())
+    {
+        m_reachable[b] = true;
+    }
+    computeLocal();
+}
+
+template <typename Func>
+void PartialRedundancy::forEachKilled(const IrTacStmt& stmt, Func func) const
+{
+    if (stmt.m_opcode == IrOpcode::CALL || stmt.m_opcode == IrOpcode::PARFOR)
+    {
+        for (const auto& global : m_globalsRead)
+        {
+            if (!m_summary.mayWrite(stmt, global)) continue;
+            for (auto killed : m_readers.at(global)) func(killed);
+        }
+    }
+    const IrTacArg* def = getDefinedVariable(stmt);
+    if (def == nullptr) return;
+    auto it = m_readers.find(getVariableKey(*def));
+    if (it == m_readers.end()) return;
+    for (auto killed : it->second) func(killed);
+}
+
+void PartialRedundancy::computeLocal()
+{
+    const size_t numExprs = m_exprStmt.size();
+    m_ueExpr.assign(m_graph.size(), ExprSet(numExprs));
+    m_deExpr.assign(m_graph.size(), ExprSet(numExprs));
+    m_exprKill.assign(m_graph.size(), ExprSet(numExprs));
+    m_locallyRedundant = ExprSet(numExprs);
+    
+    for (size_t b = 0; b < m_graph.size(); b++)
+    {
+        for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+        {
+            const int e = m_exprOf[n - m_first];
+            if (e >= 0)
+            {
+                if (m_deExpr[b].test(e)) m_locallyRedundant.set(e);
+                if (!m_exprKill[b].test(e)) m_ueExpr[b].set(e);
+                m_deExpr[b].set(e);
+            }
+            
+            forEachKilled(m_stmts[n], [&](int killed)
+            {
+                m_exprKill[b].set(killed);
+                m_deExpr[b].reset(killed);
+            });
+        }
+    }
+}
+
+void PartialRedundancy::solve()
+{
+    const size_t numExprs = m_exprStmt.size();
+    const size_t numBlocks = m_graph.size();
+    const std::vector<size_t> order = m_graph.reversePostorder();
+    
+    // available: AvailOut(b) = DEExpr(b) | (AvailIn(b) - ExprKill(b))
+    std::vector<ExprSet> availOut(numBlocks, ExprSet(numExprs, true));
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto b : order)
+        {
+            ExprSet in(numExprs, b != 0);
+            for (auto p : m_graph[b].m_preds)
+            {
+                if (m_reachable[p]) in &= availOut[p];
+            }
+            ExprSet out = m_deExpr[b] | (in - m_exprKill[b]);
+            if (out != availOut[b])
+            {
+                availOut[b] = out;
+                changed = true;
+            }
+        }
+    }
+    
+    // anticipated: AntIn(b) = UEExpr(b) | (AntOut(b) - ExprKill(b))
+    std::vector<ExprSet> antIn(numBlocks, ExprSet(numExprs, true));
+    std::vector<ExprSet> antOut(numBlocks, ExprSet(numExprs));
+    changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto ib = order.rbegin(); ib != order.rend(); ++ib)
+        {
+            const size_t b = *ib;
+            ExprSet out(numExprs, !m_graph[b].m_succs.empty());
+            for (auto s : m_graph[b].m_succs)
+            {
+                out &= antIn[s];
+            }
+            antOut[b] = out;
+            ExprSet in = m_ueExpr[b] | (out - m_exprKill[b]);
+            if (in != antIn[b])
+            {
+                antIn[b] = in;
+                changed = true;
+            }
+        }
+    }
+    
+    // earliest placement on each edge
+    std::vector<ExprSet> earliest;
+    for (auto b : order)
+    {
+        for (auto s : m_graph[b].m_succs)
+        {
+            m_edges.push_back(Edge{b, s, ExprSet(numExprs)});
+            earliest.push_back(antIn[s] - availOut[b]);
+            earliest.back() &= (m_exprKill[b] | (ExprSet(numExprs, true) - antOut[b]));
+        }
+    }
+    
+    // postponed: LaterIn(b) = intersection of Later(p, b) over the edges into b;
+    // the function is entered through an edge into block 0 where everything
+    // anticipated is earliest
+    m_laterIn.assign(numBlocks, ExprSet(numExprs, true));
+    m_laterIn[0] = antIn[0];
+    changed = true;
+    while (changed)
+    {
+        changed = false;
+        std::vector<ExprSet> laterIn(numBlocks, ExprSet(numExprs, true));
+        laterIn[0] = antIn[0];
+        for (size_t e = 0; e < m_edges.size(); e++)
+        {
+            laterIn[m_edges[e].m_to] &= later(m_edges[e], earliest, e);
+        }
+        for (auto b : order)
+        {
+            if (laterIn[b] != m_laterIn[b])
+            {
+                m_laterIn[b] = laterIn[b];
+                changed = true;
+            }
+        }
+    }
+    
+    for (size_t e = 0; e < m_edges.size(); e++)
+    {
+        m_edges[e].m_insert = later(m_edges[e], earliest, e) - m_laterIn[m_edges[e].m_to];
+    }
+    m_delete.assign(numBlocks, ExprSet(numExprs));
+    for (auto b : order)
+    {
+        if (b != 0) m_delete[b] = m_ueExpr[b] - m_laterIn[b];
+    }
+}
+
+ExprSet PartialRedundancy::later(const Edge& edge, const std::vector<ExprSet>& earliest, size_t e) const
+{
+    return earliest[e] | (m_laterIn[edge.m_from] - m_ueExpr[edge.m_from]);
+}
+
+bool PartialRedundancy::isBranchTarget(size_t from, size_t to) const
+{
+    const IrTacArg* target = getBranchTarget(m_stmts[m_graph[from].m_last - 1]);
+    if (target == nullptr) return false;
+    for (size_t n = m_graph[to].m_first; n < m_graph[to].m_last && m_stmts[n].m_opcode == IrOpcode::LABEL; n++)
+    {
+        if (m_stmts[n].m_src0.m_asString == target->m_asString) return true;
+    }
+    return false;
+}
+
+bool PartialRedundancy::rewrite(std::vector<IrTacStmt>& result, std::ptrdiff_t& frameEnd)
+{
+    const size_t numExprs = m_exprStmt.size();
+    const size_t numBlocks = m_graph.size();
+    
+    // only expressions with a redundancy to remove are rewritten
+    ExprSet rewritten = m_locallyRedundant;
+    for (size_t b = 0; b < numBlocks; b++)
+    {
+        rewritten |= m_delete[b];
+    }
+    for (auto& edge : m_edges)
+    {
+        rewritten |= edge.m_insert;
+    }
+    
+    std::vector<IrTacArg> temps(numExprs);
+    bool any = false;
+    for (size_t e = 0; e < numExprs; e++)
+    {
+        if (!rewritten.test(e)) continue;
+        temps[e].buildTemporary(IrIdentifier::CreateTemporary()->getIdentifier(), frameEnd, m_stmts[m_exprStmt[e]].m_dst.m_type);
+        frameEnd += 8;
+        any = true;
+    }
+    if (!any)
+    {
+        result.insert(result.end(), m_stmts.begin() + m_first, m_stmts.begin() + m_last);
+        return false;
+    }
+    
+    auto compute = [&](size_t e, int lineNo) {
+        IrTacStmt stmt = m_stmts[m_exprStmt[e]];
+        stmt.m_dst = temps[e];
+        stmt.m_lineNo = lineNo;
+        return stmt;
+    };
+    
+    // insertions at the start of a block, at the end of a block (before its
+    // branch), after its branch (on the fall through edge) and on split edges
+    std::vector<std::vector<IrTacStmt>> atStart(numBlocks), atEnd(numBlocks), afterBranch(numBlocks);
+    std::vector<IrTacStmt> splits;
+    std::map<size_t, IrTacArg> retargets;
+    for (auto& edge : m_edges)
+    {
+        std::vector<IrTacStmt> code;
+        const int lineNo = m_stmts[m_graph[edge.m_from].m_last - 1].m_lineNo;
+        for (size_t e = 0; e < numExprs; e++)
+        {
+            if (edge.m_insert.test(e) && rewritten.test(e)) code.push_back(compute(e, lineNo));
+        }
+        if (code.empty()) continue;
+        
+        size_t reachablePreds = 0;
+        for (auto p : m_graph[edge.m_to].m_preds)
+        {
+            if (m_reachable[p]) reachablePreds++;
+        }
+        
+        if (reachablePreds == 1)
+        {
+            atStart[edge.m_to].insert(atStart[edge.m_to].end(), code.begin(), code.end());
+        }
+        else if (m_graph[edge.m_from].m_succs.size() == 1)
+        {
+            atEnd[edge.m_from].insert(atEnd[edge.m_from].end(), code.begin(), code.end());
+        }
+        else if (!isBranchTarget(edge.m_from, edge.m_to))
+        {
+            afterBranch[edge.m_from].insert(afterBranch[edge.m_from].end(), code.begin(), code.end());
+        }
+        else
+        {
+            // critical edge through the branch: retarget it to a new block
+            const size_t branch = m_graph[edge.m_from].m_last - 1;
+            IrTacArg label;
+            label.buildLabel(IrIdentifier::CreateLabel()->getIdentifier());
+            splits.push_back(makeStmt(IrOpcode::LABEL, lineNo, label));
+            splits.insert(splits.end(), code.begin(), code.end());
+            splits.push_back(makeStmt(IrOpcode::JUMP, lineNo, m_stmts[branch].m_src1));
+            retargets[branch] = label;
+        }
+    }
+    
+    for (size_t b = 0; b < numBlocks; b++)
+    {
+        const IrFlowBlock& block = m_graph[b];
+        size_t n = block.m_first;
+        while (n < block.m_last && m_stmts[n].m_opcode == IrOpcode::LABEL)
+        {
+            result.push_back(m_stmts[n++]);
+        }
+        result.insert(result.end(), atStart[b].begin(), atStart[b].end());
+        
+        // the temporary holds the expression's value
+        ExprSet valid = m_delete[b];
+        const IrTacStmt& last = m_stmts[block.m_last - 1];
+        const bool hasBranch = (getBranchTarget(last) != nullptr);
+        for (; n < block.m_last; n++)
+        {
+            if (n == block.m_last - 1 && hasBranch) result.insert(result.end(), atEnd[b].begin(), atEnd[b].end());
+            
+            const IrTacStmt& stmt = m_stmts[n];
+            const int e = m_exprOf[n - m_first];
+            if (e >= 0 && rewritten.test(e))
+            {
+                if (!valid.test(e)) result.push_back(compute(e, stmt.m_lineNo));
+                IrTacStmt copy = makeStmt(IrOpcode::MOV, stmt.m_lineNo, temps[e]);
+                copy.m_dst = stmt.m_dst;
+                result.push_back(copy);
+                valid.set(e);
+            }
+            else if (retargets.count(n))
+            {
+                IrTacStmt branch = stmt;
+                branch.m_src1 = retargets[n];
+                result.push_back(branch);
+            }
+            else
+            {
+                result.push_back(stmt);
+            }
+            
+            forEachKilled(stmt, [&](int killed) { valid.reset(killed); });
+        }
+        if (!hasBranch) result.insert(result.end(), atEnd[b].begin(), atEnd[b].end());
+        result.insert(result.end(), afterBranch[b].begin(), afterBranch[b].end());
+    }
+    result.insert(result.end(), splits.begin(), splits.end());
+    return true;
+}
+
+bool eliminateRedundancies(std::vector<IrTacStmt>& stmts, const IrCallSummary& summary)
+{
+    const auto functions = getFunctions(stmts);
+    if (functions.empty()) return false;
+    
+    bool changed = false;
+    std::vector<IrTacStmt> result;
+    result.reserve(stmts.size());
+    result.insert(result.end(), stmts.begin(), stmts.begin() + functions.front().first);
+    for (auto it : functions)
+    {
+        std::ptrdiff_t frameEnd = getFrameEnd(stmts, it.first, it.second);
+        const size_t begin = result.size();
+        
+        PartialRedundancy function(stmts, it.first, it.second, summary);
+        function.solve();
+        if (function.rewrite(result, frameEnd))
+        {
+            result[begin].m_info = std::max(result[begin].m_info, alignFrameSize(frameEnd));
+            changed = true;
+        }
+    }
+    
+    if (changed) stmts.swap(result);
+    return changed;
+}
+
+} // namespace
+
+bool IrOptimizer::partialRedundancyElimination()
+{
+    generateStatements();
+    
+    bool changed = rotateLoops(m_statements);
+    for (int round = 0; round < MAX_PRE_ROUNDS; round++)
+    {
+        if (!eliminateRedundancies(m_statements, getCallSummary())) break;
+        changed = true;
+        
+        // Redundancy is lexical: the copies made by a round hide equal operands
+        // from the next one until they are propagated.
+        generateBasicBlocks(m_statements);
+        copyPropagation();
+        generateStatements();
+    }
+    
+    if (changed)
+    {
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
@@ -0,0 +1,288 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iomanip>
+#include "IrPassManager.h"
+#include "IrTimer.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// rounds of a fixpoint group before it is left, changed or not
+const int MAX_FIXPOINT_ROUNDS = 4;
+
+struct Pass
+{
+    const char* m_name;
+    const char* m_description;
+    bool (*m_run)(IrOptimizer& optimizer, const IrPassOptions& options);
+    // the pass only removes or moves code within methods, so the cached
+    // analyses still hold after it
+    bool m_preservesAnalyses;
+};
+
+std::string listNames(const std::vector<std::string>& names)
+{
+    std::string text;
+    for (const auto& name : names)
+    {
+        text += (text.empty() ? "" : ", ") + name;
+    }
+    return text;
+}
+
+bool removeDeadDeclarations(IrOptimizer& optimizer, const IrPassOptions& options)
+{
+    std::vector<std::string> methods, globals;
+    if (!optimizer.removeDeadDeclarations(methods, globals)) return false;
+    
+    std::cerr << (options.m_sourceName.empty() ? "<stdin>" : options.m_sourceName) << ": removed " 
+              << methods.size() << " unreachable methods" << (methods.empty() ? "" : " (" + listNames(methods) + ")") << " and " 
+              << globals.size() << " unreferenced globals" << (globals.empty() ? "" : " (" + listNames(globals) + ")") << std::endl;
+    return !methods.empty() || !globals.empty();
+}
+
+// In the order the default pipelines run them.
+const Pass PASSES[] =
+{
+    { "ipcp", "interprocedural constant propagation and method specialization",
+      [](IrOptimizer& o, const IrPassOptions& p) { return o.interproceduralConstants(p.m_cloneBudget); }, false },
+    { "loop-fusion", "loop fusion",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.loopFusion(); }, false },
+    { "parallelize", "run independent loops on the thread pool",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.parallelizeLoops(); }, false },
+    { "unswitch", "loop unswitching",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.loopUnswitching(); }, false },
+    { "unroll", "loop unrolling",
+      [](IrOptimizer& o, const IrPassOptions& p) { return o.loopUnrolling(p.m_unrollFactor); }, false },
+    { "scalar-repl", "scalar replacement of small arrays",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.scalarReplacement(); }, false },
+    { "const-prop", "conditional constant propagation",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.constantPropagation(); }, true },
+    { "simplify-cfg", "control flow graph simplification",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.simplifyControlFlow(); }, true },
+    { "bb", "basic-block optimizations",
+      [](IrOptimizer& o, const IrPassOptions& p) { return o.basicBlocksOptimizations(p.m_blockOpts); }, true },
+    { "gcse", "global value numbering and pure-call elimination",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.globalCommonSubexpressionElimination(); }, true },
+    { "load-store", "redundant load and dead store elimination",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.loadStoreElimination(); }, true },
+    { "pre", "partial redundancy elimination",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.partialRedundancyElimination(); }, true },
+    { "copy-prop", "global copy propagation and coalescing",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.copyPropagation(); }, true },
+    { "dce", "global dead code elimination",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.deadCodeElimination(); }, true },
+    { "if-convert", "if-conversion to conditional moves",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.ifConversion(); }, true },
+    { "layout", "block placement by frequency",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.blockLayout(); }, true },
+    { "dead-decls", "removal of methods and globals main cannot reach",
+      removeDeadDeclarations, false },
+    { "schedule", "list scheduling before frame slot assignment",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.scheduleInstructions(false); }, true },
+    { "slots", "frame slot assignment of temporaries",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.assignTemporarySlots(); }, true },
+    { "schedule-post", "list scheduling after frame slot assignment",
+      [](IrOptimizer& o, const IrPassOptions&) { return o.scheduleInstructions(true); }, true },
+};
+
+const Pass* findPass(const std::string& name)
+{
+    for (const auto& it : PASSES)
+    {
+        if (name == it.m_name) return &it;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+IrPassManager::IrPassManager(IrOptimizer& optimizer, const IrPassOptions& options) :
+    m_optimizer(optimizer),
+    m_options(options),
+    m_stats()
+{
+    // the code may have changed since the optimizer last saw it
+    m_optimizer.invalidateAnalyses();
+}
+
+bool IrPassManager::isPass(const std::string& name)
+{
+    return findPass(name) != nullptr;
+}
+
+void IrPassManager::printPasses(std::ostream& stream)
+{
+    for (const auto& it : PASSES)
+    {
+        stream << "  " << std::left << std::setw(16) << it.m_name << it.m_description << std::endl;
+    }
+    stream << "  " << std::left << std::setw(16) << "fixpoint(...)" << "repeat the passes listed until none of them changes the code, " 
+           << "at most " << MAX_FIXPOINT_ROUNDS << " times; 'slots' runs once" << std::endl;
+}
+
+// A comma separated list of passes and of 'fixpoint(...)' groups of them.
+bool IrPassManager::parsePipeline(const std::string& text, IrPipeline& pipeline, std::string& error)
+{
+    pipeline.clear();
+    IrPipelineStep group;
+    bool inGroup = false;
+    std::string name;
+    for (size_t n = 0; n <= text.size(); n++)
+    {
+        // the end of the text ends the last name
+        const char c = (n < text.size()) ? text[n] : ',';
+        if (std::isspace((unsigned char)c)) continue;
+        
+        if (c == '(')
+        {
+            if (inGroup || name != "fixpoint")
+            {
+                error = "unexpected '(' after '" + name + "'";
+                return false;
+            }
+            group = IrPipelineStep();
+            group.m_fixpoint = true;
+            inGroup = true;
+            name.clear();
+        }
+        else if (c == ',' || c == ')')
+        {
+            if (!name.empty())
+            {
+                if (!isPass(name))
+                {
+                    error = "unknown pass '" + name + "'";
+                    return false;
+                }
+                // each run places the temporaries above the frame the last one left
+                if (inGroup && name == "slots")
+                {
+                    error = "'slots' cannot repeat in a fixpoint group";
+                    return false;
+                }
+                if (inGroup)
+                {
+                    group.m_passes.push_back(name);
+                }
+                else
+                {
+                    IrPipelineStep step;
+                    step.m_passes.push_back(name);
+                    pipeline.push_back(step);
+                }
+                name.clear();
+            }
+            if (c == ')')
+            {
+                if (!inGroup || group.m_passes.empty())
+                {
+                    error = inGroup ? "empty fixpoint group" : "unexpected ')'";
+                    return false;
+                }
+                pipeline.push_back(group);
+                inGroup = false;
+            }
+        }
+        else
+        {
+            name += c;
+        }
+    }
+    if (inGroup)
+    {
+        error = "missing ')'";
+        return false;
+    }
+    return true;
+}
+
+void IrPassManager::run(const IrPipeline& pipeline)
+{
+    bool slotsAssigned = false;
+    for (const auto& step : pipeline)
+    {
+        const int rounds = step.m_fixpoint ? MAX_FIXPOINT_ROUNDS : 1;
+        for (int round = 0; round < rounds; round++)
+        {
+            bool changed = false;
+            for (const auto& name : step.m_passes)
+            {
+                if (runPass(name)) changed = true;
+                if (name == "slots") slotsAssigned = true;
+            }
+            if (!changed) break;
+        }
+    }
+    
+    // code generation needs every temporary in a slot
+    if (!slotsAssigned) runPass("slots");
+}
+
+bool IrPassManager::runPass(const std::string& name)
+{
+    const Pass* pass = findPass(name);
+    if (pass == nullptr) return false;
+    
+    IrScopedTimer timer(name);
+    const auto start = std::chrono::steady_clock::now();
+    const bool changed = pass->m_run(m_optimizer, m_options);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    
+    auto it = std::find_if(m_stats.begin(), m_stats.end(), [&](const IrPassStats& stats) { return stats.m_name == name; });
+    if (it == m_stats.end())
+    {
+        IrPassStats stats;
+        stats.m_name = name;
+        it = m_stats.insert(m_stats.end(), stats);
+    }
+    it->m_runs++;
+    if (changed) it->m_changes++;
+    it->m_seconds += elapsed.count();
+    
+    if (changed && !pass->m_preservesAnalyses) m_optimizer.invalidateAnalyses();
+    return changed;
+}
+
+void IrPassManager::printStats(std::ostream& stream) const
+{
+    double total = 0.0;
+    stream << std::left << std::setw(16) << "pass" << std::right << std::setw(6) << "runs" 
+           << std::setw(9) << "changes" << std::setw(12) << "time (ms)" << std::endl;
+    for (const auto& it : m_stats)
+    {
+        stream << std::left << std::setw(16) << it.m_name << std::right << std::setw(6) << it.m_runs 
+               << std::setw(9) << it.m_changes << std::setw(12) << std::fixed << std::setprecision(3) << it.m_seconds * 1000.0 << std::endl;
+        total += it.m_seconds;
+    }
+    stream << std::left << std::setw(31) << "total" << std::right << std::setw(12) << std::fixed << std::setprecision(3) << total * 1000.0 << std::endl;
+}
+
+} // namespace Decaf
@@ -0,0 +1,91 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include "IrCommon.h"
+#include "IrOptimizer.h"
+
+namespace Decaf
+{
+
+// Settings the passes take from the command line.
+struct IrPassOptions
+{
+    IrBasicBlockOpts m_blockOpts = BBOPTS_ALL;
+    int m_unrollFactor = 4;
+    int m_cloneBudget = 400;
+    // named in the report of the methods and globals dead-decls removes
+    std::string m_sourceName;
+};
+
+// A pass, or a group of passes run in turn until none of them changes the
+// code any more, for a few rounds at most.
+struct IrPipelineStep
+{
+    std::vector<std::string> m_passes;
+    bool m_fixpoint = false;
+};
+
+typedef std::vector<IrPipelineStep> IrPipeline;
+
+struct IrPassStats
+{
+    std::string m_name;
+    int m_runs = 0;
+    int m_changes = 0;
+    double m_seconds = 0.0;
+};
+
+// Runs pipelines of named IrOptimizer passes, e.g. 
+// "const-prop,simplify-cfg,fixpoint(load-store,copy-prop,dce)".  Analyses
+// the optimizer caches are dropped after a pass that changes the code unless 
+// the pass keeps them valid.  Temporaries get their frame slots ("slots") at 
+// the end of a pipeline that does not place them itself.
+class IrPassManager
+{
+public:
+    IrPassManager(IrOptimizer& optimizer, const IrPassOptions& options);
+    
+    // False, with the reason in 'error', for an unknown pass or a malformed list.
+    static bool parsePipeline(const std::string& text, IrPipeline& pipeline, std::string& error);
+    static bool isPass(const std::string& name);
+    static void printPasses(std::ostream& stream);
+    
+    void run(const IrPipeline& pipeline);
+    
+    // Runs, changes and time of each pass, in the order they first ran.
+    const std::vector<IrPassStats>& getStats() const { return m_stats; }
+    void printStats(std::ostream& stream) const;
+    
+private:
+    bool runPass(const std::string& name);
+    
+    IrOptimizer& m_optimizer;
+    IrPassOptions m_options;
+    std::vector<IrPassStats> m_stats;
+};
+
+} // namespace Decaf
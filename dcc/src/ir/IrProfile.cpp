@@ -0,0 +1,459 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+#include "IrIdentifier.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Counters of an instrumented program and the function that writes them out
+// when the program exits.
+const char* const PROFILE_COUNTERS = ".PROFCOUNTS";
+const char* const PROFILE_WRITER = "__dcc_profile_write";
+
+// Measured counts of one function: one per block, in block order, then one per
+// conditional branch for its taken edge.  The fall-through edge is the count of
+// the branch's block less the taken count, so no other edge needs a counter.
+struct FunctionProfile
+{
+    unsigned long m_checksum;
+    std::vector<long> m_counts;
+};
+
+IrTacStmt makeTac(IrOpcode opcode, int lineNo, const IrTacArg& src0, const IrTacArg& src1 = IrTacArg(), const IrTacArg& dst = IrTacArg())
+{
+    IrTacStmt stmt(opcode, lineNo);
+    stmt.m_src0 = src0;
+    stmt.m_src1 = src1;
+    stmt.m_dst = dst;
+    return stmt;
+}
+
+IrTacArg makeLabel(const std::string& name)
+{
+    IrTacArg label;
+    label.buildLabel(name);
+    return label;
+}
+
+IrTacArg makeInteger(long value)
+{
+    IrTacArg literal;
+    literal.buildInteger(value);
+    return literal;
+}
+
+IrTacArg makeSlot(std::ptrdiff_t address)
+{
+    IrTacArg temp;
+    temp.buildTemporary(IrIdentifier::CreateTemporary()->getIdentifier(), address);
+    return temp;
+}
+
+IrTacArg makeCounters()
+{
+    IrTacArg counters;
+    counters.m_usage = IrUsage::Global;
+    counters.m_type = IrArgType::Integer;
+    counters.m_asString = PROFILE_COUNTERS;
+    return counters;
+}
+
+IrTacStmt makeString(const std::string& label, const std::string& value)
+{
+    IrTacStmt stmt(IrOpcode::STRING);
+    stmt.m_src0.buildLabel(label);
+    stmt.m_src1.build(value);
+    return stmt;
+}
+
+bool isConditional(const std::vector<IrTacStmt>& stmts, const IrFlowBlock& block)
+{
+    const IrOpcode opcode = stmts[block.m_last - 1].m_opcode;
+    return (opcode == IrOpcode::IFZ || opcode == IrOpcode::IFNZ) && (block.m_succs.size() == 2);
+}
+
+size_t getNumCounters(const std::vector<IrTacStmt>& stmts, const IrFlowGraph& graph)
+{
+    size_t count = graph.size();
+    for (size_t b = 0; b < graph.size(); b++)
+    {
+        if (isConditional(stmts, graph[b])) count++;
+    }
+    return count;
+}
+
+// FNV-1a hash of the shape of a function's flow graph, so counts are only
+// applied to the code they were measured on.
+unsigned long getChecksum(const std::vector<IrTacStmt>& stmts, const IrFlowGraph& graph)
+{
+    unsigned long hash = 14695981039346656037ul;
+    auto mix = [&hash](unsigned long value) { hash = (hash ^ value) * 1099511628211ul; };
+
+    mix(graph.size());
+    for (size_t b = 0; b < graph.size(); b++)
+    {
+        mix(graph[b].m_last - graph[b].m_first);
+        mix((unsigned long)stmts[graph[b].m_last - 1].m_opcode);
+        for (auto s : graph[b].m_succs)
+        {
+            mix(s);
+        }
+    }
+    return hash;
+}
+
+// Adds one to a counter; the temporaries are fresh but share one frame slot.
+void emitIncrement(size_t counter, size_t numCounters, std::ptrdiff_t slot, int lineNo, std::vector<IrTacStmt>& code)
+{
+    const IrTacArg value = makeSlot(slot);
+    const IrTacArg sum = makeSlot(slot);
+
+    IrTacStmt load = makeTac(IrOpcode::LOAD, lineNo, makeCounters(), makeInteger((long)counter), value);
+    load.m_info = (int)numCounters;
+    code.push_back(load);
+    code.push_back(makeTac(IrOpcode::ADD, lineNo, value, makeInteger(1), sum));
+    IrTacStmt store = makeTac(IrOpcode::STORE, lineNo, sum, makeCounters(), makeInteger((long)counter));
+    store.m_info = (int)numCounters;
+    code.push_back(store);
+}
+
+std::string escapeString(const std::string& value)
+{
+    std::string escaped;
+    for (auto c : value)
+    {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace
+
+bool IrOptimizer::instrumentProfile(const std::string& filename)
+{
+    generateStatements();
+
+    const auto functions = getFunctions(m_statements);
+    if (functions.empty()) return false;
+
+    std::vector<IrFlowGraph> graphs;
+    std::vector<size_t> firstCounter;
+    size_t numCounters = 0;
+    for (auto it : functions)
+    {
+        graphs.push_back(IrFlowGraph(m_statements, it.first, it.second));
+        firstCounter.push_back(numCounters);
+        numCounters += getNumCounters(m_statements, graphs.back());
+    }
+
+    // counters and the strings of the writer go in front of the code
+    std::vector<IrTacStmt> result(m_statements.begin(), m_statements.begin() + functions.front().first);
+    IrTacStmt global(IrOpcode::GLOBAL);
+    global.m_src0 = makeCounters();
+    global.m_info = (int)(numCounters * 8);
+    result.push_back(global);
+
+    const std::string fileLabel = IrIdentifier::CreateLabel()->getIdentifier();
+    const std::string modeLabel = IrIdentifier::CreateLabel()->getIdentifier();
+    const std::string countLabel = IrIdentifier::CreateLabel()->getIdentifier();
+    result.push_back(makeString(fileLabel, escapeString(filename)));
+    result.push_back(makeString(modeLabel, "w"));
+    result.push_back(makeString(countLabel, "%ld\\n"));
+
+    // __dcc_profile_write() prints each function's name, checksum and number of
+    // counters on one line followed by the counters, one per line
+    const IrTacArg file = makeSlot(0);
+    const IrTacArg counter = makeSlot(8);
+    const IrTacArg test = makeSlot(16);
+    const IrTacArg value = makeSlot(24);
+    const IrTacArg done = makeLabel(IrIdentifier::CreateLabel()->getIdentifier());
+
+    std::vector<IrTacStmt> writer;
+    IrTacStmt begin = makeTac(IrOpcode::FBEGIN, 0, makeLabel(PROFILE_WRITER));
+    begin.m_info = 32;
+    writer.push_back(begin);
+    IrTacStmt param = makeTac(IrOpcode::PARAM, 0, makeLabel(fileLabel));
+    writer.push_back(param);
+    param.m_src0 = makeLabel(modeLabel);
+    param.m_info = 1;
+    writer.push_back(param);
+    writer.push_back(makeTac(IrOpcode::CALL, 0, makeLabel("fopen"), file));
+    writer.push_back(makeTac(IrOpcode::EQUAL, 0, file, makeInteger(0), test));
+    writer.push_back(makeTac(IrOpcode::IFNZ, 0, test, done));
+
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        const IrFlowGraph& graph = graphs[f];
+        const std::string& name = m_statements[functions[f].first].m_src0.m_asString;
+        const size_t count = getNumCounters(m_statements, graph);
+
+        const std::string headerLabel = IrIdentifier::CreateLabel()->getIdentifier();
+        result.push_back(makeString(headerLabel, name + " " + std::to_string(getChecksum(m_statements, graph)) + " " + std::to_string(count) + "\\n"));
+
+        const IrTacArg top = makeLabel(IrIdentifier::CreateLabel()->getIdentifier());
+        const IrTacArg next = makeLabel(IrIdentifier::CreateLabel()->getIdentifier());
+
+        param = makeTac(IrOpcode::PARAM, 0, file);
+        writer.push_back(param);
+        param.m_src0 = makeLabel(headerLabel);
+        param.m_info = 1;
+        writer.push_back(param);
+        writer.push_back(makeTac(IrOpcode::CALL, 0, makeLabel("fprintf")));
+
+        writer.push_back(makeTac(IrOpcode::MOV, 0, makeInteger((long)firstCounter[f]), IrTacArg(), counter));
+        writer.push_back(makeTac(IrOpcode::LABEL, 0, top));
+        writer.push_back(makeTac(IrOpcode::LESS, 0, counter, makeInteger((long)(firstCounter[f] + count)), test));
+        writer.push_back(makeTac(IrOpcode::IFZ, 0, test, next));
+        IrTacStmt load = makeTac(IrOpcode::LOAD, 0, makeCounters(), counter, value);
+        load.m_info = (int)numCounters;
+        writer.push_back(load);
+        param = makeTac(IrOpcode::PARAM, 0, file);
+        writer.push_back(param);
+        param.m_src0 = makeLabel(countLabel);
+        param.m_info = 1;
+        writer.push_back(param);
+        param.m_src0 = value;
+        param.m_info = 2;
+        writer.push_back(param);
+        writer.push_back(makeTac(IrOpcode::CALL, 0, makeLabel("fprintf")));
+        writer.push_back(makeTac(IrOpcode::ADD, 0, counter, makeInteger(1), counter));
+        writer.push_back(makeTac(IrOpcode::JUMP, 0, top));
+        writer.push_back(makeTac(IrOpcode::LABEL, 0, next));
+    }
+    writer.push_back(makeTac(IrOpcode::PARAM, 0, file));
+    writer.push_back(makeTac(IrOpcode::CALL, 0, makeLabel("fclose")));
+    writer.push_back(makeTac(IrOpcode::LABEL, 0, done));
+    writer.push_back(makeTac(IrOpcode::RETURN, 0, IrTacArg()));
+
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        const IrFlowGraph& graph = graphs[f];
+        const std::ptrdiff_t slot = getFrameEnd(m_statements, functions[f].first, functions[f].second);
+        const bool isMain = (m_statements[functions[f].first].m_src0.m_asString == "main");
+
+        std::vector<IrTacStmt> code;
+        std::vector<IrTacStmt> edges;
+        size_t taken = firstCounter[f] + graph.size();
+        for (size_t b = 0; b < graph.size(); b++)
+        {
+            const IrFlowBlock& block = graph[b];
+            const int lineNo = m_statements[block.m_first].m_lineNo;
+
+            // counts go after the label, or after the parameters are read
+            size_t at = block.m_first;
+            if (m_statements[at].m_opcode == IrOpcode::LABEL || m_statements[at].m_opcode == IrOpcode::FBEGIN) at++;
+            while (b == 0 && at < block.m_last && m_statements[at].m_opcode == IrOpcode::GETPARAM) at++;
+
+            code.insert(code.end(), m_statements.begin() + block.m_first, m_statements.begin() + at);
+            if (b == 0 && isMain)
+            {
+                // the counters are written out however the program ends
+                code.push_back(makeTac(IrOpcode::PARAM, lineNo, makeLabel(PROFILE_WRITER)));
+                code.push_back(makeTac(IrOpcode::CALL, lineNo, makeLabel("atexit")));
+            }
+            emitIncrement(firstCounter[f] + b, numCounters, slot, lineNo, code);
+            code.insert(code.end(), m_statements.begin() + at, m_statements.begin() + block.m_last);
+
+            // the taken edge of a branch gets a block of its own after the function
+            if (isConditional(m_statements, block))
+            {
+                IrTacStmt& branch = code.back();
+                const IrTacArg target = branch.m_src1;
+                branch.m_src1 = makeLabel(IrIdentifier::CreateLabel()->getIdentifier());
+
+                edges.push_back(makeTac(IrOpcode::LABEL, branch.m_lineNo, branch.m_src1));
+                emitIncrement(taken++, numCounters, slot, branch.m_lineNo, edges);
+                edges.push_back(makeTac(IrOpcode::JUMP, branch.m_lineNo, target));
+            }
+        }
+        code.insert(code.end(), edges.begin(), edges.end());
+
+        code.front().m_info = std::max(code.front().m_info, alignFrameSize(slot + 8));
+        result.insert(result.end(), code.begin(), code.end());
+    }
+    result.insert(result.end(), writer.begin(), writer.end());
+
+    m_statements.swap(result);
+    generateBasicBlocks(m_statements);
+    return true;
+}
+
+bool IrOptimizer::applyProfile(const std::string& filename)
+{
+    std::ifstream input(filename);
+    if (!input)
+    {
+        std::cerr << "warning: cannot read profile '" << filename << "'; optimizing without it." << std::endl;
+        return false;
+    }
+
+    std::map<std::string, FunctionProfile> profiles;
+    std::string name;
+    size_t count = 0;
+    while (input >> name)
+    {
+        FunctionProfile& profile = profiles[name];
+        if (!(input >> profile.m_checksum >> count)) break;
+        profile.m_counts.resize(count);
+        for (auto& it : profile.m_counts)
+        {
+            input >> it;
+        }
+    }
+
+    generateStatements();
+
+    bool applied = false;
+    for (auto it : getFunctions(m_statements))
+    {
+        const IrFlowGraph graph(m_statements, it.first, it.second);
+        const std::string& function = m_statements[it.first].m_src0.m_asString;
+
+        auto profile = profiles.find(function);
+        if (profile == profiles.end())
+        {
+            std::cerr << "warning: profile '" << filename << "' has no counts for " << function << "." << std::endl;
+            continue;
+        }
+        const std::vector<long>& counts = profile->second.m_counts;
+        if (profile->second.m_checksum != getChecksum(m_statements, graph) || counts.size() != getNumCounters(m_statements, graph))
+        {
+            std::cerr << "warning: profile of " << function << " in '" << filename << "' is out of date and was ignored." << std::endl;
+            continue;
+        }
+
+        size_t taken = graph.size();
+        for (size_t b = 0; b < graph.size(); b++)
+        {
+            const IrFlowBlock& block = graph[b];
+            for (size_t k = block.m_first; k < block.m_last; k++)
+            {
+                m_statements[k].m_count = counts[b];
+            }
+            if (isConditional(m_statements, block))
+            {
+                m_statements[block.m_last - 1].m_taken = counts[taken++];
+            }
+        }
+        applied = true;
+    }
+
+    if (applied) generateBasicBlocks(m_statements);
+    return applied;
+}
+
+// Samples are spread over the blocks by source line: a block gets the most
+// samples of any of its lines, the entry at least those of the function.
+// Branches are taken in proportion to the samples of their successors.
+bool IrOptimizer::applySampleProfile(const std::string& filename)
+{
+    std::ifstream input(filename);
+    if (!input)
+    {
+        std::cerr << "warning: cannot read profile '" << filename << "'; optimizing without it." << std::endl;
+        return false;
+    }
+
+    // '<line> <samples>', '<file>:<line> <samples>' or '<function> <samples>'
+    // with the samples at the function's entry; '#' starts a comment
+    std::map<int, long> lines;
+    std::map<std::string, long> functions;
+    std::string text;
+    while (std::getline(input, text))
+    {
+        std::istringstream fields(text.substr(0, text.find('#')));
+        std::string location;
+        long samples = 0;
+        if (!(fields >> location >> samples) || samples < 0) continue;
+
+        const std::string line = location.substr(location.find_last_of(':') + 1);
+        if (!line.empty() && line.find_first_not_of("0123456789") == std::string::npos)
+            lines[std::stoi(line)] += samples;
+        else
+            functions[location] += samples;
+    }
+
+    generateStatements();
+
+    bool applied = false;
+    for (auto it : getFunctions(m_statements))
+    {
+        const IrFlowGraph graph(m_statements, it.first, it.second);
+        const std::string& function = m_statements[it.first].m_src0.m_asString;
+
+        std::vector<long> counts(graph.size(), 0);
+        bool sampled = false;
+        for (size_t b = 0; b < graph.size(); b++)
+        {
+            for (size_t k = graph[b].m_first; k < graph[b].m_last; k++)
+            {
+                auto samples = lines.find(m_statements[k].m_lineNo);
+                if (samples == lines.end()) continue;
+                counts[b] = std::max(counts[b], samples->second);
+                sampled = true;
+            }
+        }
+        auto entry = functions.find(function);
+        if (entry != functions.end())
+        {
+            counts[0] = std::max(counts[0], entry->second);
+            sampled = true;
+        }
+        if (!sampled) continue;
+        counts[0] = std::max(counts[0], 1l);
+
+        for (size_t b = 0; b < graph.size(); b++)
+        {
+            const IrFlowBlock& block = graph[b];
+            for (size_t k = block.m_first; k < block.m_last; k++)
+            {
+                m_statements[k].m_count = counts[b];
+            }
+            const long successors = isConditional(m_statements, block) ? counts[block.m_succs[0]] + counts[block.m_succs[1]] : 0;
+            if (successors > 0)
+            {
+                m_statements[block.m_last - 1].m_taken = (long)((double)counts[b] * counts[block.m_succs[1]] / successors + 0.5);
+            }
+        }
+        applied = true;
+    }
+
+    if (applied)
+        generateBasicBlocks(m_statements);
+    else
+        std::cerr << "warning: profile '" << filename << "' has no samples for this program." << std::endl;
+    return applied;
+}
+
+} // namespace Decaf
@@ -0,0 +1,379 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrCallSummary.h"
+#include "IrFlowGraph.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Call of a pure method with a result: its parameters are [m_params, m_call).
+struct PureCall
+{
+    size_t m_params;
+    size_t m_call;
+    std::string m_key;
+    std::vector<std::string> m_args;
+};
+
+bool getPureCall(const std::vector<IrTacStmt>& stmts, size_t first, size_t n, const IrCallSummary& summary, PureCall& call)
+{
+    const IrTacStmt& stmt = stmts[n];
+    if (stmt.m_opcode != IrOpcode::CALL || !stmt.m_src1.isMemory() || !summary.isPure(stmt.m_src0.m_asString)) return false;
+    
+    size_t params = n;
+    while (params > first && stmts[params - 1].m_opcode == IrOpcode::PARAM) params--;
+    
+    call.m_params = params;
+    call.m_call = n;
+    call.m_key = stmt.m_src0.m_asString + "(";
+    call.m_args.clear();
+    for (size_t k = params; k < n; k++)
+    {
+        const IrTacArg& arg = stmts[k].m_src0;
+        call.m_args.push_back(getOperandKey(arg));
+        call.m_key += " " + call.m_args.back() + ":" + std::to_string((int)arg.m_type);
+    }
+    call.m_key += " )";
+    return true;
+}
+
+// Result of an earlier call, still held by the variable it was returned in.
+struct AvailableCall
+{
+    IrTacStmt m_call;
+    std::vector<std::string> m_args;
+    IrTacArg m_holder;
+};
+
+// Available calls, keyed by callee and arguments.
+typedef std::map<std::string, AvailableCall> CallMap;
+
+// A call stops being available when an argument or its holder changes, or
+// when something the callee reads is written.
+void transfer(const std::vector<IrTacStmt>& stmts, size_t first, size_t n, const IrCallSummary& summary, CallMap& calls)
+{
+    const IrTacStmt& stmt = stmts[n];
+    const IrTacArg* def = getDefinedVariable(stmt);
+    const std::string defKey = (def != nullptr) ? getOperandKey(*def) : "";
+    for (auto it = calls.begin(); it != calls.end();)
+    {
+        const AvailableCall& call = it->second;
+        bool killed = false;
+        if (stmt.m_opcode == IrOpcode::CALL || stmt.m_opcode == IrOpcode::PARFOR)
+            killed = summary.mayChangeInputs(stmt, call.m_call.m_src0.m_asString);
+        else if (stmt.m_opcode == IrOpcode::STORE)
+            killed = summary.mayRead(call.m_call, stmt.m_src1.m_asString);
+        if (def != nullptr)
+        {
+            killed |= (getOperandKey(call.m_holder) == defKey) || 
+                      (std::find(call.m_args.begin(), call.m_args.end(), defKey) != call.m_args.end()) ||
+                      (def->m_usage == IrUsage::Global && summary.mayRead(call.m_call, def->m_asString));
+        }
+        if (killed)
+            it = calls.erase(it);
+        else
+            ++it;
+    }
+    
+    PureCall call;
+    if (getPureCall(stmts, first, n, summary, call) && 
+        std::find(call.m_args.begin(), call.m_args.end(), defKey) == call.m_args.end())
+    {
+        calls[call.m_key] = AvailableCall{ stmt, call.m_args, stmt.m_src1 };
+    }
+}
+
+// Replaces calls of pure methods made earlier with the same arguments, on
+// every path, by a copy of the earlier result:
+//   CALL f, x; ...; CALL f, y  =>  CALL f, x; ...; MOV x, y
+class RedundantCalls
+{
+public:
+    RedundantCalls(std::vector<IrTacStmt>& stmts, size_t first, size_t last, const IrCallSummary& summary) :
+        m_stmts(stmts),
+        m_first(first),
+        m_summary(summary),
+        m_graph(stmts, first, last),
+        m_visited(m_graph.size(), false),
+        m_out(m_graph.size())
+    {}
+    
+    void solve();
+    bool rewrite(std::vector<bool>& removed);
+    
+private:
+    CallMap getIn(size_t b) const;
+    
+    std::vector<IrTacStmt>& m_stmts;
+    const size_t m_first;
+    const IrCallSummary& m_summary;
+    IrFlowGraph m_graph;
+    std::vector<bool> m_visited;
+    std::vector<CallMap> m_out;
+};
+
+// Calls available in the same holder on every visited path into the block.
+CallMap RedundantCalls::getIn(size_t b) const
+{
+    CallMap in;
+    if (b == 0) return in;
+    
+    bool first = true;
+    for (auto p : m_graph[b].m_preds)
+    {
+        if (!m_visited[p]) continue;
+        if (first)
+        {
+            in = m_out[p];
+            first = false;
+            continue;
+        }
+        for (auto it = in.begin(); it != in.end();)
+        {
+            auto ip = m_out[p].find(it->first);
+            if (ip == m_out[p].end() || getOperandKey(ip->second.m_holder) != getOperandKey(it->second.m_holder))
+                it = in.erase(it);
+            else
+                ++it;
+        }
+    }
+    return in;
+}
+
+void RedundantCalls::solve()
+{
+    const std::vector<size_t> order = m_graph.reversePostorder();
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto b : order)
+        {
+            CallMap calls = getIn(b);
+            for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+            {
+                transfer(m_stmts, m_first, n, m_summary, calls);
+            }
+            if (!m_visited[b] || calls.size() != m_out[b].size() || 
+                !std::equal(calls.begin(), calls.end(), m_out[b].begin(), [](const CallMap::value_type& a, const CallMap::value_type& b) {
+                    return (a.first == b.first) && (getOperandKey(a.second.m_holder) == getOperandKey(b.second.m_holder));
+                }))
+            {
+                m_out[b].swap(calls);
+                m_visited[b] = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool RedundantCalls::rewrite(std::vector<bool>& removed)
+{
+    bool changed = false;
+    for (size_t b = 0; b < m_graph.size(); b++)
+    {
+        if (!m_visited[b]) continue;
+        
+        CallMap calls = getIn(b);
+        for (size_t n = m_graph[b].m_first; n < m_graph[b].m_last; n++)
+        {
+            PureCall call;
+            if (getPureCall(m_stmts, m_first, n, m_summary, call))
+            {
+                IrTacStmt& stmt = m_stmts[n];
+                auto it = calls.find(call.m_key);
+                if (it != calls.end() && it->second.m_holder.m_type == stmt.m_src1.m_type)
+                {
+                    IrTacStmt copy(IrOpcode::MOV, stmt.m_lineNo);
+                    copy.m_src0 = it->second.m_holder;
+                    copy.m_dst = stmt.m_src1;
+                    copy.m_count = stmt.m_count;
+                    stmt = copy;
+                    std::fill(removed.begin() + (call.m_params - m_first), removed.begin() + (n - m_first), true);
+                    changed = true;
+                }
+            }
+            transfer(m_stmts, m_first, n, m_summary, calls);
+        }
+    }
+    return changed;
+}
+
+// Blocks of the natural loop of the back edge from 'tail' to 'header', or
+// nothing when the header does not dominate the tail.
+std::set<size_t> getLoopBlocks(const IrFlowGraph& graph, size_t header, size_t tail)
+{
+    std::set<size_t> blocks = { header };
+    std::vector<size_t> work = { tail };
+    while (!work.empty())
+    {
+        const size_t b = work.back();
+        work.pop_back();
+        if (!blocks.insert(b).second) continue;
+        if (b == 0) return std::set<size_t>();
+        work.insert(work.end(), graph[b].m_preds.begin(), graph[b].m_preds.end());
+    }
+    return blocks;
+}
+
+// True when nothing in the loop changes what the call computes.
+bool isInvariant(const std::vector<IrTacStmt>& stmts, const IrFlowGraph& graph, const std::set<size_t>& loop, 
+                 const PureCall& call, const IrCallSummary& summary)
+{
+    const IrTacStmt& callStmt = stmts[call.m_call];
+    for (auto b : loop)
+    {
+        for (size_t n = graph[b].m_first; n < graph[b].m_last; n++)
+        {
+            const IrTacStmt& stmt = stmts[n];
+            if (n == call.m_call) continue;
+            if (stmt.m_opcode == IrOpcode::PARFOR) return false;
+            if (stmt.m_opcode == IrOpcode::CALL && summary.mayChangeInputs(stmt, callStmt.m_src0.m_asString)) return false;
+            if (stmt.m_opcode == IrOpcode::STORE && summary.mayRead(callStmt, stmt.m_src1.m_asString)) return false;
+            
+            const IrTacArg* def = getDefinedVariable(stmt);
+            if (def == nullptr) continue;
+            if (getOperandKey(*def) == getOperandKey(callStmt.m_src1)) return false;
+            if (std::find(call.m_args.begin(), call.m_args.end(), getOperandKey(*def)) != call.m_args.end()) return false;
+            if (def->m_usage == IrUsage::Global && summary.mayRead(callStmt, def->m_asString)) return false;
+        }
+    }
+    return true;
+}
+
+// Moves one call of a pure method that cannot fail or loop, with loop
+// invariant arguments, from a loop to the end of the single block entering
+// it.  Outer loops come first in reverse postorder, so a call leaves as many
+// loops as it can at once.  Its result must be a temporary set only there.
+bool hoistInvariantCall(std::vector<IrTacStmt>& stmts, size_t first, size_t last, const IrCallSummary& summary)
+{
+    const IrFlowGraph graph(stmts, first, last);
+    const std::vector<size_t> order = graph.reversePostorder();
+    std::vector<size_t> position(graph.size(), graph.size());
+    for (size_t k = 0; k < order.size(); k++)
+    {
+        position[order[k]] = k;
+    }
+    
+    std::map<std::string, int> defs;
+    for (size_t n = first; n < last; n++)
+    {
+        const IrTacArg* def = getDefinedVariable(stmts[n]);
+        if (def != nullptr && isCompilerTemporary(*def)) defs[def->m_asString]++;
+    }
+    
+    for (auto header : order)
+    {
+        for (auto tail : graph[header].m_preds)
+        {
+            if (position[tail] < position[header] || position[tail] == graph.size()) continue;
+            const std::set<size_t> loop = getLoopBlocks(graph, header, tail);
+            if (loop.empty()) continue;
+            
+            std::vector<size_t> entries;
+            for (auto p : graph[header].m_preds)
+            {
+                if (loop.count(p) == 0 && position[p] != graph.size()) entries.push_back(p);
+            }
+            if (entries.size() != 1) continue;
+            const IrOpcode exit = stmts[graph[entries[0]].m_last - 1].m_opcode;
+            if (exit == IrOpcode::IFZ || exit == IrOpcode::IFNZ || exit == IrOpcode::RETURN) continue;
+            size_t insert = graph[entries[0]].m_last - ((exit == IrOpcode::JUMP) ? 1 : 0);
+            
+            for (auto b : loop)
+            {
+                for (size_t n = graph[b].m_first; n < graph[b].m_last; n++)
+                {
+                    PureCall call;
+                    if (!getPureCall(stmts, first, n, summary, call)) continue;
+                    const IrTacStmt& stmt = stmts[n];
+                    if (!summary.isSpeculatable(stmt.m_src0.m_asString) || !isCompilerTemporary(stmt.m_src1) || 
+                        defs[stmt.m_src1.m_asString] != 1 || call.m_params < graph[b].m_first || 
+                        !isInvariant(stmts, graph, loop, call, summary))
+                        continue;
+                    
+                    std::vector<IrTacStmt> moved(stmts.begin() + call.m_params, stmts.begin() + n + 1);
+                    stmts.erase(stmts.begin() + call.m_params, stmts.begin() + n + 1);
+                    if (insert > n) insert -= moved.size();
+                    stmts.insert(stmts.begin() + insert, moved.begin(), moved.end());
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// Calls of pure methods (see IrCallSummary) are common subexpressions of
+// their arguments and the globals they read.
+bool IrOptimizer::pureCallElimination()
+{
+    generateStatements();
+    
+    bool changed = false;
+    const IrCallSummary& summary = getCallSummary();
+    for (auto it : getFunctions(m_statements))
+    {
+        while (hoistInvariantCall(m_statements, it.first, it.second, summary))
+        {
+            changed = true;
+        }
+    }
+    
+    std::vector<bool> removed(m_statements.size(), false);
+    for (auto it : getFunctions(m_statements))
+    {
+        RedundantCalls function(m_statements, it.first, it.second, summary);
+        function.solve();
+        std::vector<bool> functionRemoved(it.second - it.first, false);
+        if (function.rewrite(functionRemoved)) changed = true;
+        std::copy(functionRemoved.begin(), functionRemoved.end(), removed.begin() + it.first);
+    }
+    
+    if (changed)
+    {
+        std::vector<IrTacStmt> remaining;
+        remaining.reserve(m_statements.size());
+        for (size_t n = 0; n < m_statements.size(); n++)
+        {
+            if (!removed[n]) remaining.push_back(m_statements[n]);
+        }
+        m_statements.swap(remaining);
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
@@ -24,6 +24,7 @@
 #include "IrReturnStmt.h"
 #include "IrLiteral.h"
 #include "IrLocation.h"
+#include "IrParallelForStmt.h"
 #include "IrTravCtx.h"
 
 namespace Decaf
@@ -54,6 +55,13 @@ bool IrReturnStatement::analyze(IrTraversalContext* ctx)
     if (m_returnValue)
         valid = m_returnValue->analyze(ctx);
     
+    // Rule: parallel loop bodies run in a separate function.
+    if (IrParallelForStatement::FindEnclosing(ctx) != nullptr)
+    {
+        ctx->error(this, "return statement not allowed in a parallel for loop.");
+        valid = false;
+    }
+    
     ctx->popParent();
     
     return valid;
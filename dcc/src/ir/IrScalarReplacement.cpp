@@ -0,0 +1,279 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Largest array split into scalars.
+const int MAX_REPLACED_ELEMENTS = 16;
+
+// A global array that only one function reads and writes, always at
+// literal indices in range.
+struct ReplacedArray
+{
+    IrTacArg m_base;
+    size_t m_function;
+    int m_count;
+    IrArgType m_type;
+    std::vector<bool> m_stored;
+    std::vector<IrTacArg> m_scalars;
+};
+
+const IrTacArg* getArrayBase(const IrTacStmt& stmt)
+{
+    if (stmt.m_opcode == IrOpcode::LOAD) return &stmt.m_src0;
+    if (stmt.m_opcode == IrOpcode::STORE) return &stmt.m_src1;
+    return nullptr;
+}
+
+const IrTacArg* getArrayIndex(const IrTacStmt& stmt)
+{
+    if (stmt.m_opcode == IrOpcode::LOAD) return &stmt.m_src1;
+    if (stmt.m_opcode == IrOpcode::STORE) return &stmt.m_dst;
+    return nullptr;
+}
+
+// Functions that may call themselves, directly or through others.  Any
+// function name in a function counts as a call (parallel loop bodies are
+// passed to the runtime by name).
+std::vector<bool> findRecursiveFunctions(const std::vector<IrTacStmt>& stmts, const std::vector<std::pair<size_t, size_t>>& functions)
+{
+    std::map<std::string, size_t> index;
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        index[stmts[functions[f].first].m_src0.m_asString] = f;
+    }
+    
+    std::vector<std::set<size_t>> callees(functions.size());
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        for (size_t n = functions[f].first + 1; n < functions[f].second; n++)
+        {
+            for (auto arg : { &stmts[n].m_src0, &stmts[n].m_src1, &stmts[n].m_dst })
+            {
+                if (arg->m_usage == IrUsage::Unused || arg->isLiteral()) continue;
+                auto it = index.find(arg->m_asString);
+                if (it != index.end()) callees[f].insert(it->second);
+            }
+        }
+    }
+    
+    std::vector<bool> recursive(functions.size(), false);
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        std::vector<bool> reached(functions.size(), false);
+        std::vector<size_t> work(callees[f].begin(), callees[f].end());
+        while (!work.empty() && !recursive[f])
+        {
+            const size_t g = work.back();
+            work.pop_back();
+            if (reached[g]) continue;
+            reached[g] = true;
+            recursive[f] = (g == f);
+            work.insert(work.end(), callees[g].begin(), callees[g].end());
+        }
+    }
+    return recursive;
+}
+
+// Arrays that can live in scalars, keyed by name.
+std::map<std::string, ReplacedArray> findReplaceableArrays(const std::vector<IrTacStmt>& stmts, const std::vector<std::pair<size_t, size_t>>& functions)
+{
+    std::map<std::string, ReplacedArray> arrays;
+    std::set<std::string> rejected;
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        for (size_t n = functions[f].first; n < functions[f].second; n++)
+        {
+            const IrTacStmt& stmt = stmts[n];
+            const IrTacArg* base = getArrayBase(stmt);
+            if (base != nullptr && base->m_usage == IrUsage::Global)
+            {
+                const IrTacArg* index = getArrayIndex(stmt);
+                const bool constant = isIntLiteral(*index) && index->m_value.m_int >= 0 && index->m_value.m_int < stmt.m_info;
+                auto it = arrays.emplace(base->m_asString, ReplacedArray{ *base, f, stmt.m_info, IrArgType::Integer, {}, {} }).first;
+                if (!constant || it->second.m_function != f || stmt.m_info > MAX_REPLACED_ELEMENTS)
+                    rejected.insert(base->m_asString);
+                
+                it->second.m_type = (stmt.m_opcode == IrOpcode::LOAD) ? stmt.m_dst.m_type : stmt.m_src0.m_type;
+                continue;
+            }
+            
+            // an array named anywhere else escapes
+            for (auto arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+            {
+                if (arg->m_usage == IrUsage::Global || arg->m_usage == IrUsage::Label) rejected.insert(arg->m_asString);
+            }
+        }
+    }
+    
+    const std::vector<bool> recursive = findRecursiveFunctions(stmts, functions);
+    for (auto it = arrays.begin(); it != arrays.end();)
+    {
+        if (rejected.count(it->first) != 0 || recursive[it->second.m_function])
+            it = arrays.erase(it);
+        else
+            ++it;
+    }
+    return arrays;
+}
+
+} // namespace
+
+// Small global arrays used by a single function become locals of that
+// function, one per element, loaded on entry and stored back before each
+// return:
+//   LOAD a, 2, x  =>  MOV a[2], x
+//   STORE x, a, 2  =>  MOV x, a[2]
+// Constant and copy propagation then see through the elements, and the
+// bounds checks go away.  The elements live across blocks, so they are named
+// like user variables; the basic-block optimizations take '.LC' temporaries
+// to be local to one block.  The function may not recurse, otherwise the
+// array would be shared between activations.
+bool IrOptimizer::scalarReplacement()
+{
+    generateStatements();
+    
+    const auto functions = getFunctions(m_statements);
+    std::map<std::string, ReplacedArray> arrays = findReplaceableArrays(m_statements, functions);
+    if (arrays.empty()) return false;
+    
+    std::vector<std::ptrdiff_t> frameEnds(functions.size());
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        frameEnds[f] = getFrameEnd(m_statements, functions[f].first, functions[f].second);
+    }
+    for (auto& it : arrays)
+    {
+        ReplacedArray& array = it.second;
+        array.m_stored.assign(array.m_count, false);
+        array.m_scalars.resize(array.m_count);
+        for (int k = 0; k < array.m_count; k++)
+        {
+            array.m_scalars[k].buildTemporary(it.first + "[" + std::to_string(k) + "]", frameEnds[array.m_function], array.m_type);
+            frameEnds[array.m_function] += 8;
+        }
+    }
+    
+    std::vector<IrTacStmt> result;
+    result.reserve(m_statements.size());
+    result.insert(result.end(), m_statements.begin(), m_statements.begin() + functions.front().first);
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        const size_t first = functions[f].first;
+        const size_t last = functions[f].second;
+        std::vector<std::pair<std::string, ReplacedArray*>> replaced;
+        for (auto& it : arrays)
+        {
+            if (it.second.m_function == f) replaced.push_back(std::make_pair(it.first, &it.second));
+        }
+        if (replaced.empty())
+        {
+            result.insert(result.end(), m_statements.begin() + first, m_statements.begin() + last);
+            continue;
+        }
+        
+        // elements written by the function are written back for its next call
+        for (size_t n = first; n < last; n++)
+        {
+            if (m_statements[n].m_opcode != IrOpcode::STORE) continue;
+            for (auto& it : replaced)
+            {
+                if (it.first == m_statements[n].m_src1.m_asString) it.second->m_stored[m_statements[n].m_dst.m_value.m_int] = true;
+            }
+        }
+        const bool isMain = (m_statements[first].m_src0.m_asString == "main");
+        
+        size_t n = first;
+        IrTacStmt begin = m_statements[n++];
+        begin.m_info = std::max(begin.m_info, alignFrameSize(frameEnds[f]));
+        result.push_back(begin);
+        while (n < last && m_statements[n].m_opcode == IrOpcode::GETPARAM)
+        {
+            result.push_back(m_statements[n++]);
+        }
+        for (auto& it : replaced)
+        {
+            for (int k = 0; k < it.second->m_count; k++)
+            {
+                IrTacStmt load(IrOpcode::LOAD, begin.m_lineNo);
+                load.m_src0 = it.second->m_base;
+                load.m_src1.buildInteger(k);
+                load.m_dst = it.second->m_scalars[k];
+                load.m_info = it.second->m_count;
+                result.push_back(load);
+            }
+        }
+        
+        for (; n < last; n++)
+        {
+            const IrTacStmt& stmt = m_statements[n];
+            if (stmt.m_opcode == IrOpcode::RETURN && !isMain)
+            {
+                for (auto& it : replaced)
+                {
+                    for (int k = 0; k < it.second->m_count; k++)
+                    {
+                        if (!it.second->m_stored[k]) continue;
+                        IrTacStmt store(IrOpcode::STORE, stmt.m_lineNo);
+                        store.m_src0 = it.second->m_scalars[k];
+                        store.m_src1 = it.second->m_base;
+                        store.m_dst.buildInteger(k);
+                        store.m_info = it.second->m_count;
+                        result.push_back(store);
+                    }
+                }
+            }
+            
+            const IrTacArg* base = getArrayBase(stmt);
+            auto it = (base != nullptr) ? arrays.find(base->m_asString) : arrays.end();
+            if (it == arrays.end() || base->m_usage != IrUsage::Global)
+            {
+                result.push_back(stmt);
+                continue;
+            }
+            
+            const IrTacArg& scalar = it->second.m_scalars[getArrayIndex(stmt)->m_value.m_int];
+            IrTacStmt copy(IrOpcode::MOV, stmt.m_lineNo);
+            copy.m_src0 = (stmt.m_opcode == IrOpcode::LOAD) ? scalar : stmt.m_src0;
+            copy.m_dst = (stmt.m_opcode == IrOpcode::LOAD) ? stmt.m_dst : scalar;
+            result.push_back(copy);
+        }
+    }
+    
+    m_statements.swap(result);
+    generateBasicBlocks(m_statements);
+    return true;
+}
+
+} // namespace Decaf
@@ -0,0 +1,342 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "IrOptimizer.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Execution units of a generic modern x86-64 core, as far as the code of one
+// statement keeps them busy.
+enum class Unit : int
+{
+    ALU,
+    MUL,
+    DIV,
+    LOAD,
+    STORE,
+    FP,
+    FPDIV,
+    NUM_UNITS
+};
+
+// ports per unit; the dividers are not pipelined
+const int UNIT_PORTS[(int)Unit::NUM_UNITS] = { 4, 1, 1, 2, 1, 2, 1 };
+const int ISSUE_WIDTH = 4;
+// every result goes through its frame slot, so a reader waits for the store
+// to be forwarded as well
+const int STORE_FORWARD = 4;
+
+struct Timing
+{
+    Unit m_unit;
+    int m_latency;
+    // cycles before the port takes the next statement
+    int m_occupancy;
+};
+
+Timing getTiming(const IrTacStmt& stmt)
+{
+    const bool isDouble = stmt.m_dst.isDouble();
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::LOAD:
+            return Timing{Unit::LOAD, 5, 1};
+        case IrOpcode::STORE:
+            return Timing{Unit::STORE, 1, 1};
+        case IrOpcode::ADD:
+        case IrOpcode::SUB:
+            return isDouble ? Timing{Unit::FP, 4, 1} : Timing{Unit::ALU, 1, 1};
+        case IrOpcode::MUL:
+            return isDouble ? Timing{Unit::FP, 4, 1} : Timing{Unit::MUL, 3, 1};
+        case IrOpcode::DIV:
+        case IrOpcode::MOD:
+            return isDouble ? Timing{Unit::FPDIV, 14, 4} : Timing{Unit::DIV, 26, 10};
+        case IrOpcode::MIN:
+        case IrOpcode::MAX:
+        case IrOpcode::MOVZ:
+        case IrOpcode::MOVNZ:
+            return Timing{Unit::ALU, 2, 1};
+        default:
+            break;
+    }
+    if (isComparisonOp(stmt.m_opcode))
+        return (stmt.m_src0.isDouble() || stmt.m_src1.isDouble()) ? Timing{Unit::FP, 3, 1} : Timing{Unit::ALU, 2, 1};
+    return Timing{Unit::ALU, 1, 1};
+}
+
+// Statements that only compute into variables.  Everything else (labels,
+// branches, calls and their parameters) stays where it is and bounds the
+// stretches that are scheduled.
+bool isSchedulable(const IrTacStmt& stmt)
+{
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::MOV:
+        case IrOpcode::LOAD:
+        case IrOpcode::STORE:
+        case IrOpcode::MIN:
+        case IrOpcode::MAX:
+        case IrOpcode::MOVZ:
+        case IrOpcode::MOVNZ:
+            return true;
+        default:
+            break;
+    }
+    return isBinaryOp(stmt.m_opcode) || isComparisonOp(stmt.m_opcode) || isLogicOp(stmt.m_opcode);
+}
+
+// Failed bounds checks and integer division by zero end the program; these
+// keep their order so the same error is reported.
+bool mayFault(const IrTacStmt& stmt)
+{
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::LOAD:
+        case IrOpcode::STORE:
+            return true;
+        case IrOpcode::DIV:
+        case IrOpcode::MOD:
+            return !stmt.m_dst.isDouble();
+        default:
+            break;
+    }
+    return false;
+}
+
+struct Node
+{
+    std::vector<std::string> m_uses;
+    std::vector<std::string> m_defs;
+    Timing m_timing;
+    // (successor, cycles it has to wait)
+    std::vector<std::pair<size_t, int>> m_succs;
+    int m_preds = 0;
+    int m_height = 0;
+    int m_earliest = 0;
+};
+
+bool intersects(const std::vector<std::string>& a, const std::vector<std::string>& b)
+{
+    for (const auto& it : a)
+    {
+        if (std::find(b.begin(), b.end(), it) != b.end()) return true;
+    }
+    return false;
+}
+
+class ListScheduler
+{
+public:
+    ListScheduler(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, bool allocated);
+    
+    // New order of the statements, as offsets from 'first'.
+    std::vector<size_t> run();
+    
+private:
+    std::string getKey(const IrTacArg& arg) const;
+    void addEdge(size_t from, size_t to, int delay);
+    bool isBefore(size_t a, size_t b) const;
+    
+    const bool m_allocated;
+    std::vector<Node> m_nodes;
+};
+
+ListScheduler::ListScheduler(const std::vector<IrTacStmt>& stmts, size_t first, size_t last, bool allocated) :
+    m_allocated(allocated),
+    m_nodes(last - first)
+{
+    std::vector<const IrTacArg*> used;
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+        const IrTacStmt& stmt = stmts[first + i];
+        Node& node = m_nodes[i];
+        node.m_timing = getTiming(stmt);
+        
+        getUsedVariables(stmt, used);
+        for (auto arg : used)
+        {
+            node.m_uses.push_back(getKey(*arg));
+        }
+        const IrTacArg* def = getDefinedVariable(stmt);
+        if (def != nullptr) node.m_defs.push_back(getKey(*def));
+        
+        // array elements are told apart by array only
+        if (stmt.m_opcode == IrOpcode::LOAD) node.m_uses.push_back("[" + getVariableKey(stmt.m_src0));
+        if (stmt.m_opcode == IrOpcode::STORE) node.m_defs.push_back("[" + getVariableKey(stmt.m_src1));
+    }
+    
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+        for (size_t j = 0; j < i; j++)
+        {
+            const Node& earlier = m_nodes[j];
+            const Node& later = m_nodes[i];
+            if (intersects(earlier.m_defs, later.m_uses))
+                addEdge(j, i, earlier.m_timing.m_latency + STORE_FORWARD);
+            else if (intersects(earlier.m_uses, later.m_defs) || intersects(earlier.m_defs, later.m_defs) ||
+                     (mayFault(stmts[first + j]) && mayFault(stmts[first + i])))
+                addEdge(j, i, 0);
+        }
+    }
+    
+    // longest path to the end of the stretch
+    for (size_t i = m_nodes.size(); i-- > 0; )
+    {
+        Node& node = m_nodes[i];
+        node.m_height = node.m_timing.m_latency;
+        for (auto it : node.m_succs)
+        {
+            node.m_height = std::max(node.m_height, it.second + m_nodes[it.first].m_height);
+        }
+    }
+}
+
+// Temporaries are told apart by name until they share frame slots.
+std::string ListScheduler::getKey(const IrTacArg& arg) const
+{
+    return (!m_allocated && isCompilerTemporary(arg)) ? arg.m_asString : getVariableKey(arg);
+}
+
+void ListScheduler::addEdge(size_t from, size_t to, int delay)
+{
+    m_nodes[from].m_succs.push_back(std::make_pair(to, delay));
+    m_nodes[to].m_preds++;
+}
+
+// Longest path to the end first, then source order.
+bool ListScheduler::isBefore(size_t a, size_t b) const
+{
+    if (m_nodes[a].m_height != m_nodes[b].m_height) return m_nodes[a].m_height > m_nodes[b].m_height;
+    return a < b;
+}
+
+// Cycle by cycle, the ready statement with the longest path to the end issues
+// first, as long as the issue width and its unit allow.
+std::vector<size_t> ListScheduler::run()
+{
+    std::vector<size_t> order;
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+        if (m_nodes[i].m_preds == 0) ready.push_back(i);
+    }
+    
+    std::vector<std::vector<int>> portFree((int)Unit::NUM_UNITS);
+    for (int u = 0; u < (int)Unit::NUM_UNITS; u++)
+    {
+        portFree[u].assign(UNIT_PORTS[u], 0);
+    }
+    
+    int cycle = 0;
+    while (order.size() < m_nodes.size())
+    {
+        std::sort(ready.begin(), ready.end(), [this](size_t a, size_t b) { return isBefore(a, b); });
+        
+        int issued = 0;
+        for (size_t r = 0; r < ready.size() && issued < ISSUE_WIDTH; )
+        {
+            const size_t i = ready[r];
+            Node& node = m_nodes[i];
+            std::vector<int>& ports = portFree[(int)node.m_timing.m_unit];
+            auto port = std::min_element(ports.begin(), ports.end());
+            if (node.m_earliest > cycle || *port > cycle)
+            {
+                r++;
+                continue;
+            }
+            
+            *port = cycle + node.m_timing.m_occupancy;
+            order.push_back(i);
+            issued++;
+            ready.erase(ready.begin() + r);
+            for (auto it : node.m_succs)
+            {
+                Node& succ = m_nodes[it.first];
+                succ.m_earliest = std::max(succ.m_earliest, cycle + it.second);
+                // statements that only have to follow may issue in the same cycle
+                if (--succ.m_preds == 0) ready.push_back(it.first);
+            }
+            r = 0;
+            std::sort(ready.begin(), ready.end(), [this](size_t a, size_t b) { return isBefore(a, b); });
+        }
+        cycle++;
+    }
+    return order;
+}
+
+} // namespace
+
+// Local list scheduling: each stretch of straight-line computation between
+// labels, branches and calls is reordered so long latency statements (loads,
+// multiplies and divides) start early and independent work fills their
+// shadow.  Before the frame slots are assigned ('allocated' false) only true
+// dependences constrain the order; afterwards temporaries sharing a slot do
+// as well.
+bool IrOptimizer::scheduleInstructions(bool allocated)
+{
+    generateStatements();
+    
+    bool changed = false;
+    size_t n = 0;
+    while (n < m_statements.size())
+    {
+        if (!isSchedulable(m_statements[n]))
+        {
+            n++;
+            continue;
+        }
+        size_t last = n;
+        while (last < m_statements.size() && isSchedulable(m_statements[last]))
+        {
+            last++;
+        }
+        
+        if (last - n > 1)
+        {
+            ListScheduler scheduler(m_statements, n, last, allocated);
+            const std::vector<size_t> order = scheduler.run();
+            std::vector<IrTacStmt> stretch;
+            stretch.reserve(order.size());
+            for (size_t k = 0; k < order.size(); k++)
+            {
+                stretch.push_back(m_statements[n + order[k]]);
+                if (order[k] != k) changed = true;
+            }
+            std::copy(stretch.begin(), stretch.end(), m_statements.begin() + n);
+        }
+        n = last;
+    }
+    
+    generateBasicBlocks(m_statements);
+    return changed;
+}
+
+} // namespace Decaf
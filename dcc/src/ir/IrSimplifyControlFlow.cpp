@@ -0,0 +1,200 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Labels in the run of LABEL statements starting at n.
+bool isLabelAt(const std::vector<IrTacStmt>& stmts, size_t n, const std::string& label)
+{
+    for (; n < stmts.size() && stmts[n].m_opcode == IrOpcode::LABEL; n++)
+    {
+        if (stmts[n].m_src0.m_asString == label) return true;
+    }
+    return false;
+}
+
+// Drop the blocks no path from the function entry reaches.
+bool removeUnreachableBlocks(std::vector<IrTacStmt>& stmts)
+{
+    const auto functions = getFunctions(stmts);
+    if (functions.empty()) return false;
+    
+    bool changed = false;
+    std::vector<IrTacStmt> reachable;
+    reachable.reserve(stmts.size());
+    reachable.insert(reachable.end(), stmts.begin(), stmts.begin() + functions.front().first);
+    for (auto it : functions)
+    {
+        const IrFlowGraph graph(stmts, it.first, it.second);
+        std::vector<bool> keep(graph.size(), false);
+        for (auto b : graph.reversePostorder())
+        {
+            keep[b] = true;
+        }
+        for (size_t b = 0; b < graph.size(); b++)
+        {
+            if (keep[b])
+                reachable.insert(reachable.end(), stmts.begin() + graph[b].m_first, stmts.begin() + graph[b].m_last);
+            else
+                changed = true;
+        }
+    }
+    if (changed) stmts.swap(reachable);
+    return changed;
+}
+
+// Retarget branches to the first label of a run of labels and through 
+// blocks that only jump elsewhere.
+bool threadJumps(std::vector<IrTacStmt>& stmts)
+{
+    std::map<std::string, size_t> labels;
+    for (size_t n = 0; n < stmts.size(); n++)
+    {
+        if (stmts[n].m_opcode != IrOpcode::LABEL) continue;
+        
+        size_t first = n;
+        while (first > 0 && stmts[first - 1].m_opcode == IrOpcode::LABEL) first--;
+        labels[stmts[n].m_src0.m_asString] = first;
+    }
+    
+    bool changed = false;
+    for (auto& stmt : stmts)
+    {
+        IrTacArg* target = getOperand(stmt, getBranchTarget(stmt));
+        if (target == nullptr) continue;
+        
+        std::set<std::string> visited;
+        std::string label = target->m_asString;
+        while (visited.insert(label).second)
+        {
+            auto it = labels.find(label);
+            if (it == labels.end()) break;
+            
+            size_t n = it->second;
+            label = stmts[n].m_src0.m_asString;
+            while (n < stmts.size() && stmts[n].m_opcode == IrOpcode::LABEL) n++;
+            if (n == stmts.size() || stmts[n].m_opcode != IrOpcode::JUMP) break;
+            label = stmts[n].m_src0.m_asString;
+        }
+        if (label != target->m_asString)
+        {
+            target->m_asString = label;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Branches to where control goes anyway are dropped and a conditional branch
+// around an unconditional jump is inverted:
+//   IFZ c, L1; JUMP L2; L1:  =>  IFNZ c, L2; L1:
+bool favorFallThrough(std::vector<IrTacStmt>& stmts)
+{
+    bool changed = false;
+    std::vector<IrTacStmt> result;
+    result.reserve(stmts.size());
+    for (size_t n = 0; n < stmts.size(); n++)
+    {
+        IrTacStmt stmt = stmts[n];
+        const IrTacArg* target = getBranchTarget(stmt);
+        if (target != nullptr && isLabelAt(stmts, n + 1, target->m_asString))
+        {
+            changed = true;
+            continue;
+        }
+        if ((stmt.m_opcode == IrOpcode::IFZ || stmt.m_opcode == IrOpcode::IFNZ) && n + 1 < stmts.size() && 
+            stmts[n + 1].m_opcode == IrOpcode::JUMP && stmts[n + 1].m_src0.m_asString == target->m_asString)
+        {
+            changed = true;
+            continue;
+        }
+        if ((stmt.m_opcode == IrOpcode::IFZ || stmt.m_opcode == IrOpcode::IFNZ) && n + 1 < stmts.size() && 
+            stmts[n + 1].m_opcode == IrOpcode::JUMP && isLabelAt(stmts, n + 2, target->m_asString))
+        {
+            stmt.m_opcode = (stmt.m_opcode == IrOpcode::IFZ) ? IrOpcode::IFNZ : IrOpcode::IFZ;
+            stmt.m_src1 = stmts[n + 1].m_src0;
+            if (stmt.m_taken >= 0) stmt.m_taken = stmt.m_count - stmt.m_taken;
+            result.push_back(stmt);
+            n++;
+            changed = true;
+            continue;
+        }
+        result.push_back(stmt);
+    }
+    if (changed) stmts.swap(result);
+    return changed;
+}
+
+// Without its label a block merges with the block before it.
+bool removeUnusedLabels(std::vector<IrTacStmt>& stmts)
+{
+    std::set<std::string> used;
+    for (const auto& stmt : stmts)
+    {
+        const IrTacArg* target = getBranchTarget(stmt);
+        if (target != nullptr) used.insert(target->m_asString);
+    }
+    
+    const size_t count = stmts.size();
+    stmts.erase(std::remove_if(stmts.begin(), stmts.end(), [&used](const IrTacStmt& stmt) {
+        return (stmt.m_opcode == IrOpcode::LABEL) && (used.count(stmt.m_src0.m_asString) == 0);
+    }), stmts.end());
+    return (stmts.size() != count);
+}
+
+} // namespace
+
+bool IrOptimizer::simplifyControlFlow()
+{
+    generateStatements();
+    
+    bool changed = false;
+    bool simplified = true;
+    while (simplified)
+    {
+        simplified = removeUnreachableBlocks(m_statements);
+        simplified |= threadJumps(m_statements);
+        simplified |= favorFallThrough(m_statements);
+        simplified |= removeUnusedLabels(m_statements);
+        changed |= simplified;
+    }
+    
+    if (changed)
+    {
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
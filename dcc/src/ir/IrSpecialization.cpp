@@ -0,0 +1,343 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// statements of a method small enough to copy for a set of arguments
+const int MAX_CLONE_SIZE = 200;
+// copies made of one method
+const int MAX_CLONES = 4;
+const int MAX_ROUNDS = 3;
+
+// Argument number -> literal passed for it.
+typedef std::map<int, IrTacArg> ConstantArgs;
+
+struct CallSite
+{
+    size_t m_params;
+    size_t m_call;
+};
+
+struct Method
+{
+    size_t m_first;
+    size_t m_last;
+    int m_numParams = 0;
+    bool m_addressTaken = false;
+    std::vector<CallSite> m_calls;
+    std::set<std::string> m_callees;
+};
+
+bool isConstantArgument(const IrTacArg& arg)
+{
+    return isIntLiteral(arg) || isBoolLiteral(arg);
+}
+
+bool isSameConstant(const IrTacArg& a, const IrTacArg& b)
+{
+    return (a.m_type == b.m_type) && (a.m_value.m_int == b.m_value.m_int);
+}
+
+std::string getSignature(const ConstantArgs& constants)
+{
+    std::string signature;
+    for (const auto& it : constants)
+    {
+        signature += std::to_string(it.first) + "=" + std::to_string(it.second.m_value.m_int) + " ";
+    }
+    return signature;
+}
+
+// Methods of the module with their call sites.  A method whose name is
+// passed around (the bodies of parallel loops) can be called from anywhere.
+std::map<std::string, Method> getMethods(const std::vector<IrTacStmt>& stmts)
+{
+    std::map<std::string, Method> methods;
+    for (auto it : getFunctions(stmts))
+    {
+        Method& method = methods[stmts[it.first].m_src0.m_asString];
+        method.m_first = it.first;
+        method.m_last = it.second;
+        for (size_t n = it.first; n < it.second; n++)
+        {
+            if (stmts[n].m_opcode == IrOpcode::GETPARAM) method.m_numParams++;
+        }
+    }
+    
+    for (size_t n = 0; n < stmts.size(); n++)
+    {
+        const IrTacStmt& stmt = stmts[n];
+        if (stmt.m_opcode == IrOpcode::CALL)
+        {
+            auto it = methods.find(stmt.m_src0.m_asString);
+            if (it == methods.end()) continue;
+            
+            size_t params = n;
+            while (params > 0 && stmts[params - 1].m_opcode == IrOpcode::PARAM) params--;
+            it->second.m_calls.push_back(CallSite{ params, n });
+            
+            auto caller = std::find_if(methods.begin(), methods.end(), [&](const auto& method) { 
+                return method.second.m_first <= n && n < method.second.m_last; 
+            });
+            if (caller != methods.end()) caller->second.m_callees.insert(it->first);
+        }
+        else if (stmt.m_opcode != IrOpcode::FBEGIN)
+        {
+            for (auto arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+            {
+                auto it = methods.find(arg->m_asString);
+                if (arg->m_usage == IrUsage::Label && it != methods.end()) it->second.m_addressTaken = true;
+            }
+        }
+    }
+    return methods;
+}
+
+// True when a method can reach itself through calls; copies of it would
+// only peel off levels of the recursion.
+bool isRecursive(const std::map<std::string, Method>& methods, const std::string& name)
+{
+    std::set<std::string> visited;
+    std::vector<std::string> work(methods.at(name).m_callees.begin(), methods.at(name).m_callees.end());
+    while (!work.empty())
+    {
+        const std::string callee = work.back();
+        work.pop_back();
+        if (callee == name) return true;
+        if (!visited.insert(callee).second) continue;
+        const auto& callees = methods.at(callee).m_callees;
+        work.insert(work.end(), callees.begin(), callees.end());
+    }
+    return false;
+}
+
+// Copy of a method that takes the constant arguments as literals instead of
+// parameters; the copy gets fresh labels and temporaries.
+void emitSpecialized(const std::vector<IrTacStmt>& stmts, const Method& method, const std::string& name, 
+                     const ConstantArgs& constants, std::vector<IrTacStmt>& result)
+{
+    const size_t begin = result.size();
+    if (name == stmts[method.m_first].m_src0.m_asString)
+    {
+        result.insert(result.end(), stmts.begin() + method.m_first, stmts.begin() + method.m_last);
+    }
+    else
+    {
+        std::ptrdiff_t frameEnd = getFrameEnd(stmts, method.m_first, method.m_last);
+        result.push_back(stmts[method.m_first]);
+        result.back().m_src0.m_asString = name;
+        copyRegion(stmts, method.m_first + 1, method.m_last, result, frameEnd);
+    }
+    
+    // parameters are fetched in order, so the remaining ones keep theirs
+    int argNum = 0;
+    for (size_t n = begin; n < result.size(); n++)
+    {
+        IrTacStmt& stmt = result[n];
+        if (stmt.m_opcode != IrOpcode::GETPARAM) continue;
+        
+        auto it = constants.find(stmt.m_info);
+        if (it == constants.end())
+        {
+            stmt.m_info = argNum++;
+            continue;
+        }
+        IrTacStmt mov(IrOpcode::MOV, stmt.m_lineNo);
+        mov.m_src0 = it->second;
+        mov.m_src0.m_type = stmt.m_src0.m_type;
+        mov.m_dst = stmt.m_src0;
+        mov.m_count = stmt.m_count;
+        stmt = mov;
+    }
+}
+
+// One round over the call graph: arguments every call of a method passes
+// as the same literal become constants of the method itself, and methods
+// called with differing literals get a copy per set of literals while the
+// budget lasts.  The parameters made constant are no longer passed.
+bool specializeMethods(std::vector<IrTacStmt>& stmts, int& budget, int& counter)
+{
+    std::map<std::string, Method> methods = getMethods(stmts);
+    
+    // call -> callee and the arguments it no longer passes
+    std::map<size_t, std::pair<std::string, ConstantArgs>> rewrites;
+    // method -> its own constants, and its copies with theirs
+    std::map<std::string, ConstantArgs> inPlace;
+    std::map<std::string, std::vector<std::pair<std::string, ConstantArgs>>> clones;
+    for (auto& it : methods)
+    {
+        const std::string& name = it.first;
+        const Method& method = it.second;
+        if (name == "main" || method.m_addressTaken || method.m_calls.empty() || method.m_numParams == 0) continue;
+        if (std::any_of(method.m_calls.begin(), method.m_calls.end(), 
+                        [&](const CallSite& call) { return (int)(call.m_call - call.m_params) != method.m_numParams; }))
+            continue;
+        
+        // literals common to all calls
+        ConstantArgs common;
+        const CallSite& front = method.m_calls.front();
+        for (int k = 0; k < method.m_numParams; k++)
+        {
+            const IrTacArg& arg = stmts[front.m_params + k].m_src0;
+            if (!isConstantArgument(arg)) continue;
+            if (std::all_of(method.m_calls.begin(), method.m_calls.end(), 
+                            [&](const CallSite& call) { return isSameConstant(stmts[call.m_params + k].m_src0, arg); }))
+                common[k] = arg;
+        }
+        
+        // the other literals of each call, grouped
+        std::map<std::string, std::pair<ConstantArgs, std::vector<size_t>>> groups;
+        for (const auto& call : method.m_calls)
+        {
+            ConstantArgs constants;
+            for (int k = 0; k < method.m_numParams; k++)
+            {
+                const IrTacArg& arg = stmts[call.m_params + k].m_src0;
+                if (isConstantArgument(arg) && common.count(k) == 0) constants[k] = arg;
+            }
+            auto& group = groups[getSignature(constants)];
+            group.first = constants;
+            group.second.push_back(call.m_call);
+        }
+        std::vector<std::pair<ConstantArgs, std::vector<size_t>>*> order;
+        for (auto& group : groups)
+        {
+            if (!group.second.first.empty()) order.push_back(&group.second);
+        }
+        std::stable_sort(order.begin(), order.end(), [](const auto* a, const auto* b) { return a->second.size() > b->second.size(); });
+        
+        const int size = (int)(method.m_last - method.m_first);
+        for (const auto& call : method.m_calls)
+        {
+            rewrites[call.m_call] = std::make_pair(name, common);
+        }
+        if (!common.empty()) inPlace[name] = common;
+        if (isRecursive(methods, name)) continue;
+        for (auto group : order)
+        {
+            if (size > MAX_CLONE_SIZE || size > budget || (int)clones[name].size() >= MAX_CLONES) break;
+            budget -= size;
+            
+            ConstantArgs constants = common;
+            constants.insert(group->first.begin(), group->first.end());
+            const std::string clone = name + ".spec" + std::to_string(counter++);
+            clones[name].push_back(std::make_pair(clone, constants));
+            for (auto call : group->second)
+            {
+                rewrites[call] = std::make_pair(clone, constants);
+            }
+        }
+    }
+    if (inPlace.empty() && clones.empty()) return false;
+    
+    // calls first, so the copies are made of the rewritten bodies
+    std::vector<IrTacStmt> calls;
+    calls.reserve(stmts.size());
+    for (size_t n = 0; n < stmts.size(); n++)
+    {
+        auto it = rewrites.find(n);
+        if (it != rewrites.end())
+        {
+            size_t params = n;
+            while (params > 0 && stmts[params - 1].m_opcode == IrOpcode::PARAM) params--;
+            int argNum = 0;
+            for (size_t k = params; k < n; k++)
+            {
+                if (it->second.second.count(stmts[k].m_info) != 0) continue;
+                calls.push_back(stmts[k]);
+                calls.back().m_info = argNum++;
+            }
+            calls.push_back(stmts[n]);
+            calls.back().m_src0.m_asString = it->second.first;
+            continue;
+        }
+        // parameters of other calls
+        size_t call = n;
+        while (stmts[call].m_opcode == IrOpcode::PARAM) call++;
+        if (call != n && rewrites.count(call) != 0) continue;
+        calls.push_back(stmts[n]);
+    }
+    
+    methods = getMethods(calls);
+    const auto functions = getFunctions(calls);
+    std::vector<IrTacStmt> result;
+    result.reserve(calls.size());
+    result.insert(result.end(), calls.begin(), calls.begin() + functions.front().first);
+    for (auto it : functions)
+    {
+        const std::string& name = calls[it.first].m_src0.m_asString;
+        const Method& method = methods[name];
+        auto ip = inPlace.find(name);
+        emitSpecialized(calls, method, name, (ip != inPlace.end()) ? ip->second : ConstantArgs(), result);
+        for (const auto& clone : clones[name])
+        {
+            emitSpecialized(calls, method, clone.first, clone.second, result);
+        }
+    }
+    stmts.swap(result);
+    return true;
+}
+
+} // namespace
+
+// Interprocedural constant propagation: literal arguments are propagated into
+// the methods called with them, and conditional constant propagation then
+// folds them into bounds and indices before the loop optimizations run.
+// Specialized copies of methods add at most 'cloneBudget' statements.
+bool IrOptimizer::interproceduralConstants(int cloneBudget)
+{
+    generateStatements();
+    if (getFunctions(m_statements).empty()) return false;
+    
+    bool changed = false;
+    for (int round = 0; round < MAX_ROUNDS; round++)
+    {
+        if (!specializeMethods(m_statements, cloneBudget, m_specializedMethods)) break;
+        changed = true;
+        
+        // the constants reach the arguments of the next calls down
+        generateBasicBlocks(m_statements);
+        constantPropagation();
+        generateStatements();
+    }
+    
+    if (changed)
+    {
+        generateBasicBlocks(m_statements);
+    }
+    return changed;
+}
+
+} // namespace Decaf
@@ -57,6 +57,10 @@ const std::string gIrOpcodeStrings[(int)IrOpcode::NUM_OPCODES] =
     "AND",
     "OR",
     "NOT",
+    "MIN",
+    "MAX",
+    "MOVZ",
+    "MOVNZ",
     "LABEL",
     "JUMP",
     "IFZ",
@@ -66,6 +70,7 @@ const std::string gIrOpcodeStrings[(int)IrOpcode::NUM_OPCODES] =
     "STRING",
     "GLOBAL",
     "DOUBLE",
+    "PARFOR",
 };
 static_assert(sizeof(gIrOpcodeStrings)/sizeof(std::string) == (size_t)IrOpcode::NUM_OPCODES, "Unexpected number of IrOpcode strings.");
 
@@ -197,6 +202,24 @@ void IrTacArg::build(double literal)
     m_asString = str.str();
 }
 
+void IrTacArg::buildInteger(long literal)
+{
+    m_usage = IrUsage::Literal;
+    m_isConstant = true;
+    m_type = IrArgType::Integer;
+    m_value.m_int = literal;
+    m_asString = std::to_string(literal);
+}
+
+void IrTacArg::buildTemporary(const std::string& name, std::ptrdiff_t address, IrArgType type)
+{
+    m_usage = IrUsage::Identifier;
+    m_isConstant = false;
+    m_type = type;
+    m_value.m_address = address;
+    m_asString = name;
+}
+
 bool IrTacStmt::hasSrc0() const
 {
     return (m_src0.m_usage != IrUsage::Unused);
@@ -467,32 +490,50 @@ static int s_boundsCounter = 0;
 
 void IrGenBoundsCheck(const IrTacArg& offset, int limit, int lineNo, std::ostream& stream)
 {
-    std::stringstream labelPass;
-    labelPass << ".LB" << s_boundsCounter++;
+    // literal offsets are checked here
+    if (offset.m_usage == IrUsage::Literal && offset.m_value.m_int >= 0 && offset.m_value.m_int < limit)
+        return;
+    
     std::stringstream labelFail;
     labelFail << ".LB" << s_boundsCounter++;
     
-    IrGenMov(offset, g_tempReg, stream); 
-    
-    stream << "cmpq $0," << g_tempReg << std::endl;
-    stream << "jl " << labelFail.str() << std::endl;
-    
-    stream << "cmpq $" << limit << "," << g_tempReg << std::endl;
-    stream << "jl " << labelPass.str() << std::endl;    
+    if (offset.m_usage == IrUsage::Literal)
+    {
+        stream << "jmp " << labelFail.str() << std::endl;
+    }
+    else
+    {
+        IrGenMov(offset, g_tempReg, stream); 
+        
+        // negative offsets are large unsigned ones
+        stream << "cmpq $" << limit << "," << g_tempReg << std::endl;
+        stream << "jae " << labelFail.str() << std::endl;    
+    }
 
+    // out of line, the line number goes to the shared failure path
+    stream << ".pushsection .text.unlikely" << std::endl;
     stream << labelFail.str() << ":" << std::endl;    
+    stream << "mov $" << lineNo << ", %edx" << std::endl;
+    stream << "jmp .BOUNDSFAIL" << std::endl;
+    stream << ".popsection" << std::endl;
+}
+
+void IrTacGenBoundsFailure(std::ostream& stream)
+{
+    if (s_boundsCounter == 0) return;
     
-    // puts(.BOUNDSMSG)
+    // printf(.BOUNDSMSG, .DCFFILE, line in %rdx)
+    stream << ".section .text.unlikely" << std::endl;
+    stream << ".BOUNDSFAIL:" << std::endl;
     stream << "leaq .BOUNDSMSG(%rip), %rdi" << std::endl;
     stream << "leaq .DCFFILE(%rip), %rsi" << std::endl;
-    stream << "mov $" << lineNo << ", %rdx" << std::endl;
+    stream << "mov $0, %eax" << std::endl;
     stream << "call printf" << std::endl;
 
     // exit(1) — flush buffers then terminate
     stream << "mov $1, %rdi" << std::endl;
     stream << "call exit" << std::endl;
-
-    stream << labelPass.str() << ":" << std::endl;    
+    stream << ".text" << std::endl;
 }
 
 void IrGenLoad(const IrTacArg& baseAddr, const IrTacArg& offset, const IrTacArg& dst, int limit, int lineNo, std::ostream& stream)
@@ -645,6 +686,37 @@ void IrGenComparison(const IrTacStmt& stmt, std::ostream& stream)
     IrGenMov(g_retReg, stmt.m_dst, stream);      
 }
 
+void IrGenMinMax(const IrTacStmt& stmt, std::ostream& stream)
+{
+    IrGenMov(stmt.m_src0, g_retReg, stream);
+    IrGenMov(stmt.m_src1, g_tempReg, stream);
+    
+    // keep arg0 unless arg1 is the smaller (larger) one
+    stream << "cmp " << g_tempReg << ", " << g_retReg << std::endl;
+    stream << (stmt.m_opcode == IrOpcode::MIN ? "cmovg " : "cmovl ") << g_tempReg << ", " << g_retReg << std::endl;
+    
+    IrGenMov(g_retReg, stmt.m_dst, stream);
+}
+
+void IrGenConditionalMove(const IrTacStmt& stmt, std::ostream& stream)
+{
+    IrGenMov(stmt.m_dst, g_retReg, stream);
+    IrGenMov(stmt.m_src1, g_tempReg, stream);
+    
+    if (stmt.m_src0.isLiteral())
+    {
+        IrGenMov(stmt.m_src0, g_outReg, stream);
+        stream << "cmpq $0, " << g_outReg << std::endl;
+    }
+    else
+    {
+        stream << "cmpq $0, " << stmt.m_src0 << std::endl;
+    }
+    stream << (stmt.m_opcode == IrOpcode::MOVZ ? "cmovz " : "cmovnz ") << g_tempReg << ", " << g_retReg << std::endl;
+    
+    IrGenMov(g_retReg, stmt.m_dst, stream);
+}
+
 static std::vector<IrTacArg> g_funcCallParams;
 
 void IrGenParamPush(std::ostream& stream)
@@ -694,6 +766,9 @@ void IrGenParamPush(std::ostream& stream)
             stream << "push " << *it << std::endl;
         }
     }   
+    
+    // variadic callees (printf) read the number of vector registers used from %al
+    stream << "mov $" << nextDoubleRegister << ", %eax" << std::endl;
         
     g_funcCallParams.clear();
 }
@@ -843,7 +918,22 @@ void IrTacGenCode(const IrTacStmt& stmt, std::ostream& stream)
         IrGenMov(g_tempReg, stmt.m_dst, stream);
         break;
         
+    case IrOpcode::MIN:        // min(arg0, arg1) -> arg2
+    case IrOpcode::MAX:        // max(arg0, arg1) -> arg2
+        IrGenMinMax(stmt, stream);
+        break;
+        
+    case IrOpcode::MOVZ:       // arg1 -> arg2 if arg0 == 0
+    case IrOpcode::MOVNZ:      // arg1 -> arg2 if arg0 != 0
+        IrGenConditionalMove(stmt, stream);
+        break;
+        
     case IrOpcode::LABEL:      // arg0:
+        if (stmt.m_info != 0)
+        {
+            // pad to a 16-byte fetch block unless that takes more than 10 bytes
+            stream << ".p2align 4,,10" << std::endl;
+        }
         stream << stmt.m_src0.m_asString << ":" << std::endl;     
         break;
         
@@ -995,7 +1085,7 @@ bool isComparisonOp(IrOpcode opcode)
 
 bool isTempIdentifier(const IrTacArg& arg)
 {
-    if ((arg.m_usage == IrUsage::Identifier) && (arg.m_asString.find_first_of(".LC") != std::string::npos))
+    if ((arg.m_usage == IrUsage::Identifier) && (arg.m_asString.compare(0, 3, ".LC") == 0))
         return true;
     return false;
 }
@@ -1037,4 +1127,138 @@ bool isFalse(const IrTacArg& arg)
     return (arg.m_usage == IrUsage::Literal && arg.m_type == IrArgType::Boolean && arg.m_value.m_int == 0);  
 }
 
+std::string getVariableKey(const IrTacArg& arg)
+{
+    if (arg.m_usage == IrUsage::Global)
+        return arg.m_asString;
+    return "@" + std::to_string(arg.m_value.m_address);
+}
+
+std::string getOperandKey(const IrTacArg& arg)
+{
+    if (arg.m_usage == IrUsage::Unused) return "_";
+    if (arg.isLiteral()) return "$" + std::to_string((int)arg.m_type) + ":" + arg.m_asString;
+    if (!arg.isMemory()) return "$" + arg.m_asString;
+    return isTempIdentifier(arg) ? arg.m_asString : getVariableKey(arg);
+}
+
+int alignFrameSize(std::ptrdiff_t frameEnd)
+{
+    // slots are 8 bytes, the stack pointer stays 16 byte aligned at calls
+    int frameSize = (int)frameEnd;
+    if (frameSize % 16 != 0) frameSize += 8;
+    return frameSize;
+}
+
+bool isSameStatement(const IrTacStmt& lhs, const IrTacStmt& rhs)
+{
+    return (lhs.m_opcode == rhs.m_opcode) && (getOperandKey(lhs.m_src0) == getOperandKey(rhs.m_src0)) &&
+           (getOperandKey(lhs.m_src1) == getOperandKey(rhs.m_src1)) && (getOperandKey(lhs.m_dst) == getOperandKey(rhs.m_dst));
+}
+
+void getUsedVariables(const IrTacStmt& stmt, std::vector<const IrTacArg*>& used)
+{
+    used.clear();
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::NOT:
+            // the operand of NOT is in src1
+            if (stmt.m_src1.isMemory()) used.push_back(&stmt.m_src1);
+            break;
+        case IrOpcode::MOV:
+        case IrOpcode::RETURN:
+        case IrOpcode::IFZ:
+        case IrOpcode::IFNZ:
+        case IrOpcode::PARAM:
+            if (stmt.m_src0.isMemory()) used.push_back(&stmt.m_src0);
+            break;
+        case IrOpcode::LOAD:
+            if (stmt.m_src1.isMemory()) used.push_back(&stmt.m_src1);
+            break;
+        case IrOpcode::STORE:
+            if (stmt.m_src0.isMemory()) used.push_back(&stmt.m_src0);
+            if (stmt.m_dst.isMemory()) used.push_back(&stmt.m_dst);
+            break;
+        case IrOpcode::MOVZ:
+        case IrOpcode::MOVNZ:
+            // a conditional move keeps the old value of dst when not taken
+            if (stmt.m_src0.isMemory()) used.push_back(&stmt.m_src0);
+            if (stmt.m_src1.isMemory()) used.push_back(&stmt.m_src1);
+            if (stmt.m_dst.isMemory()) used.push_back(&stmt.m_dst);
+            break;
+        case IrOpcode::MIN:
+        case IrOpcode::MAX:
+            if (stmt.m_src0.isMemory()) used.push_back(&stmt.m_src0);
+            if (stmt.m_src1.isMemory()) used.push_back(&stmt.m_src1);
+            break;
+        default:
+            if (isBinaryOp(stmt.m_opcode) || isComparisonOp(stmt.m_opcode) || isLogicOp(stmt.m_opcode))
+            {
+                if (stmt.m_src0.isMemory()) used.push_back(&stmt.m_src0);
+                if (stmt.m_src1.isMemory()) used.push_back(&stmt.m_src1);
+            }
+            break;
+    }
+}
+
+bool isReplaceableUse(const IrTacStmt& stmt, const IrTacArg* arg)
+{
+    const bool conditionalMove = (stmt.m_opcode == IrOpcode::MOVZ || stmt.m_opcode == IrOpcode::MOVNZ);
+    return !(conditionalMove && arg == &stmt.m_dst);
+}
+
+const IrTacArg* getDefinedVariable(const IrTacStmt& stmt)
+{
+    const IrTacArg* def = nullptr;
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::MOV:
+        case IrOpcode::NOT:
+        case IrOpcode::LOAD:
+        case IrOpcode::MIN:
+        case IrOpcode::MAX:
+        case IrOpcode::MOVZ:
+        case IrOpcode::MOVNZ:
+            def = &stmt.m_dst;
+            break;
+        case IrOpcode::CALL:
+            def = &stmt.m_src1;
+            break;
+        case IrOpcode::GETPARAM:
+            def = &stmt.m_src0;
+            break;
+        default:
+            if (isBinaryOp(stmt.m_opcode) || isComparisonOp(stmt.m_opcode) || isLogicOp(stmt.m_opcode))
+                def = &stmt.m_dst;
+            break;
+    }
+    if (def != nullptr && !def->isMemory())
+        def = nullptr;
+    return def;
+}
+
+IrTacArg* getOperand(IrTacStmt& stmt, const IrTacArg* arg)
+{
+    for (IrTacArg* it : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+    {
+        if (it == arg) return it;
+    }
+    return nullptr;
+}
+
+const IrTacArg* getBranchTarget(const IrTacStmt& stmt)
+{
+    switch (stmt.m_opcode)
+    {
+        case IrOpcode::JUMP:
+            return &stmt.m_src0;
+        case IrOpcode::IFZ:
+        case IrOpcode::IFNZ:
+            return &stmt.m_src1;
+        default:
+            break;
+    }
+    return nullptr;
+}
+
 } // namespace Decaf
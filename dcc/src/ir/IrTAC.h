@@ -24,6 +24,7 @@
 #pragma once
 #include <memory>
 #include <string>
+#include <vector>
 #include <iostream>
 #include "IrBase.h"
 
@@ -59,7 +60,11 @@ enum class IrOpcode : int
     AND,        // arg0 && arg1 -> dst (0 or 1)
     OR,         // arg0 || arg1 -> dst (0 or 1)
     NOT,        // !arg0 -> dst (0 or 1)
-    LABEL,      // arg0:
+    MIN,        // min(arg0, arg1) -> dst
+    MAX,        // max(arg0, arg1) -> dst
+    MOVZ,       // arg1 -> dst if arg0 == 0
+    MOVNZ,      // arg1 -> dst if arg0 != 0
+    LABEL,      // arg0: (aligned if info != 0)
     JUMP,       // jump arg0
     IFZ,        // branch arg0 == 0 to arg1
     IFNZ,       // branch arg0 != 0 to arg1
@@ -68,6 +73,7 @@ enum class IrOpcode : int
     STRING,     // string label -> arg0 value -> arg1
     GLOBAL,     // global arg0
     DOUBLE,     // double label -> arg0 value -> arg1
+    PARFOR,     // parallel for loop follows, arg0 => runtime entry
     
     NUM_OPCODES
 };
@@ -118,6 +124,8 @@ struct IrTacArg
     void buildLabel(const std::string& label);
     void build(const std::string& literal);
     void build(double literal);
+    void buildInteger(long literal);
+    void buildTemporary(const std::string& name, std::ptrdiff_t address, IrArgType type = IrArgType::Integer);
     
     bool isLiteral() const { return (m_usage == IrUsage::Literal); }
     bool isMemory() const { return (m_usage == IrUsage::Identifier) || (m_usage == IrUsage::Global); }
@@ -145,7 +153,9 @@ struct IrTacStmt
 	m_src1(),
 	m_dst(),
 	m_info(0),
-	m_lineNo(0)
+	m_lineNo(0),
+	m_count(-1),
+	m_taken(-1)
     {}
     IrTacStmt(IrOpcode opcode, int lineNo = 0) :
         m_opcode(opcode),
@@ -153,13 +163,19 @@ struct IrTacStmt
         m_src1(),
         m_dst(),
         m_info(0),
-        m_lineNo(lineNo)
+        m_lineNo(lineNo),
+        m_count(-1),
+        m_taken(-1)
     {}
         
     IrOpcode m_opcode;
     IrTacArg m_src0, m_src1, m_dst;
     int m_info;
     int m_lineNo;
+    // measured executions of the statement and, for a branch, how often it
+    // was taken; -1 without a profile (see IrOptimizer::applyProfile)
+    long m_count;
+    long m_taken;
     bool hasSrc0() const;
     bool hasSrc1() const;
     bool hasDst() const;
@@ -169,6 +185,10 @@ void IrPrintTac(const IrTacStmt& stmt, std::ostream& stream = std::cout);
 
 void IrTacGenCode(const IrTacStmt& stmt, std::ostream& stream = std::cout);
 
+// Failure path shared by the array bounds checks of IrTacGenCode; emitted after
+// the code.
+void IrTacGenBoundsFailure(std::ostream& stream = std::cout);
+
 struct Key
 {
     Key(int left, IrOpcode opcode, int right) :
@@ -229,4 +249,28 @@ bool isDoubleOne(const IrTacArg& arg);
 bool isTrue(const IrTacArg& arg);
 bool isFalse(const IrTacArg& arg);
 
+// Name that identifies the storage behind a variable argument; locals are keyed
+// by frame address (sibling blocks may share a slot), globals by name.
+std::string getVariableKey(const IrTacArg& arg);
+// Name that tells operands apart before assignTemporarySlots(): the front
+// end can give several temporaries the same slot, so they go by name, and
+// literals by type and value.
+std::string getOperandKey(const IrTacArg& arg);
+// Frame size covering the storage below 'frameEnd', kept a multiple of 16.
+int alignFrameSize(std::ptrdiff_t frameEnd);
+// Same opcode and operands, as getOperandKey tells them apart.
+bool isSameStatement(const IrTacStmt& lhs, const IrTacStmt& rhs);
+// Scalar variables read by a statement (array bases are not included).
+void getUsedVariables(const IrTacStmt& stmt, std::vector<const IrTacArg*>& used);
+// Whether a use returned by getUsedVariables can be replaced by another value;
+// a conditional move reads its destination but also writes it in place.
+bool isReplaceableUse(const IrTacStmt& stmt, const IrTacArg* arg);
+// Scalar variable written by a statement, or nullptr.
+const IrTacArg* getDefinedVariable(const IrTacStmt& stmt);
+// Writable operand of a statement behind a pointer returned by
+// getUsedVariables, getDefinedVariable or getBranchTarget.
+IrTacArg* getOperand(IrTacStmt& stmt, const IrTacArg* arg);
+// Label operand of a JUMP, IFZ or IFNZ, or nullptr.
+const IrTacArg* getBranchTarget(const IrTacStmt& stmt);
+
 } // namespace Decaf
@@ -0,0 +1,160 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "IrOptimizer.h"
+#include "IrFlowGraph.h"
+#include "IrLoop.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+// Statements a temporary appears in.
+struct TempRange
+{
+    size_t m_first = 0;
+    size_t m_last = 0;
+    size_t m_block = 0;
+    // set and read within one block, set before it is read there
+    bool m_local = true;
+    int m_slot = -1;
+};
+
+bool isDefinedBy(const IrTacStmt& stmt, const IrTacArg* arg, const std::vector<const IrTacArg*>& used)
+{
+    return (getDefinedVariable(stmt) == arg) && (std::find(used.begin(), used.end(), arg) == used.end());
+}
+
+} // namespace
+
+// The front end allocates temporaries after the frame size of a function is
+// fixed, so they can land below the stack pointer where a call clobbers them.
+// That is harmless while each temporary dies right after it is set, but not
+// once the optimizations stretch live ranges.  Temporaries get slots above
+// the user variables instead; those set and read within one block share
+// slots when their ranges do not overlap.  Returns whether a temporary moved
+// or a frame size changed.
+bool IrOptimizer::assignTemporarySlots()
+{
+    generateStatements();
+    
+    bool changed = false;
+    std::vector<const IrTacArg*> used;
+    for (auto function : getFunctions(m_statements))
+    {
+        const size_t first = function.first;
+        const size_t last = function.second;
+        const IrFlowGraph graph(m_statements, first, last);
+        
+        std::ptrdiff_t frameEnd = m_statements[first].m_info;
+        std::map<std::string, TempRange> temps;
+        for (size_t b = 0; b < graph.size(); b++)
+        {
+            for (size_t n = graph[b].m_first; n < graph[b].m_last; n++)
+            {
+                const IrTacStmt& stmt = m_statements[n];
+                getUsedVariables(stmt, used);
+                for (auto arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+                {
+                    if (arg->m_usage != IrUsage::Identifier || stmt.m_opcode == IrOpcode::FBEGIN) continue;
+                    if (!isCompilerTemporary(*arg))
+                    {
+                        frameEnd = std::max(frameEnd, arg->m_value.m_address + 8);
+                        continue;
+                    }
+                    
+                    auto it = temps.find(arg->m_asString);
+                    if (it == temps.end())
+                    {
+                        TempRange range;
+                        range.m_first = n;
+                        range.m_block = b;
+                        range.m_local = isDefinedBy(stmt, arg, used);
+                        it = temps.emplace(arg->m_asString, range).first;
+                    }
+                    if (it->second.m_block != b) it->second.m_local = false;
+                    it->second.m_last = n;
+                }
+            }
+        }
+        if (temps.empty()) continue;
+        
+        // block local ranges in order of their start, first fit
+        std::vector<TempRange*> ranges;
+        for (auto& it : temps)
+        {
+            ranges.push_back(&it.second);
+        }
+        std::sort(ranges.begin(), ranges.end(), [](const TempRange* a, const TempRange* b) { return a->m_first < b->m_first; });
+        
+        std::vector<size_t> slotEnd;
+        for (auto range : ranges)
+        {
+            if (!range->m_local) continue;
+            
+            for (size_t s = 0; s < slotEnd.size() && range->m_slot < 0; s++)
+            {
+                if (slotEnd[s] < range->m_first) range->m_slot = (int)s;
+            }
+            if (range->m_slot < 0)
+            {
+                range->m_slot = (int)slotEnd.size();
+                slotEnd.push_back(0);
+            }
+            slotEnd[range->m_slot] = range->m_last;
+        }
+        int numSlots = (int)slotEnd.size();
+        for (auto range : ranges)
+        {
+            if (range->m_slot < 0) range->m_slot = numSlots++;
+        }
+        
+        for (size_t n = first + 1; n < last; n++)
+        {
+            IrTacStmt& stmt = m_statements[n];
+            for (auto arg : { &stmt.m_src0, &stmt.m_src1, &stmt.m_dst })
+            {
+                if (arg->m_usage != IrUsage::Identifier || !isCompilerTemporary(*arg)) continue;
+                
+                const std::ptrdiff_t address = frameEnd + 8 * temps[arg->m_asString].m_slot;
+                if (arg->m_value.m_address != address) changed = true;
+                arg->m_value.m_address = address;
+            }
+        }
+        
+        const int frameSize = alignFrameSize(frameEnd + 8 * numSlots);
+        if (m_statements[first].m_info != frameSize) changed = true;
+        m_statements[first].m_info = frameSize;
+    }
+    
+    generateBasicBlocks(m_statements);
+    return changed;
+}
+
+} // namespace Decaf
@@ -0,0 +1,177 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include <fstream>
+#include <iomanip>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "IrTimer.h"
+
+namespace Decaf
+{
+
+namespace
+{
+
+const size_t NO_PHASE = (size_t)-1;
+
+std::string escapeJson(const std::string& text)
+{
+    std::string escaped;
+    for (auto c : text)
+    {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace
+
+IrTimeReport& IrTimeReport::get()
+{
+    static IrTimeReport report;
+    return report;
+}
+
+IrTimeReport::IrTimeReport() :
+    m_enabled(false),
+    m_trace(false),
+    m_start(Clock::now()),
+    m_startTimestamp(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count()),
+    m_phases(),
+    m_running(),
+    m_events()
+{
+}
+
+void IrTimeReport::enable()
+{
+    m_enabled = true;
+}
+
+void IrTimeReport::enableTrace()
+{
+    m_enabled = true;
+    m_trace = true;
+}
+
+long long IrTimeReport::getTimestamp(Clock::time_point time) const
+{
+    return m_startTimestamp + std::chrono::duration_cast<std::chrono::microseconds>(time - m_start).count();
+}
+
+void IrTimeReport::start(const std::string& name)
+{
+    // phases are told apart by name and by the phase they run in
+    const size_t parent = m_running.empty() ? NO_PHASE : m_running.back().m_phase;
+    size_t phase = 0;
+    while (phase < m_phases.size() && (m_phases[phase].m_parent != parent || m_phases[phase].m_name != name))
+    {
+        phase++;
+    }
+    if (phase == m_phases.size())
+    {
+        m_phases.push_back(Phase{name, parent, 0, 0.0, 0.0});
+    }
+    m_running.push_back(Running{phase, Clock::now(), std::clock()});
+}
+
+void IrTimeReport::stop()
+{
+    if (m_running.empty()) return;
+    
+    const Running running = m_running.back();
+    m_running.pop_back();
+    const Clock::time_point now = Clock::now();
+    
+    Phase& phase = m_phases[running.m_phase];
+    phase.m_calls++;
+    phase.m_wall += std::chrono::duration<double>(now - running.m_wall).count();
+    phase.m_cpu += (double)(std::clock() - running.m_cpu) / CLOCKS_PER_SEC;
+    
+    if (m_trace)
+    {
+        const long long timestamp = getTimestamp(running.m_wall);
+        m_events.push_back(Event{phase.m_name, timestamp, getTimestamp(now) - timestamp});
+    }
+}
+
+void IrTimeReport::printPhase(std::ostream& stream, size_t phase, int depth, double total) const
+{
+    const Phase& it = m_phases[phase];
+    stream << std::left << std::setw(24) << (std::string(2 * depth, ' ') + it.m_name) << std::right << std::setw(8) << it.m_calls
+           << std::setw(12) << it.m_wall * 1000.0 << std::setw(12) << it.m_cpu * 1000.0 
+           << std::setw(8) << std::setprecision(1) << (total > 0.0 ? 100.0 * it.m_wall / total : 0.0) << std::setprecision(3) << std::endl;
+    for (size_t child = 0; child < m_phases.size(); child++)
+    {
+        if (m_phases[child].m_parent == phase) printPhase(stream, child, depth + 1, total);
+    }
+}
+
+void IrTimeReport::print(std::ostream& stream) const
+{
+    const double wall = std::chrono::duration<double>(Clock::now() - m_start).count();
+    const double cpu = (double)std::clock() / CLOCKS_PER_SEC;
+    
+    const std::ios_base::fmtflags flags = stream.flags();
+    const std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(3);
+    stream << std::left << std::setw(24) << "phase" << std::right << std::setw(8) << "calls" 
+           << std::setw(12) << "wall (ms)" << std::setw(12) << "cpu (ms)" << std::setw(8) << "wall %" << std::endl;
+    for (size_t phase = 0; phase < m_phases.size(); phase++)
+    {
+        if (m_phases[phase].m_parent == NO_PHASE) printPhase(stream, phase, 0, wall);
+    }
+    stream << std::left << std::setw(32) << "total" << std::right << std::setw(12) << wall * 1000.0 << std::setw(12) << cpu * 1000.0 << std::endl;
+    
+    // kilobytes on Linux
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        stream << "peak RSS: " << usage.ru_maxrss << " KB" << std::endl;
+    
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+// The JSON object format of the trace event format, with complete ("X")
+// events and the name of the process as metadata.
+bool IrTimeReport::writeTrace(const std::string& filename, const std::string& processName) const
+{
+    std::ofstream trace(filename);
+    if (!trace) return false;
+    
+    const int pid = (int)getpid();
+    trace << "{\"traceEvents\":[" << std::endl;
+    trace << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":\"" 
+          << escapeJson(processName) << "\"}}";
+    for (const auto& it : m_events)
+    {
+        trace << "," << std::endl << "{\"name\":\"" << escapeJson(it.m_name) << "\",\"cat\":\"dcc\",\"ph\":\"X\",\"ts\":" << it.m_timestamp 
+              << ",\"dur\":" << it.m_duration << ",\"pid\":" << pid << ",\"tid\":0}";
+    }
+    trace << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+    return (bool)trace;
+}
+
+} // namespace Decaf
@@ -0,0 +1,118 @@
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 Rick Weyrauch (rpweyrauch@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace Decaf
+{
+
+// Wall and CPU time spent in the phases of a compile, nested as the
+// IrScopedTimers that measure them are, for --time-passes.  Phases can also
+// be written as Chrome trace events (chrome://tracing, Perfetto); the events
+// of each run carry its process id and the time of day, so the traces of a
+// batch of runs can be viewed side by side.
+class IrTimeReport
+{
+public:
+    static IrTimeReport& get();
+    
+    void enable();
+    bool isEnabled() const { return m_enabled; }
+    // Phases are also kept as trace events for writeTrace.
+    void enableTrace();
+    
+    void start(const std::string& name);
+    void stop();
+    
+    // Times of the phases with the peak resident set size of the process.
+    void print(std::ostream& stream) const;
+    bool writeTrace(const std::string& filename, const std::string& processName) const;
+    
+private:
+    IrTimeReport();
+    
+    typedef std::chrono::steady_clock Clock;
+    
+    struct Phase
+    {
+        std::string m_name;
+        size_t m_parent;
+        int m_calls;
+        double m_wall;
+        double m_cpu;
+    };
+    struct Running
+    {
+        size_t m_phase;
+        Clock::time_point m_wall;
+        std::clock_t m_cpu;
+    };
+    struct Event
+    {
+        std::string m_name;
+        long long m_timestamp;
+        long long m_duration;
+    };
+    
+    void printPhase(std::ostream& stream, size_t phase, int depth, double total) const;
+    long long getTimestamp(Clock::time_point time) const;
+    
+    bool m_enabled;
+    bool m_trace;
+    Clock::time_point m_start;
+    // microseconds since the epoch at m_start
+    long long m_startTimestamp;
+    std::vector<Phase> m_phases;
+    std::vector<Running> m_running;
+    std::vector<Event> m_events;
+};
+
+// Times its scope as a phase of the IrTimeReport, when the report is enabled.
+// Timing a scope costs a few clock reads, so work that runs very often, like
+// scanning a token, is left to the phase that runs it (the scanner's time is
+// part of parse's).
+class IrScopedTimer
+{
+public:
+    explicit IrScopedTimer(const std::string& name) :
+        m_active(IrTimeReport::get().isEnabled())
+    {
+        if (m_active) IrTimeReport::get().start(name);
+    }
+    ~IrScopedTimer()
+    {
+        if (m_active) IrTimeReport::get().stop();
+    }
+    
+private:
+    bool m_active;
+    
+    IrScopedTimer(const IrScopedTimer& rhs) = delete;
+};
+
+} // namespace Decaf
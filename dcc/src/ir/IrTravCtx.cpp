@@ -22,8 +22,12 @@
 // THE SOFTWARE.
 //
 
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include "IrTravCtx.h"
+#include "IrOutliner.h"
+#include "IrTimer.h"
 #include "IrSymbolTable.h"
 #include "IrMethodCall.h"
 #include "IrStringLiteral.h"
@@ -73,6 +77,19 @@ bool IrTraversalContext::lookup(IrLocation* location, SVariableSymbol& symbol) c
     return lookup(location->getIdentifier().get(), symbol);
 }
 
+bool IrTraversalContext::isDeclaredWithin(IrLocation* location, size_t count) const
+{
+    SVariableSymbol symbol;
+    for (auto it : m_symbols)
+    {
+        if (count == 0) break;
+        if (it->getSymbol(location->getIdentifier().get(), symbol))
+            return true;
+        count--;
+    }
+    return false;
+}
+
 bool IrTraversalContext::lookup(IrMethodCall* method, SMethodSymbol& symbol) const
 {
     bool found = false;
@@ -194,13 +211,32 @@ void IrTraversalContext::highlightError(int line, int column, int length) const
   
 void IrTraversalContext::codegen(std::ostream& stream)
 {
+    std::stringstream assembly;
+    std::ostream& out = m_outline ? assembly : stream;
+    
     if (!m_sourceFilename.empty())
-        stream << ".file \"" << m_sourceFilename << "\"" << std::endl;
+        out << ".file \"" << m_sourceFilename << "\"" << std::endl;
     
-    stream << ".text" << std::endl;
+    out << ".text" << std::endl;
     for (auto it : m_statements)
     {
-        IrTacGenCode(it, stream);
+        IrTacGenCode(it, out);
+    }
+    IrTacGenBoundsFailure(out);
+    
+    if (m_outline)
+    {
+        IrScopedTimer timer("outline");
+        IrOutliner outliner(assembly.str());
+        outliner.run();
+        outliner.write(stream);
+        
+        const size_t before = outliner.getOriginalSize();
+        const size_t after = outliner.getSize();
+        std::cerr << (m_sourceFilename.empty() ? "<stdin>" : m_sourceFilename) << ": outlined " << outliner.getNumSequences()
+                  << " sequences into " << outliner.getNumFunctions() << " functions; code " << before << " -> " << after
+                  << " bytes (estimated, " << std::fixed << std::setprecision(1)
+                  << (before > 0 ? 100.0 * (double)(before - after) / (double)before : 0.0) << "% smaller)" << std::endl;
     }
 }
   
@@ -48,13 +48,15 @@ public:
         m_blank(""),
         m_statements(),
         m_strings(),
-        m_doubles()
+        m_doubles(),
+        m_outline(false)
     {}
     
     ~IrTraversalContext() {}
     
     void pushSymbols(IrSymbolTable* symbols) { m_symbols.push_front(symbols); }
     void popSymbols() { m_symbols.pop_front(); }
+    size_t getNumSymbols() const { return m_symbols.size(); }
     
     void pushParent(IrBase* parent) { m_parents.push_back(parent); }
     void popParent() { m_parents.pop_back(); }
@@ -66,6 +68,8 @@ public:
     bool lookup(IrIdentifier* variable, SVariableSymbol& symbol) const;
     bool lookup(IrLocation* variable, SVariableSymbol& symbol) const;
     bool lookup(IrMethodCall* method, SMethodSymbol& symbol) const;
+    // True when the variable is declared in one of the innermost 'count' scopes.
+    bool isDeclaredWithin(IrLocation* variable, size_t count) const;
     
     bool addString(IrIdentifier* identifier, const std::string& value);
     bool lookup(const std::string& value, SStringSymbol& symbol);
@@ -88,6 +92,8 @@ public:
     void setStatements(const std::vector<IrTacStmt>& statements) { m_statements = statements; }
     
     void codegen(std::ostream& stream);
+    // Share repeated instruction sequences of the generated code (-Os).
+    void enableOutlining() { m_outline = true; }
     
     void genStrings();
     void genDoubles();
@@ -106,6 +112,7 @@ protected:
     std::map<std::string, SStringSymbol> m_strings; 
     std::map<std::string, SDoubleSymbol> m_doubles;
     
+    bool m_outline;
 };
 
 } // namespace Decaf
@@ -13,6 +13,34 @@ int g_opt_basic_blocks_cse = 0;
 int g_opt_basic_blocks_alg_simp = 0;
 int g_opt_basic_blocks_copy_prop = 0;
 int g_opt_basic_blocks_dead_code = 0;
+int g_opt_scalar_repl = 0;
+int g_opt_const_prop = 0;
+int g_opt_ipcp = 0;
+int g_clone_budget = -1;
+int g_opt_load_store = 0;
+int g_opt_pre = 0;
+int g_opt_copy_prop = 0;
+int g_opt_dead_code = 0;
+int g_opt_simplify_cfg = 0;
+int g_opt_loop_fusion = 0;
+int g_opt_unswitch = 0;
+int g_opt_if_convert = 0;
+int g_opt_layout = 0;
+int g_opt_unroll = 0;
+int g_unroll_factor = 4;
+int g_opt_schedule = 0;
+char* g_schedule = 0;
+int g_opt_outline = 0;
+int g_opt_dead_decls = 0;
+char* g_opt_level = 0;
+char* g_passes = 0;
+int g_pass_stats = 0;
+int g_time_passes = 0;
+char* g_time_trace = 0;
+int g_opt_parallelize = 0;
+int g_profile_generate = 0;
+char* g_profile_use = 0;
+char* g_profile_sample = 0;
 int g_opt_all = 0;
 int g_output_ir = 0;
 int g_output_blocks = 0;
@@ -31,6 +59,34 @@ poptOption appOptions[] =
     { "opt-basic-blocks-alg-simp", 0, POPT_ARG_NONE, &g_opt_basic_blocks_alg_simp, 0, "enable basic-block algebraic simplification", NULL },
     { "opt-basic-blocks-copy-prop", 0, POPT_ARG_NONE, &g_opt_basic_blocks_copy_prop, 0, "enable basic-block copy propagation", NULL },
     { "opt-basic-blocks-dead-code", 0, POPT_ARG_NONE, &g_opt_basic_blocks_dead_code, 0, "enable basic-block dead code elimination", NULL },
+    { "opt-scalar-repl", 0, POPT_ARG_NONE, &g_opt_scalar_repl, 0, "enable scalar replacement of small arrays", NULL },
+    { "opt-const-prop", 0, POPT_ARG_NONE, &g_opt_const_prop, 0, "enable conditional constant propagation", NULL },
+    { "opt-ipcp", 0, POPT_ARG_NONE, &g_opt_ipcp, 0, "enable interprocedural constant propagation and specialization of methods", NULL },
+    { "clone-budget", 0, POPT_ARG_INT, &g_clone_budget, 0, "statements the specialized copies of methods may add (default 400, 0 with -Os)", "N" },
+    { "opt-load-store", 0, POPT_ARG_NONE, &g_opt_load_store, 0, "enable redundant load and dead store elimination", NULL },
+    { "opt-pre", 0, POPT_ARG_NONE, &g_opt_pre, 0, "enable partial redundancy elimination (lazy code motion)", NULL },
+    { "opt-copy-prop", 0, POPT_ARG_NONE, &g_opt_copy_prop, 0, "enable global copy propagation and coalescing", NULL },
+    { "opt-dead-code", 0, POPT_ARG_NONE, &g_opt_dead_code, 0, "enable global dead code elimination", NULL },
+    { "opt-simplify-cfg", 0, POPT_ARG_NONE, &g_opt_simplify_cfg, 0, "enable control flow graph simplification", NULL },
+    { "opt-loop-fusion", 0, POPT_ARG_NONE, &g_opt_loop_fusion, 0, "enable loop fusion", NULL },
+    { "opt-if-convert", 0, POPT_ARG_NONE, &g_opt_if_convert, 0, "enable if-conversion to conditional moves", NULL },
+    { "opt-layout", 0, POPT_ARG_NONE, &g_opt_layout, 0, "enable block placement by frequency", NULL },
+    { "opt-unswitch", 0, POPT_ARG_NONE, &g_opt_unswitch, 0, "enable loop unswitching", NULL },
+    { "opt-unroll", 0, POPT_ARG_NONE, &g_opt_unroll, 0, "enable loop unrolling", NULL },
+    { "unroll-factor", 0, POPT_ARG_INT, &g_unroll_factor, 0, "iterations per test in partially unrolled loops (default 4)", "N" },
+    { "opt-schedule", 0, POPT_ARG_NONE, &g_opt_schedule, 0, "enable list scheduling of basic blocks", NULL },
+    { "schedule", 0, POPT_ARG_STRING, &g_schedule, 0, "schedule before frame slot assignment, after it or both (default pre)", "pre|post|both" },
+    { "opt-outline", 0, POPT_ARG_NONE, &g_opt_outline, 0, "enable outlining of repeated instruction sequences", NULL },
+    { "opt-dead-decls", 0, POPT_ARG_NONE, &g_opt_dead_decls, 0, "remove methods and globals main cannot reach, with a report", NULL },
+    { "optimize", 'O', POPT_ARG_STRING, &g_opt_level, 0, "optimization level 0-3 (-O3 as --opt-all); -Os optimizes for size", "LEVEL" },
+    { "passes", 0, POPT_ARG_STRING, &g_passes, 0, "run these passes in this order instead of those the flags select; 'help' lists them", "a,b,fixpoint(c,d),..." },
+    { "pass-stats", 0, POPT_ARG_NONE, &g_pass_stats, 0, "print the runs, changes and time of each optimization pass", NULL },
+    { "time-passes", 0, POPT_ARG_NONE, &g_time_passes, 0, "print the wall and cpu time of each compiler phase and pass, and the peak memory use", NULL },
+    { "time-trace", 0, POPT_ARG_STRING, &g_time_trace, 0, "write the compiler phases as Chrome trace events", "FILE" },
+    { "opt-parallelize", 0, POPT_ARG_NONE, &g_opt_parallelize, 0, "run independent loops on a thread pool (needs the 6035 runtime)", NULL },
+    { "profile-generate", 0, POPT_ARG_NONE, &g_profile_generate, 0, "count block and branch executions, written to <source>.prof when the program exits", NULL },
+    { "profile-use", 0, POPT_ARG_STRING, &g_profile_use, 0, "optimize with the counts of an earlier --profile-generate run", "FILE" },
+    { "profile-sample", 0, POPT_ARG_STRING, &g_profile_sample, 0, "optimize with sampled counts: '<line> <samples>' or '<function> <samples>' per line", "FILE" },
     { "opt-all", 0, POPT_ARG_NONE, &g_opt_all, 0, "enable all optimizations", NULL },
     POPT_AUTOHELP
     POPT_TABLEEND
@@ -46,6 +102,8 @@ int main(int argc, char **argv)
     {
         std::cerr << poptStrerror(res) << std::endl;
     }
+    if (g_time_passes) IrTimeReport::get().enable();
+    if (g_time_trace) IrTimeReport::get().enableTrace();
     
     if (g_target && std::string(g_target) == "scan")
     {
@@ -115,9 +173,71 @@ int main(int argc, char **argv)
         if (g_opt_basic_blocks_dead_code) parser->enableOpt(Optimization::BASIC_BLOCKS_DEAD_CODE);
         
         if (g_opt_global_cse) parser->enableOpt(Optimization::GLOBAL_CSE);
+        if (g_opt_scalar_repl) parser->enableOpt(Optimization::SCALAR_REPLACEMENT);
+        if (g_opt_const_prop) parser->enableOpt(Optimization::CONSTANT_PROPAGATION);
+        if (g_opt_ipcp) parser->enableOpt(Optimization::INTERPROCEDURAL_CONSTANTS);
+        if (g_opt_load_store) parser->enableOpt(Optimization::LOAD_STORE_ELIM);
+        if (g_opt_pre) parser->enableOpt(Optimization::PARTIAL_REDUNDANCY);
+        if (g_opt_copy_prop) parser->enableOpt(Optimization::COPY_PROPAGATION);
+        if (g_opt_dead_code) parser->enableOpt(Optimization::DEAD_CODE_ELIM);
+        if (g_opt_simplify_cfg) parser->enableOpt(Optimization::SIMPLIFY_CFG);
+        if (g_opt_loop_fusion) parser->enableOpt(Optimization::LOOP_FUSION);
+        if (g_opt_if_convert) parser->enableOpt(Optimization::IF_CONVERSION);
+        if (g_opt_layout) parser->enableOpt(Optimization::BLOCK_LAYOUT);
+        if (g_opt_unswitch) parser->enableOpt(Optimization::LOOP_UNSWITCH);
+        if (g_opt_unroll) parser->enableOpt(Optimization::LOOP_UNROLL);
+        if (g_opt_schedule) parser->enableOpt(Optimization::SCHEDULING);
+        if (g_opt_parallelize) parser->enableOpt(Optimization::PARALLELIZE);
+        if (g_opt_outline) parser->enableOpt(Optimization::OUTLINING);
+        if (g_opt_dead_decls) parser->enableOpt(Optimization::DEAD_DECLARATIONS);
         if (g_opt_all) parser->enableOpt(Optimization::ALL);
+        if (g_opt_level)
+        {
+            const std::string level(g_opt_level);
+            if (level == "s")
+                parser->enableOpt(Optimization::SIZE);
+            else if (level == "1")
+                parser->enableOpt(Optimization::LEVEL_1);
+            else if (level == "2")
+                parser->enableOpt(Optimization::LEVEL_2);
+            else if (level == "3")
+                parser->enableOpt(Optimization::ALL);
+            else if (level != "0")
+                std::cerr << "warning: unknown optimization level '-O" << g_opt_level << "'; ignored." << std::endl;
+        }
+        parser->setUnrollFactor(g_unroll_factor);
+        if (g_clone_budget >= 0) parser->setCloneBudget(g_clone_budget);
+        if (g_schedule)
+        {
+            const std::string when(g_schedule);
+            if (when == "pre" || when == "post" || when == "both")
+                parser->setSchedulePasses(when != "post", when != "pre");
+            else
+                std::cerr << "warning: unknown --schedule '" << when << "'; scheduling before slot assignment." << std::endl;
+        }
+        if (g_passes)
+        {
+            std::string error;
+            if (std::string(g_passes) == "help")
+            {
+                std::cerr << "Passes are:" << std::endl;
+                IrPassManager::printPasses(std::cerr);
+            }
+            else if (!parser->setPasses(g_passes, error))
+            {
+                std::cerr << "warning: --passes: " << error << "; ignored.  Passes are:" << std::endl;
+                IrPassManager::printPasses(std::cerr);
+            }
+        }
+        if (g_pass_stats) parser->enablePassStats();
+        if (g_profile_generate) parser->enableProfileGenerate();
+        if (g_profile_use) parser->setProfileUse(g_profile_use);
+        if (g_profile_sample) parser->setProfileSample(g_profile_sample);
         
-        parser->parse();        
+        {
+            IrScopedTimer timer("parse");
+            parser->parse();
+        }
         if (parser->semanticChecks())
         {
             if (g_debug)
@@ -127,5 +247,17 @@ int main(int argc, char **argv)
         
         delete parser;
     }
+    
+    if (g_time_passes) IrTimeReport::get().print(std::cerr);
+    if (g_time_trace)
+    {
+        std::string name("dcc");
+        for (int i = 1; i < argc; i++)
+        {
+            name += std::string(" ") + argv[i];
+        }
+        if (!IrTimeReport::get().writeTrace(g_time_trace, name))
+            std::cerr << "warning: cannot write the trace to '" << g_time_trace << "'." << std::endl;
+    }
     return 0;
 }
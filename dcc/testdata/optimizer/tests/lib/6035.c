@@ -21,8 +21,13 @@
 //   Modifications by Rick Weyrauch in Spring 2015
 //              Removed unneeded threading functions.
 //
+//   Modifications in Fall 2026
+//              Added a work-stealing thread pool for loops parallelized
+//              by dcc (dcc_parallel_for).
+//
 //===========================================================================
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
@@ -38,6 +43,51 @@ static struct timeval* diff_6035;
 
 static int _NUM_THREADS_6035;
 
+#define MAX_THREADS_6035 256
+#define CHUNKS_PER_THREAD_6035 8
+
+/* Iterations [next, end) still owned by a thread. */
+struct range_6035 {
+  pthread_mutex_t lock;
+  long next;
+  long end;
+};
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  unsigned long generation;
+  int started;          /* worker threads created, the caller is thread 0 */
+  int threads;          /* threads taking part in the current loop */
+  int active;           /* threads still working on the current loop */
+  int dynamic;          /* hand out chunks and steal, or one block per thread */
+  void* body;
+  long args[3];
+  long chunk;
+  struct range_6035 ranges[MAX_THREADS_6035];
+} pool_6035 = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static __thread int in_pool_6035 = 0;
+
+/* dcc generated code does not preserve %rbx, so outlined loop bodies are
+   called through this thunk: body(first, last, a0, a1, a2). */
+void call_body_6035(void* body, long first, long last, long a0, long a1, long a2);
+__asm__(
+  "  .text\n"
+  "  .globl call_body_6035\n"
+  "call_body_6035:\n"
+  "  pushq %rbx\n"
+  "  movq %rdi, %rax\n"
+  "  movq %rsi, %rdi\n"
+  "  movq %rdx, %rsi\n"
+  "  movq %rcx, %rdx\n"
+  "  movq %r8, %rcx\n"
+  "  movq %r9, %r8\n"
+  "  call *%rax\n"
+  "  popq %rbx\n"
+  "  ret\n");
+
 int timeval_subtract (result, x, y)
      struct timeval *result, *x, *y;
 {
@@ -180,3 +230,176 @@ void ppm_write_next_pixel(int r, int g, int b)
   fprintf(fp_6035, "%d %d %d ", r, g, b);
 }
 
+void set_num_threads(int n)
+{
+  _NUM_THREADS_6035 = n;
+}
+
+static int num_threads_6035()
+{
+  int n = _NUM_THREADS_6035;
+  if (n <= 0 && getenv("DCC_NUM_THREADS") != NULL)
+    n = atoi(getenv("DCC_NUM_THREADS"));
+  if (n <= 0)
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (n < 1)
+    n = 1;
+  if (n > MAX_THREADS_6035)
+    n = MAX_THREADS_6035;
+  return n;
+}
+
+/* Claim the next chunk of this thread's range, stealing the back half of
+   the largest other range once it runs dry. */
+static int take_6035(int self, long* first, long* last)
+{
+  struct range_6035* own = &pool_6035.ranges[self];
+  for (;;) {
+    int i, victim = -1;
+    long most = 0, left, half, stolen = 0;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->next < own->end) {
+      *first = own->next;
+      *last = own->end - own->next > pool_6035.chunk ? own->next + pool_6035.chunk : own->end;
+      own->next = *last;
+      pthread_mutex_unlock(&own->lock);
+      return 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+    if (!pool_6035.dynamic)
+      return 0;
+
+    for (i = 0; i < pool_6035.threads; i++) {
+      if (i == self)
+        continue;
+      pthread_mutex_lock(&pool_6035.ranges[i].lock);
+      left = pool_6035.ranges[i].end - pool_6035.ranges[i].next;
+      pthread_mutex_unlock(&pool_6035.ranges[i].lock);
+      if (left > most) {
+        most = left;
+        victim = i;
+      }
+    }
+    if (victim < 0)
+      return 0;
+
+    pthread_mutex_lock(&pool_6035.ranges[victim].lock);
+    left = pool_6035.ranges[victim].end - pool_6035.ranges[victim].next;
+    half = (left + 1) / 2;
+    if (half > 0) {
+      pool_6035.ranges[victim].end -= half;
+      stolen = pool_6035.ranges[victim].end;
+    }
+    pthread_mutex_unlock(&pool_6035.ranges[victim].lock);
+
+    /* the victim may move its end again once unlocked */
+    if (half > 0) {
+      pthread_mutex_lock(&own->lock);
+      own->next = stolen;
+      own->end = stolen + half;
+      pthread_mutex_unlock(&own->lock);
+    }
+  }
+}
+
+static void run_6035(int self)
+{
+  long first, last;
+  while (take_6035(self, &first, &last))
+    call_body_6035(pool_6035.body, first, last, pool_6035.args[0], pool_6035.args[1], pool_6035.args[2]);
+}
+
+static void* worker_6035(void* arg)
+{
+  int self = (int)(long)arg;
+  unsigned long seen = 0;
+
+  in_pool_6035 = 1;
+  for (;;) {
+    pthread_mutex_lock(&pool_6035.lock);
+    while (pool_6035.generation == seen)
+      pthread_cond_wait(&pool_6035.start, &pool_6035.lock);
+    seen = pool_6035.generation;
+    pthread_mutex_unlock(&pool_6035.lock);
+
+    if (self < pool_6035.threads)
+      run_6035(self);
+
+    pthread_mutex_lock(&pool_6035.lock);
+    if (--pool_6035.active == 0)
+      pthread_cond_signal(&pool_6035.done);
+    pthread_mutex_unlock(&pool_6035.lock);
+  }
+  return NULL;
+}
+
+/* Run body(first, last, a0, a1, a2) over pieces covering [lo, hi).
+   Iterations must be independent; nested calls run serially. */
+static void parallel_for_6035(void* body, long lo, long hi, long a0, long a1, long a2, int dynamic)
+{
+  int i, n;
+  long count = hi - lo;
+
+  if (count <= 0)
+    return;
+  n = in_pool_6035 ? 1 : num_threads_6035();
+  if (n > count)
+    n = (int)count;
+  if (n <= 1) {
+    call_body_6035(body, lo, hi, a0, a1, a2);
+    return;
+  }
+
+  pthread_mutex_lock(&pool_6035.lock);
+  while (pool_6035.started < n) {
+    pthread_t thread;
+    pthread_mutex_init(&pool_6035.ranges[pool_6035.started].lock, NULL);
+    if (pool_6035.started > 0 &&
+        pthread_create(&thread, NULL, worker_6035, (void*)(long)pool_6035.started) != 0)
+      break;
+    pool_6035.started++;
+  }
+  if (n > pool_6035.started)
+    n = pool_6035.started;
+
+  pool_6035.body = body;
+  pool_6035.args[0] = a0;
+  pool_6035.args[1] = a1;
+  pool_6035.args[2] = a2;
+  pool_6035.dynamic = dynamic;
+  pool_6035.chunk = dynamic ? count / (n * CHUNKS_PER_THREAD_6035) : count;
+  if (pool_6035.chunk < 1)
+    pool_6035.chunk = 1;
+  for (i = 0; i < n; i++) {
+    pool_6035.ranges[i].next = lo + count * i / n;
+    pool_6035.ranges[i].end = lo + count * (i + 1) / n;
+  }
+  pool_6035.threads = n;
+  pool_6035.active = pool_6035.started;
+  pool_6035.generation++;
+  pthread_cond_broadcast(&pool_6035.start);
+  pthread_mutex_unlock(&pool_6035.lock);
+
+  in_pool_6035 = 1;
+  run_6035(0);
+  in_pool_6035 = 0;
+
+  pthread_mutex_lock(&pool_6035.lock);
+  if (--pool_6035.active > 0)
+    while (pool_6035.active > 0)
+      pthread_cond_wait(&pool_6035.done, &pool_6035.lock);
+  pthread_mutex_unlock(&pool_6035.lock);
+}
+
+/* Dynamic schedule: chunks, with idle threads stealing from busy ones. */
+void dcc_parallel_for(void* body, long lo, long hi, long a0, long a1, long a2)
+{
+  parallel_for_6035(body, lo, hi, a0, a1, a2, 1);
+}
+
+/* Static schedule: one contiguous block of iterations per thread. */
+void dcc_parallel_for_static(void* body, long lo, long hi, long a0, long a1, long a2)
+{
+  parallel_for_6035(body, lo, hi, a0, a1, a2, 0);
+}